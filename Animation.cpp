@@ -0,0 +1,138 @@
+#include"Animation.h"
+
+// Samplers per job when they are interpolated in parallel
+const unsigned int ANIMATION_BATCH_SAMPLERS = 64;
+
+void Animation::Sample(float time, SceneGraph& nodes, JobSystem* jobs)
+{
+	// A sampler is interpolated as a rotation if any channel uses it for one
+	if (rotationSamplers.size() != samplers.size())
+	{
+		rotationSamplers.assign(samplers.size(), 0);
+		for (unsigned int i = 0; i < channels.size(); i++)
+		{
+			if (channels[i].path == ANIMATION_ROTATION)
+				rotationSamplers[channels[i].sampler] = 1;
+		}
+
+		resultOffsets.resize(samplers.size());
+		unsigned int offset = 0;
+		for (unsigned int i = 0; i < samplers.size(); i++)
+		{
+			resultOffsets[i] = offset;
+			offset += samplers[i].width;
+		}
+		results.assign(offset, glm::vec4(0.0f));
+	}
+
+	// Each sampler moves only its own cursor, so samplers can be interpolated at the same time
+	auto interpolate = [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			if (!samplers[i].times.empty())
+				sample(samplers[i], time, rotationSamplers[i] != 0, &results[resultOffsets[i]]);
+		}
+	};
+	if (jobs != NULL && jobs->Size() > 1 && samplers.size() > ANIMATION_BATCH_SAMPLERS)
+	{
+		JobCounter counter;
+		jobs->ParallelFor((unsigned int)samplers.size(), ANIMATION_BATCH_SAMPLERS, interpolate, counter);
+		jobs->Wait(counter);
+	}
+	else
+		interpolate(0, (unsigned int)samplers.size());
+
+	// Several channels can move the same node, so the nodes are written one channel at a time
+	for (unsigned int i = 0; i < channels.size(); i++)
+	{
+		AnimationChannel& channel = channels[i];
+		if (samplers[channel.sampler].times.empty())
+			continue;
+
+		const glm::vec4& value = results[resultOffsets[channel.sampler]];
+		if (channel.path == ANIMATION_TRANSLATION)
+			nodes.SetTranslation(channel.node, glm::vec3(value));
+		else if (channel.path == ANIMATION_ROTATION)
+			nodes.SetRotation(channel.node, glm::quat(value.w, value.x, value.y, value.z));
+		else if (channel.path == ANIMATION_SCALE)
+			nodes.SetScale(channel.node, glm::vec3(value));
+		else
+			nodes.SetWeights(channel.node, &value.x, samplers[channel.sampler].width * 4);
+	}
+}
+
+void Animation::sample(AnimationSampler& sampler, float time, bool rotation, glm::vec4* out)
+{
+	const std::vector<float>& times = sampler.times;
+	const std::vector<glm::vec4>& values = sampler.values;
+	unsigned int last = (unsigned int)times.size() - 1;
+	unsigned int width = sampler.width;
+
+	// Cubic spline keyframes are triples with the value in the middle
+	bool cubic = sampler.interpolation == INTERPOLATION_CUBIC_SPLINE;
+	unsigned int stride = (cubic ? 3 : 1) * width;
+	unsigned int middle = cubic ? width : 0;
+
+	// Hold the first and last keyframes outside of the animated range
+	if (time <= times[0] || time >= times[last])
+	{
+		sampler.cursor = time <= times[0] ? 0 : last;
+		for (unsigned int i = 0; i < width; i++)
+			out[i] = values[sampler.cursor * stride + middle + i];
+		return;
+	}
+
+	// Step forward from the keyframe the last sample used. Going back in time, such as
+	// when the animation loops, starts over from the first keyframe.
+	if (sampler.cursor >= last || time < times[sampler.cursor])
+		sampler.cursor = 0;
+	while (times[sampler.cursor + 1] <= time)
+		sampler.cursor++;
+
+	unsigned int key = sampler.cursor;
+	float delta = times[key + 1] - times[key];
+	float t = (time - times[key]) / delta;
+
+	if (sampler.interpolation == INTERPOLATION_STEP)
+	{
+		for (unsigned int i = 0; i < width; i++)
+			out[i] = values[key * width + i];
+		return;
+	}
+
+	if (sampler.interpolation == INTERPOLATION_LINEAR)
+	{
+		for (unsigned int i = 0; i < width; i++)
+		{
+			const glm::vec4& a = values[key * width + i];
+			const glm::vec4& b = values[(key + 1) * width + i];
+			if (!rotation)
+			{
+				out[i] = glm::mix(a, b, t);
+				continue;
+			}
+			glm::quat q = glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), t);
+			out[i] = glm::vec4(q.x, q.y, q.z, q.w);
+		}
+		return;
+	}
+
+	// Cubic Hermite spline between this keyframe's value and outgoing tangent
+	// and the next keyframe's incoming tangent and value
+	float t2 = t * t;
+	float t3 = t2 * t;
+	for (unsigned int i = 0; i < width; i++)
+	{
+		const glm::vec4& value0 = values[(key * 3 + 1) * width + i];
+		const glm::vec4& out0 = values[(key * 3 + 2) * width + i];
+		const glm::vec4& in1 = values[(key + 1) * 3 * width + i];
+		const glm::vec4& value1 = values[((key + 1) * 3 + 1) * width + i];
+		glm::vec4 result =
+			(2.0f * t3 - 3.0f * t2 + 1.0f) * value0 +
+			(t3 - 2.0f * t2 + t) * delta * out0 +
+			(-2.0f * t3 + 3.0f * t2) * value1 +
+			(t3 - t2) * delta * in1;
+		out[i] = rotation ? glm::normalize(result) : result;
+	}
+}
@@ -0,0 +1,90 @@
+// If ANIMATION_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef ANIMATION_CLASS_H
+#define ANIMATION_CLASS_H
+
+#include<glm/glm.hpp>
+#include<glm/gtc/quaternion.hpp>
+#include<string>
+#include<vector>
+
+#include"SceneGraph.h"
+#include"JobSystem.h"
+
+
+// How a sampler fills in the time between two keyframes, as glTF names them.
+enum Interpolation
+{
+	INTERPOLATION_LINEAR,
+	INTERPOLATION_STEP,
+	INTERPOLATION_CUBIC_SPLINE,
+};
+
+// Which property of a node a channel moves.
+enum AnimationPath
+{
+	ANIMATION_TRANSLATION,
+	ANIMATION_ROTATION,
+	ANIMATION_SCALE,
+	// The morph target weights of the node's mesh
+	ANIMATION_WEIGHTS,
+};
+
+// The keyframes of one animated property.
+struct AnimationSampler
+{
+	// Time of every keyframe in seconds, in increasing order
+	std::vector<float> times;
+	// Value of every keyframe, vec3s padded with a 0 and rotations as x, y, z, w.
+	// Morph target weights are packed four to a vec4, the last one padded with 0s.
+	// Cubic spline samplers hold three values per keyframe, like glTF stores them:
+	// the incoming tangent, the value, and the outgoing tangent.
+	std::vector<glm::vec4> values;
+	// Number of vec4s in one value, more than 1 only for weights
+	unsigned int width = 1;
+	Interpolation interpolation;
+	// Keyframe the last sample fell after. Playback moves forward a little every frame,
+	// so the next keyframe is found by stepping from here instead of searching all of them.
+	unsigned int cursor = 0;
+};
+
+// Connects a sampler to the node property it drives.
+struct AnimationChannel
+{
+	unsigned int sampler;
+	// Index of the node in the scene graph
+	unsigned int node;
+	AnimationPath path;
+};
+
+// An Animation is one glTF animation clip: a set of samplers holding keyframes
+// and the channels that write their values into the nodes of a scene graph.
+class Animation
+{
+public:
+	std::string name;
+	std::vector<AnimationSampler> samplers;
+	std::vector<AnimationChannel> channels;
+	// Time of the last keyframe of any sampler
+	float duration = 0.0f;
+
+	// Evaluates every channel at time (in seconds) and moves the nodes it drives.
+	// Times before the first or after the last keyframe hold the nearest keyframe's value.
+	// With a job system the samplers are interpolated in parallel batches first, then
+	// the channels write the results into the nodes on the calling thread.
+	void Sample(float time, SceneGraph& nodes, JobSystem* jobs = NULL);
+
+private:
+	// Value of every sampler at the time of the last Sample, each taking its width in vec4s
+	std::vector<glm::vec4> results;
+	// Where each sampler's value starts in results
+	std::vector<unsigned int> resultOffsets;
+	// Non zero for samplers holding rotations, found on the first Sample
+	std::vector<unsigned char> rotationSamplers;
+
+	// Interpolates the sampler's width vec4s at time into out.
+	// Rotations are interpolated along the sphere.
+	void sample(AnimationSampler& sampler, float time, bool rotation, glm::vec4* out);
+};
+
+#endif
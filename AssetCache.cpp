@@ -0,0 +1,97 @@
+#include"AssetCache.h"
+
+#include<filesystem>
+#include<fstream>
+#include<cstring>
+#include<cstdio>
+
+// Changes whenever the layout of any baked data changes, so old entries stop matching
+const unsigned int ASSET_CACHE_VERSION = 1;
+
+// Header written in front of every baked entry.
+struct AssetCacheHeader
+{
+	char magic[4];
+	unsigned int version;
+	unsigned long long size;
+};
+
+AssetCache::AssetCache(const char* directory)
+{
+	AssetCache::directory = directory;
+}
+
+std::string AssetCache::Key(const std::string& kind, const std::vector<std::pair<const void*, size_t>>& sources)
+{
+	// 64 bit FNV-1a, over the kind and version a byte at a time and over the sources
+	// eight bytes at a time, since they can be whole vertex buffers
+	unsigned long long hash = 14695981039346656037ULL;
+	auto mix = [&hash](unsigned long long value)
+	{
+		hash ^= value;
+		hash *= 1099511628211ULL;
+	};
+	for (unsigned int i = 0; i < kind.size(); i++)
+		mix((unsigned char)kind[i]);
+	mix(ASSET_CACHE_VERSION);
+
+	for (unsigned int i = 0; i < sources.size(); i++)
+	{
+		const unsigned char* bytes = (const unsigned char*)sources[i].first;
+		size_t size = sources[i].second;
+		size_t j = 0;
+		for (; j + 8 <= size; j += 8)
+		{
+			unsigned long long word;
+			std::memcpy(&word, bytes + j, 8);
+			mix(word);
+		}
+		for (; j < size; j++)
+			mix(bytes[j]);
+		// Separate the sources so moving bytes from one into the next changes the hash
+		mix(size);
+	}
+
+	char key[17];
+	std::snprintf(key, sizeof(key), "%016llx", hash);
+	return std::string(key);
+}
+
+bool AssetCache::Load(const std::string& key, std::vector<char>& data)
+{
+	std::ifstream in(path(key), std::ios::binary);
+	AssetCacheHeader header;
+	if (!in || !in.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, "BAKE", 4) != 0 || header.version != ASSET_CACHE_VERSION)
+		return false;
+
+	data.resize((size_t)header.size);
+	if (header.size > 0 && !in.read(data.data(), (std::streamsize)header.size))
+	{
+		data.clear();
+		return false;
+	}
+	return true;
+}
+
+void AssetCache::Store(const std::string& key, const void* data, size_t size)
+{
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+
+	// Write next to the entry and rename, so a crash halfway never leaves a broken entry behind
+	std::string temporary = path(key) + ".tmp";
+	{
+		std::ofstream out(temporary, std::ios::binary);
+		if (!out)
+			return;
+		AssetCacheHeader header = { { 'B', 'A', 'K', 'E' }, ASSET_CACHE_VERSION, (unsigned long long)size };
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)data, (std::streamsize)size);
+	}
+	std::filesystem::rename(temporary, path(key), error);
+}
+
+std::string AssetCache::path(const std::string& key)
+{
+	return directory + "/" + key + ".bake";
+}
@@ -0,0 +1,38 @@
+// If ASSET_CACHE_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef ASSET_CACHE_CLASS_H
+#define ASSET_CACHE_CLASS_H
+
+#include<string>
+#include<vector>
+#include<utility>
+
+
+// The AssetCache keeps data that is slow to work out at load time but never changes for
+// the same input, such as generated tangents, baked to disk. Entries are keyed by a hash
+// of what kind of data they are and of all the source data they were made from, so an
+// edited model simply misses and bakes a new entry, like the ProgramCache does for shaders.
+class AssetCache
+{
+public:
+	// Creates a cache that keeps its files in 'directory'.
+	AssetCache(const char* directory = "asset_cache");
+
+	// Builds the key of the data of a kind, such as "tangents", made from the given
+	// source buffers (pointer and size in bytes).
+	std::string Key(const std::string& kind, const std::vector<std::pair<const void*, size_t>>& sources);
+
+	// Reads the entry stored under key into data. Returns false if there is none.
+	bool Load(const std::string& key, std::vector<char>& data);
+
+	// Bakes size bytes under key.
+	void Store(const std::string& key, const void* data, size_t size);
+
+private:
+	std::string directory;
+
+	// Returns the file an entry is stored in.
+	std::string path(const std::string& key);
+};
+
+#endif
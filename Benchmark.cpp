@@ -0,0 +1,128 @@
+#include"Benchmark.h"
+#include"RenderStats.h"
+
+#include<fstream>
+#include<algorithm>
+#include<cmath>
+
+// Returns the value below which a fraction p of the samples fall, using the nearest rank
+template<typename T>
+static double percentile(std::vector<T> values, double p)
+{
+	if (values.empty())
+		return 0.0;
+	std::sort(values.begin(), values.end());
+	size_t rank = (size_t)std::ceil(p * values.size());
+	return (double)values[std::min(std::max(rank, (size_t)1), values.size()) - 1];
+}
+
+// Summarizes a series of samples as mean, percentiles, and extremes
+template<typename T>
+static json summarize(const std::vector<T>& values)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < values.size(); i++)
+		sum += (double)values[i];
+	json summary;
+	summary["mean"] = values.empty() ? 0.0 : sum / values.size();
+	summary["p50"] = percentile(values, 0.50);
+	summary["p95"] = percentile(values, 0.95);
+	summary["p99"] = percentile(values, 0.99);
+	summary["min"] = percentile(values, 0.0);
+	summary["max"] = percentile(values, 1.0);
+	return summary;
+}
+
+Benchmark::Benchmark()
+{
+	glGenQueries(BENCHMARK_QUERIES, queries);
+}
+
+void Benchmark::BeginFrame()
+{
+	// The slot is reused every few frames, by then its result is almost always ready
+	if (pending[next])
+		collect(next, true);
+
+	RenderStats::Reset();
+	glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+	frameStart = std::chrono::high_resolution_clock::now();
+}
+
+void Benchmark::EndFrame(bool keep)
+{
+	glEndQuery(GL_TIME_ELAPSED);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+
+	pending[next] = true;
+	kept[next] = keep;
+	next = (next + 1) % BENCHMARK_QUERIES;
+
+	if (keep)
+	{
+		cpuMs.push_back(ms);
+		drawCalls.push_back(RenderStats::drawCalls);
+		triangles.push_back(RenderStats::triangles);
+		stateChanges.push_back(RenderStats::StateChanges());
+	}
+
+	// Pick up any GPU times that finished meanwhile, oldest first so they stay in order
+	for (unsigned int i = 0; i < BENCHMARK_QUERIES; i++)
+	{
+		unsigned int slot = (next + i) % BENCHMARK_QUERIES;
+		if (pending[slot] && !collect(slot, false))
+			break;
+	}
+}
+
+unsigned int Benchmark::Frames()
+{
+	return (unsigned int)cpuMs.size();
+}
+
+bool Benchmark::Write(const char* file, json info)
+{
+	for (unsigned int i = 0; i < BENCHMARK_QUERIES; i++)
+	{
+		unsigned int slot = (next + i) % BENCHMARK_QUERIES;
+		if (pending[slot])
+			collect(slot, true);
+	}
+
+	json results = info;
+	results["frames"] = cpuMs.size();
+	results["cpuMs"] = summarize(cpuMs);
+	results["gpuMs"] = summarize(gpuMs);
+	results["drawCalls"] = summarize(drawCalls);
+	results["triangles"] = summarize(triangles);
+	results["stateChanges"] = summarize(stateChanges);
+
+	std::ofstream out(file);
+	if (!out)
+		return false;
+	out << results.dump(4) << std::endl;
+	return true;
+}
+
+void Benchmark::Delete()
+{
+	glDeleteQueries(BENCHMARK_QUERIES, queries);
+}
+
+bool Benchmark::collect(unsigned int slot, bool wait)
+{
+	GLint available = GL_FALSE;
+	if (!wait)
+	{
+		glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE)
+			return false;
+	}
+
+	GLuint64 nanoseconds = 0;
+	glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &nanoseconds);
+	if (kept[slot])
+		gpuMs.push_back(nanoseconds / 1000000.0);
+	pending[slot] = false;
+	return true;
+}
@@ -0,0 +1,69 @@
+// If BENCHMARK_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef BENCHMARK_CLASS_H
+#define BENCHMARK_CLASS_H
+
+#include<glad/glad.h>
+#include<chrono>
+#include<string>
+#include<vector>
+#include<json/json.h>
+
+using json = nlohmann::json;
+
+
+// How many GPU timer queries can be waiting for results at once.
+// Results are read this many frames late, so reading them never stalls.
+const unsigned int BENCHMARK_QUERIES = 4;
+
+
+// The Benchmark measures every frame between BeginFrame and EndFrame:
+// the CPU time on the wall clock, the GPU time with GL_TIME_ELAPSED queries, and
+// the draw calls, triangles, and state changes RenderStats counted.
+// Write saves the p50, p95, and p99 of the frame times and the per frame counts
+// as JSON, so runs of the same scene and camera path can be compared over time.
+class Benchmark
+{
+public:
+	// Creates the timer queries.
+	Benchmark();
+
+	// Starts measuring a frame.
+	void BeginFrame();
+
+	// Stops measuring the frame. Frames that aren't kept, such as ones drawn while
+	// textures were still loading, are measured but left out of the results.
+	void EndFrame(bool keep = true);
+
+	// Returns the number of frames kept so far.
+	unsigned int Frames();
+
+	// Waits for the outstanding GPU times and writes the results to a JSON file.
+	// The fields of info are added to the file as they are, to describe the run
+	// (scene, resolution, and so on). Returns false if the file can't be written.
+	bool Write(const char* file, json info);
+
+	// Deletes the timer queries.
+	void Delete();
+
+private:
+	// Results of the kept frames, in milliseconds
+	std::vector<double> cpuMs;
+	std::vector<double> gpuMs;
+	std::vector<unsigned int> drawCalls;
+	std::vector<unsigned long long> triangles;
+	std::vector<unsigned int> stateChanges;
+
+	std::chrono::high_resolution_clock::time_point frameStart;
+	GLuint queries[BENCHMARK_QUERIES];
+	// Whether each query is waiting to be read, and whether its frame is kept
+	bool pending[BENCHMARK_QUERIES] = {};
+	bool kept[BENCHMARK_QUERIES] = {};
+	unsigned int next = 0;
+
+	// Reads the result of a query, waiting for it if wait is true.
+	// Returns false if it isn't ready and wait is false.
+	bool collect(unsigned int slot, bool wait);
+};
+
+#endif
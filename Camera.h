@@ -7,8 +7,6 @@
 
 // glad provides access to modern OpenGL functions.
 #include<glad/glad.h>
-// GLFW handles window creation, input, and events.
-#include<GLFW/glfw3.h>
 // glm provides vector and matrix types for math operations used by the camera.
 #include<glm/glm.hpp>
 #include<glm/gtc/matrix_transform.hpp>
@@ -18,10 +16,12 @@
 
 // Include the Shader class so the camera can send its matrix to the shader.
 #include"shaderClass.h"
+// The controls the camera is moved by.
+#include"InputState.h"
 
 
 // The Camera class controls the position, orientation, and perspective of the view in 3D space.
-// It also handles keyboard and mouse input to move and rotate the camera in real time.
+// It is moved and rotated in real time by InputStates, from the keyboard and mouse or from a script.
 class Camera
 {
 public:
@@ -34,19 +34,28 @@ public:
 	glm::vec3 Up = glm::vec3(0.0f, 1.0f, 0.0f);
 	// The cameraMatrix combines view and projection transformations for rendering.
 	glm::mat4 cameraMatrix = glm::mat4(1.0f);
-
-	// Used to prevent sudden camera jumps when the mouse is first clicked.
-	bool firstClick = true;
+	// The view and projection matrices cameraMatrix was built from, kept apart
+	// for systems that work in view space, such as the light clusters.
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(1.0f);
 
 	// The width and height of the application window.
 	// These values are needed to calculate the projection matrix correctly.
 	int width;
 	int height;
 
-	// Movement speed of the camera and mouse sensitivity.
+	// The projection settings passed to the last updateMatrix() call.
+	// Kept so other systems can work out how large things appear on screen.
+	float FOVdeg = 45.0f;
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+
+	// Movement speed of the camera in units per second, and mouse sensitivity.
 	// Higher values make the camera move faster or rotate more sharply.
-	float speed = 0.1f;
+	float speed = 6.0f;
 	float sensitivity = 100.0f;
+	// How many times faster the camera moves while sprinting.
+	float sprintMultiplier = 4.0f;
 
 	// Constructor that sets up the camera's initial position and screen dimensions.
 	Camera(int width, int height, glm::vec3 position);
@@ -59,9 +68,10 @@ public:
 	// The 'uniform' parameter is the variable name inside the vertex shader.
 	void Matrix(Shader& shader, const char* uniform);
 
-	// Handles all camera input, including movement (WASD) and mouse rotation.
+	// Moves and rotates the camera by one frame of input, dt seconds long.
+	// Doesn't touch GLFW, so the input can come from an InputSampler, a script, or a test.
 	// This function should be called once per frame in the game loop.
-	void Inputs(GLFWwindow* window);
+	void update(float dt, const InputState& input);
 };
 
 // Ends the header guard  if the class was already defined, the compiler skips to here.
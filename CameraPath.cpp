@@ -0,0 +1,114 @@
+#include"CameraPath.h"
+
+#include<cmath>
+#include<algorithm>
+#include<fstream>
+#include<sstream>
+#include<string>
+
+bool CameraPath::Load(const char* file)
+{
+	std::ifstream in(file);
+	if (!in)
+		return false;
+
+	poses.clear();
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream values(line);
+		CameraPose pose;
+		if (values >> pose.position.x >> pose.position.y >> pose.position.z >> pose.orientation.x >> pose.orientation.y >> pose.orientation.z)
+		{
+			pose.orientation = glm::normalize(pose.orientation);
+			poses.push_back(pose);
+		}
+	}
+	return !poses.empty();
+}
+
+void CameraPath::Orbit(glm::vec3 center, float radius, float height, unsigned int count)
+{
+	poses.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float angle = glm::radians(360.0f) * i / count;
+		CameraPose pose;
+		pose.position = center + glm::vec3(std::sin(angle) * radius, height, std::cos(angle) * radius);
+		pose.orientation = glm::normalize(center - pose.position);
+		poses.push_back(pose);
+	}
+}
+
+void CameraPath::Spline(unsigned int count)
+{
+	if (poses.size() < 2 || count == 0)
+		return;
+
+	std::vector<CameraPose> keys = poses;
+	poses.clear();
+	unsigned int segments = (unsigned int)keys.size() - 1;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// Spread the poses evenly over the segments, ending exactly on the last key
+		float t = count > 1 ? (float)i / (count - 1) * segments : 0.0f;
+		unsigned int segment = std::min((unsigned int)t, segments - 1);
+		float f = t - segment;
+
+		// The ends are repeated so the curve still starts and stops on the first and last keys
+		const CameraPose& p0 = keys[segment > 0 ? segment - 1 : 0];
+		const CameraPose& p1 = keys[segment];
+		const CameraPose& p2 = keys[segment + 1];
+		const CameraPose& p3 = keys[std::min(segment + 2, segments)];
+
+		// Uniform Catmull-Rom weights
+		float f2 = f * f;
+		float f3 = f2 * f;
+		float w0 = -0.5f * f3 + f2 - 0.5f * f;
+		float w1 = 1.5f * f3 - 2.5f * f2 + 1.0f;
+		float w2 = -1.5f * f3 + 2.0f * f2 + 0.5f * f;
+		float w3 = 0.5f * f3 - 0.5f * f2;
+
+		CameraPose pose;
+		pose.position = w0 * p0.position + w1 * p1.position + w2 * p2.position + w3 * p3.position;
+		pose.orientation = glm::normalize(w0 * p0.orientation + w1 * p1.orientation + w2 * p2.orientation + w3 * p3.orientation);
+		poses.push_back(pose);
+	}
+}
+
+void CameraPath::Record(Camera& camera)
+{
+	CameraPose pose;
+	pose.position = camera.Position;
+	pose.orientation = camera.Orientation;
+	poses.push_back(pose);
+}
+
+bool CameraPath::Save(const char* file)
+{
+	std::ofstream out(file);
+	if (!out)
+		return false;
+
+	// Enough digits that a recorded path plays back exactly
+	out.precision(9);
+	out << "# px py pz ox oy oz\n";
+	for (unsigned int i = 0; i < poses.size(); i++)
+	{
+		const CameraPose& pose = poses[i];
+		out << pose.position.x << " " << pose.position.y << " " << pose.position.z << " "
+			<< pose.orientation.x << " " << pose.orientation.y << " " << pose.orientation.z << "\n";
+	}
+	return true;
+}
+
+void CameraPath::Apply(Camera& camera, unsigned int frame)
+{
+	if (poses.empty())
+		return;
+	const CameraPose& pose = poses[frame % poses.size()];
+	camera.Position = pose.position;
+	camera.Orientation = pose.orientation;
+}
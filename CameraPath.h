@@ -0,0 +1,53 @@
+// If CAMERA_PATH_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef CAMERA_PATH_CLASS_H
+#define CAMERA_PATH_CLASS_H
+
+#include<glm/glm.hpp>
+#include<vector>
+
+#include"Camera.h"
+
+
+// One scripted camera placement.
+struct CameraPose
+{
+	glm::vec3 position;
+	glm::vec3 orientation;
+};
+
+
+// A CameraPath is a list of poses the camera is moved through, one per frame, in place of
+// keyboard and mouse input. It is used to render the same frames every time, for example
+// when rendering headless or benchmarking. Paths can be written by hand, recorded while
+// flying the camera around, or smoothed into a spline through a few key poses.
+class CameraPath
+{
+public:
+	std::vector<CameraPose> poses;
+
+	// Reads poses from a text file with one pose per line:
+	//   px py pz ox oy oz
+	// giving the position and the direction the camera looks in. Lines starting with # are skipped.
+	// Returns false if the file can't be opened or holds no poses.
+	bool Load(const char* file);
+
+	// Fills the path with count poses on a circle of the given radius and height around center,
+	// each looking at the center.
+	void Orbit(glm::vec3 center, float radius, float height, unsigned int count);
+
+	// Replaces the poses with count poses along a Catmull-Rom spline that passes through
+	// each of the current poses in order. Needs at least two poses.
+	void Spline(unsigned int count);
+
+	// Appends the camera's current pose, call once per frame to record a path.
+	void Record(Camera& camera);
+
+	// Writes the poses in the format Load reads. Returns false if the file can't be written.
+	bool Save(const char* file);
+
+	// Moves the camera to the pose of a frame. Frames past the end wrap around.
+	void Apply(Camera& camera, unsigned int frame);
+};
+
+#endif
@@ -0,0 +1,399 @@
+#include"Environment.h"
+
+#include<stb/stb_image.h>
+#include<fstream>
+#include<iterator>
+#include<cmath>
+#include<algorithm>
+
+const float PI = 3.14159265f;
+
+// GGX samples per texel of the prefiltered levels, and per texel of the lookup table
+const unsigned int ENVIRONMENT_SAMPLES = 256;
+const unsigned int BRDF_LUT_SAMPLES = 512;
+// Directions the irradiance is projected from
+const unsigned int IRRADIANCE_SAMPLES = 4096;
+// Texels per job when generating in parallel
+const unsigned int ENVIRONMENT_BATCH = 256;
+
+// Point number i of count, spread evenly over the unit square
+static glm::vec2 hammersley(unsigned int i, unsigned int count)
+{
+	unsigned int bits = i;
+	bits = (bits << 16u) | (bits >> 16u);
+	bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+	bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+	bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+	bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+	return glm::vec2((float)i / count, bits * 2.3283064365386963e-10f);
+}
+
+// Half vector around +z, picked as often as the GGX distribution of alpha has it
+static glm::vec3 sample_ggx(const glm::vec2& xi, float alpha)
+{
+	float phi = 2.0f * PI * xi.x;
+	float cosTheta = std::sqrt((1.0f - xi.y) / (1.0f + (alpha * alpha - 1.0f) * xi.y));
+	float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+	return glm::vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta);
+}
+
+// Direction through the center of texel (x, y) of a cube map face, in the order and
+// orientation OpenGL gives GL_TEXTURE_CUBE_MAP_POSITIVE_X and the faces after it
+static glm::vec3 cube_direction(unsigned int face, unsigned int x, unsigned int y, unsigned int size)
+{
+	float s = 2.0f * (x + 0.5f) / size - 1.0f;
+	float t = 2.0f * (y + 0.5f) / size - 1.0f;
+	glm::vec3 directions[6] =
+	{
+		glm::vec3(1.0f, -t, -s), glm::vec3(-1.0f, -t, s),
+		glm::vec3(s, 1.0f, t), glm::vec3(s, -1.0f, -t),
+		glm::vec3(s, -t, 1.0f), glm::vec3(-s, -t, -1.0f),
+	};
+	return glm::normalize(directions[face]);
+}
+
+// Light from a sky without an image: a ground below the horizon and a sky that gets
+// bluer towards the zenith, bright enough to stand in for the old flat ambient light
+static glm::vec3 sky_radiance(const glm::vec3& direction)
+{
+	glm::vec3 zenith(0.20f, 0.32f, 0.52f);
+	glm::vec3 horizon(0.46f, 0.48f, 0.50f);
+	glm::vec3 ground(0.12f, 0.11f, 0.10f);
+	float height = std::sqrt(std::fabs(direction.y));
+	if (direction.y >= 0.0f)
+		return glm::mix(horizon, zenith, height);
+	return glm::mix(horizon, ground, std::min(height * 2.0f, 1.0f));
+}
+
+Environment::Environment(const std::string& file, JobSystem* jobs)
+{
+	Environment::jobs = jobs;
+
+	// Decode the image into the first of its mip levels
+	std::vector<char> bytes;
+	if (!file.empty())
+	{
+		std::ifstream in(file, std::ios::binary);
+		bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		if (bytes.empty())
+			std::cout << "ENVIRONMENT_ERROR: Failed to read " << file << ", lighting with the sky instead" << std::endl;
+	}
+
+	// Both keys include the sizes and sample counts, so changing any of them bakes again
+	unsigned int settings[] = { ENVIRONMENT_SIZE, ENVIRONMENT_LEVELS, ENVIRONMENT_SAMPLES, IRRADIANCE_SAMPLES, BRDF_LUT_SIZE, BRDF_LUT_SAMPLES };
+	std::string environmentKey = assetCache.Key(bytes.empty() ? "environment_sky" : "environment",
+	{
+		std::make_pair((const void*)settings, sizeof(unsigned int) * 4),
+		std::make_pair((const void*)bytes.data(), bytes.size()),
+	});
+	std::string lutKey = assetCache.Key("brdf_lut", { std::make_pair((const void*)(settings + 4), sizeof(unsigned int) * 2) });
+
+	// The irradiance goes first, then every level of the cube map, face by face
+	size_t cubeFloats = 0;
+	for (unsigned int level = 0; level < ENVIRONMENT_LEVELS; level++)
+		cubeFloats += 6 * (ENVIRONMENT_SIZE >> level) * (ENVIRONMENT_SIZE >> level) * 3;
+	std::vector<float> environment;
+	std::vector<char> baked;
+	if (assetCache.Load(environmentKey, baked) && baked.size() == (27 + cubeFloats) * sizeof(float))
+		environment.assign((const float*)baked.data(), (const float*)baked.data() + 27 + cubeFloats);
+	else
+	{
+		if (!bytes.empty())
+		{
+			// Flipped like every other image, so the first row is the bottom of the sky
+			int width, height, channels;
+			stbi_set_flip_vertically_on_load(true);
+			float* pixels = stbi_loadf_from_memory((const stbi_uc*)bytes.data(), (int)bytes.size(), &width, &height, &channels, 3);
+			if (pixels == NULL)
+				std::cout << "ENVIRONMENT_ERROR: Failed to decode " << file << ", lighting with the sky instead" << std::endl;
+			else
+			{
+				levels.push_back(std::vector<glm::vec3>((const glm::vec3*)pixels, (const glm::vec3*)pixels + width * height));
+				levelSizes.push_back(glm::ivec2(width, height));
+				stbi_image_free(pixels);
+			}
+		}
+
+		// Halve the image until it is a single row, each texel the average of the four under it
+		while (!levels.empty() && levelSizes.back().y > 1)
+		{
+			glm::ivec2 size = levelSizes.back();
+			glm::ivec2 half = glm::max(size / 2, glm::ivec2(1));
+			std::vector<glm::vec3> level(half.x * half.y);
+			for (int y = 0; y < half.y; y++)
+			{
+				for (int x = 0; x < half.x; x++)
+				{
+					int x0 = std::min(x * 2, size.x - 1), x1 = std::min(x * 2 + 1, size.x - 1);
+					int y0 = std::min(y * 2, size.y - 1), y1 = std::min(y * 2 + 1, size.y - 1);
+					const std::vector<glm::vec3>& source = levels.back();
+					level[y * half.x + x] = (source[y0 * size.x + x0] + source[y0 * size.x + x1] + source[y1 * size.x + x0] + source[y1 * size.x + x1]) * 0.25f;
+				}
+			}
+			levels.push_back(level);
+			levelSizes.push_back(half);
+		}
+
+		generateEnvironment(environment);
+		assetCache.Store(environmentKey, environment.data(), environment.size() * sizeof(float));
+		levels.clear();
+		levelSizes.clear();
+	}
+
+	std::vector<float> lut;
+	if (assetCache.Load(lutKey, baked) && baked.size() == BRDF_LUT_SIZE * BRDF_LUT_SIZE * 2 * sizeof(float))
+		lut.assign((const float*)baked.data(), (const float*)baked.data() + BRDF_LUT_SIZE * BRDF_LUT_SIZE * 2);
+	else
+	{
+		generateLUT(lut, jobs);
+		assetCache.Store(lutKey, lut.data(), lut.size() * sizeof(float));
+	}
+
+	for (unsigned int i = 0; i < 9; i++)
+		irradiance[i] = glm::vec3(environment[i * 3], environment[i * 3 + 1], environment[i * 3 + 2]);
+
+	// Upload the levels, rough reflections pick a blurrier one with textureLod.
+	// Every texel is three half floats on the GPU.
+	prefiltered = GPUHandle::Create(GPU_TEXTURE, VRAM_TEXTURES, (environment.size() - 27) / 3 * 6);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, prefiltered.ID);
+	const float* texels = environment.data() + 27;
+	for (unsigned int level = 0; level < ENVIRONMENT_LEVELS; level++)
+	{
+		unsigned int size = ENVIRONMENT_SIZE >> level;
+		for (unsigned int face = 0; face < 6; face++)
+		{
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGB16F, size, size, 0, GL_RGB, GL_FLOAT, texels);
+			texels += size * size * 3;
+		}
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, ENVIRONMENT_LEVELS - 1);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+	// Filter across the edges of the faces, the small levels would show their seams otherwise
+	glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+	brdfLUT = GPUHandle::Create(GPU_TEXTURE, VRAM_TEXTURES, BRDF_LUT_SIZE * BRDF_LUT_SIZE * 4);
+	glBindTexture(GL_TEXTURE_2D, brdfLUT.ID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, BRDF_LUT_SIZE, BRDF_LUT_SIZE, 0, GL_RG, GL_FLOAT, lut.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void Environment::Bind(Shader& shader)
+{
+	glActiveTexture(GL_TEXTURE0 + ENVIRONMENT_UNIT);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, prefiltered.ID);
+	glActiveTexture(GL_TEXTURE0 + BRDF_LUT_UNIT);
+	glBindTexture(GL_TEXTURE_2D, brdfLUT.ID);
+	glActiveTexture(GL_TEXTURE0);
+
+	shader.Activate();
+	glUniform1i(shader.Uniform("environmentMap"), ENVIRONMENT_UNIT);
+	glUniform1i(shader.Uniform("brdfLUT"), BRDF_LUT_UNIT);
+	glUniform1f(shader.Uniform("environmentLod"), (float)(ENVIRONMENT_LEVELS - 1));
+	glUniform3fv(shader.Uniform("irradianceSH"), 9, &irradiance[0].x);
+}
+
+void Environment::Delete()
+{
+	prefiltered.Reset();
+	brdfLUT.Reset();
+}
+
+glm::vec3 Environment::radiance(const glm::vec3& direction, float lod)
+{
+	if (levels.empty())
+		return sky_radiance(direction);
+
+	// Longitude across the image and latitude up it, the first row is straight down
+	float u = std::atan2(direction.x, -direction.z) / (2.0f * PI) + 0.5f;
+	float v = 1.0f - std::acos(glm::clamp(direction.y, -1.0f, 1.0f)) / PI;
+
+	// Bilinear within a level, wrapping around the longitude, and linear between levels
+	auto sample = [&](unsigned int level)
+	{
+		const glm::ivec2& size = levelSizes[level];
+		float x = u * size.x - 0.5f;
+		float y = glm::clamp(v * size.y - 0.5f, 0.0f, (float)(size.y - 1));
+		int x0 = (int)std::floor(x), y0 = (int)y;
+		float fx = x - x0, fy = y - y0;
+		int y1 = std::min(y0 + 1, size.y - 1);
+		x0 = ((x0 % size.x) + size.x) % size.x;
+		int x1 = (x0 + 1) % size.x;
+		const std::vector<glm::vec3>& texels = levels[level];
+		glm::vec3 bottom = glm::mix(texels[y0 * size.x + x0], texels[y0 * size.x + x1], fx);
+		glm::vec3 top = glm::mix(texels[y1 * size.x + x0], texels[y1 * size.x + x1], fx);
+		return glm::mix(bottom, top, fy);
+	};
+	lod = glm::clamp(lod, 0.0f, (float)(levels.size() - 1));
+	unsigned int level = (unsigned int)lod;
+	if (level + 1 >= levels.size())
+		return sample(level);
+	return glm::mix(sample(level), sample(level + 1), lod - level);
+}
+
+float Environment::lodFor(float solidAngle)
+{
+	if (levels.empty())
+		return 0.0f;
+	float texelAngle = 4.0f * PI / (levelSizes[0].x * levelSizes[0].y);
+	return std::max(0.5f * std::log2(solidAngle / texelAngle), 0.0f);
+}
+
+void Environment::generateEnvironment(std::vector<float>& texels)
+{
+	texels.assign(27, 0.0f);
+
+	// Project the light onto the spherical harmonics from directions spread evenly over the
+	// sphere, each reading the image as blurred as the patch of sky it stands for
+	float sampleAngle = 4.0f * PI / IRRADIANCE_SAMPLES;
+	float sampleLod = lodFor(sampleAngle);
+	glm::vec3 projected[9];
+	for (unsigned int k = 0; k < 9; k++)
+		projected[k] = glm::vec3(0.0f);
+	for (unsigned int i = 0; i < IRRADIANCE_SAMPLES; i++)
+	{
+		float y = 1.0f - 2.0f * (i + 0.5f) / IRRADIANCE_SAMPLES;
+		float r = std::sqrt(1.0f - y * y);
+		float phi = i * 2.39996323f;
+		glm::vec3 d(r * std::cos(phi), y, r * std::sin(phi));
+		glm::vec3 light = radiance(d, sampleLod) * sampleAngle;
+		float basis[9] =
+		{
+			0.282095f,
+			0.488603f * d.y, 0.488603f * d.z, 0.488603f * d.x,
+			1.092548f * d.x * d.y, 1.092548f * d.y * d.z, 0.315392f * (3.0f * d.z * d.z - 1.0f),
+			1.092548f * d.x * d.z, 0.546274f * (d.x * d.x - d.y * d.y),
+		};
+		for (unsigned int k = 0; k < 9; k++)
+			projected[k] += light * basis[k];
+	}
+
+	// Convolve with the cosine lobe and divide by pi, then fold in the basis constants,
+	// so the shader gets the diffuse light with a handful of multiply adds
+	float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f };
+	float constants[9] = { 0.282095f, 0.488603f, 0.488603f, 0.488603f, 1.092548f, 1.092548f, 0.315392f, 1.092548f, 0.546274f };
+	for (unsigned int k = 0; k < 9; k++)
+	{
+		glm::vec3 coefficient = projected[k] * band[k] * constants[k];
+		texels[k * 3] = coefficient.x;
+		texels[k * 3 + 1] = coefficient.y;
+		texels[k * 3 + 2] = coefficient.z;
+	}
+
+	for (unsigned int level = 0; level < ENVIRONMENT_LEVELS; level++)
+	{
+		unsigned int size = ENVIRONMENT_SIZE >> level;
+		float roughness = (float)level / (ENVIRONMENT_LEVELS - 1);
+		float alpha = roughness * roughness;
+
+		// The reflected directions are the same around every texel, only turned, so they are
+		// worked out once per level with the view along the normal, like the split sum assumes.
+		// Each reads the image as blurred as the solid angle its sample stands for.
+		std::vector<glm::vec4> directions;
+		float texelAngle = 4.0f * PI / (6.0f * size * size);
+		if (level == 0)
+			directions.push_back(glm::vec4(0.0f, 0.0f, 1.0f, lodFor(texelAngle)));
+		else
+		{
+			for (unsigned int i = 0; i < ENVIRONMENT_SAMPLES; i++)
+			{
+				glm::vec3 h = sample_ggx(hammersley(i, ENVIRONMENT_SAMPLES), alpha);
+				glm::vec3 l = 2.0f * h.z * h - glm::vec3(0.0f, 0.0f, 1.0f);
+				if (l.z <= 0.0f)
+					continue;
+				float d = (h.z * h.z * (alpha * alpha - 1.0f) + 1.0f);
+				float pdf = alpha * alpha / (PI * d * d) * 0.25f;
+				float solidAngle = 1.0f / (ENVIRONMENT_SAMPLES * pdf);
+				directions.push_back(glm::vec4(l, lodFor(std::max(solidAngle, texelAngle))));
+			}
+		}
+
+		size_t first = texels.size();
+		texels.resize(first + 6 * size * size * 3);
+		parallelFor(6 * size * size, jobs, [&, size, first](unsigned int begin, unsigned int end)
+		{
+			for (unsigned int i = begin; i < end; i++)
+			{
+				unsigned int face = i / (size * size);
+				unsigned int texel = i % (size * size);
+				glm::vec3 n = cube_direction(face, texel % size, texel / size, size);
+				glm::vec3 up = std::fabs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+				glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+				glm::vec3 bitangent = glm::cross(n, tangent);
+
+				// Weighted by how much light each direction brings in at its angle
+				glm::vec3 sum(0.0f);
+				float weight = 0.0f;
+				for (unsigned int k = 0; k < directions.size(); k++)
+				{
+					const glm::vec4& l = directions[k];
+					sum += radiance(tangent * l.x + bitangent * l.y + n * l.z, l.w) * l.z;
+					weight += l.z;
+				}
+				sum /= weight;
+				texels[first + i * 3] = sum.x;
+				texels[first + i * 3 + 1] = sum.y;
+				texels[first + i * 3 + 2] = sum.z;
+			}
+		});
+	}
+}
+
+void Environment::generateLUT(std::vector<float>& texels, JobSystem* jobs)
+{
+	// Across is the cosine between the normal and the view, up is the roughness.
+	// Each texel holds the scale and bias F0 gets to give the GGX specular integrated
+	// over a white environment, with the Smith geometry term for image based lighting.
+	texels.assign(BRDF_LUT_SIZE * BRDF_LUT_SIZE * 2, 0.0f);
+	parallelFor(BRDF_LUT_SIZE * BRDF_LUT_SIZE, jobs, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			float NdotV = (i % BRDF_LUT_SIZE + 0.5f) / BRDF_LUT_SIZE;
+			float roughness = (i / BRDF_LUT_SIZE + 0.5f) / BRDF_LUT_SIZE;
+			float alpha = roughness * roughness;
+			float k = alpha * 0.5f;
+			glm::vec3 v(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+
+			float scale = 0.0f;
+			float bias = 0.0f;
+			for (unsigned int s = 0; s < BRDF_LUT_SAMPLES; s++)
+			{
+				glm::vec3 h = sample_ggx(hammersley(s, BRDF_LUT_SAMPLES), alpha);
+				float VdotH = glm::dot(v, h);
+				glm::vec3 l = 2.0f * VdotH * h - v;
+				float NdotL = l.z;
+				if (NdotL <= 0.0f)
+					continue;
+				float g = NdotV / (NdotV * (1.0f - k) + k) * NdotL / (NdotL * (1.0f - k) + k);
+				float visibility = g * VdotH / (h.z * NdotV);
+				float fresnel = std::pow(1.0f - VdotH, 5.0f);
+				scale += (1.0f - fresnel) * visibility;
+				bias += fresnel * visibility;
+			}
+			texels[i * 2] = scale / BRDF_LUT_SAMPLES;
+			texels[i * 2 + 1] = bias / BRDF_LUT_SAMPLES;
+		}
+	});
+}
+
+void Environment::parallelFor(unsigned int count, JobSystem* jobs, const std::function<void(unsigned int, unsigned int)>& job)
+{
+	if (jobs == NULL || jobs->Size() < 2)
+	{
+		job(0, count);
+		return;
+	}
+	JobCounter counter;
+	jobs->ParallelFor(count, ENVIRONMENT_BATCH, job, counter);
+	jobs->Wait(counter);
+}
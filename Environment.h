@@ -0,0 +1,82 @@
+// If ENVIRONMENT_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef ENVIRONMENT_CLASS_H
+#define ENVIRONMENT_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<string>
+#include<vector>
+
+#include"shaderClass.h"
+#include"JobSystem.h"
+#include"AssetCache.h"
+#include"GPUResources.h"
+
+
+// Texture units the prefiltered environment and the BRDF lookup table are bound to.
+// Units up to 14 are taken by the materials, lights, shadows, morphs, and G-buffer.
+const GLuint ENVIRONMENT_UNIT = 15;
+const GLuint BRDF_LUT_UNIT = 16;
+
+// Width of the sharpest face of the prefiltered cube map. Every level after it is half
+// as wide and blurred for a rougher surface, the last one for a roughness of 1.
+const unsigned int ENVIRONMENT_SIZE = 64;
+const unsigned int ENVIRONMENT_LEVELS = 6;
+// Width and height of the BRDF lookup table, indexed by the view angle and roughness.
+const unsigned int BRDF_LUT_SIZE = 128;
+
+
+// The Environment is the light that reaches the scene from far away, used by the
+// SHADER_PBR variants for image based lighting. Everything the shaders need is worked
+// out ahead of time, so a fragment pays a few lookups instead of integrating the sky:
+//   a cube map prefiltered with the GGX lobe, one mip level per roughness step
+//   the diffuse irradiance, as 9 spherical harmonics coefficients
+//   the split sum BRDF lookup table, the scale and bias the prefiltered color gets
+// They are generated on the CPU, spread over the job system, the first time and baked
+// to the asset cache, so later launches only read them back.
+class Environment
+{
+public:
+	// Builds the lighting of an equirectangular .hdr image, or of a plain sky gradient
+	// if file is empty or can't be read.
+	Environment(const std::string& file = "", JobSystem* jobs = NULL);
+
+	// Binds the textures and points a shader's samplers and irradiance at them.
+	// Only needs to be called once per shader.
+	void Bind(Shader& shader);
+
+	// Deletes the cube map and the lookup table.
+	void Delete();
+
+private:
+	GPUHandle prefiltered;
+	GPUHandle brdfLUT;
+	// Spherical harmonics of the irradiance, already divided by pi and multiplied by
+	// the constants of their basis functions
+	glm::vec3 irradiance[9];
+
+	// Where the generated data is baked
+	AssetCache assetCache;
+	JobSystem* jobs;
+
+	// Mip levels of the equirectangular image, empty for the sky gradient
+	std::vector<std::vector<glm::vec3>> levels;
+	std::vector<glm::ivec2> levelSizes;
+
+	// Returns the light arriving from direction, read from a blurrier level of the image
+	// the larger lod is.
+	glm::vec3 radiance(const glm::vec3& direction, float lod);
+	// Returns the lod at which a texel of the image covers solidAngle steradians.
+	float lodFor(float solidAngle);
+
+	// Fills in the cube map levels and the irradiance from the source.
+	void generateEnvironment(std::vector<float>& texels);
+	// Fills in the RG lookup table.
+	static void generateLUT(std::vector<float>& texels, JobSystem* jobs);
+
+	// Calls job over [0, count), in batches on the job system if there is one.
+	static void parallelFor(unsigned int count, JobSystem* jobs, const std::function<void(unsigned int, unsigned int)>& job);
+};
+
+#endif
@@ -0,0 +1,106 @@
+#include"FrameReader.h"
+
+#include<fstream>
+#include<iostream>
+
+FrameReader::FrameReader(int width, int height)
+{
+	FrameReader::width = width;
+	FrameReader::height = height;
+
+	for (unsigned int i = 0; i < FRAME_READER_BUFFERS; i++)
+	{
+		buffers[i] = GPUHandle::Create(GPU_BUFFER, VRAM_STREAMING, (GLsizeiptr)width * height * 3);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i].ID);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 3, NULL, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void FrameReader::Capture(const std::string& file)
+{
+	// Reuse the oldest slot, waiting for it only if the GPU is more than three frames behind
+	if (fences[next] != NULL)
+		finish(next);
+
+	// Rows of three byte pixels aren't always a multiple of four bytes long
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[next].ID);
+	// With a pack buffer bound this only queues the copy, the last argument is an offset into the buffer
+	glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	files[next] = file;
+	next = (next + 1) % FRAME_READER_BUFFERS;
+}
+
+void FrameReader::Poll()
+{
+	// Check the slots from oldest to newest so images are written in the order they were captured
+	for (unsigned int i = 0; i < FRAME_READER_BUFFERS; i++)
+	{
+		unsigned int slot = (next + i) % FRAME_READER_BUFFERS;
+		if (fences[slot] == NULL)
+			continue;
+		if (glClientWaitSync(fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+			return;
+		finish(slot);
+	}
+}
+
+void FrameReader::Flush()
+{
+	for (unsigned int i = 0; i < FRAME_READER_BUFFERS; i++)
+	{
+		unsigned int slot = (next + i) % FRAME_READER_BUFFERS;
+		if (fences[slot] != NULL)
+			finish(slot);
+	}
+}
+
+void FrameReader::Delete()
+{
+	for (unsigned int i = 0; i < FRAME_READER_BUFFERS; i++)
+	{
+		if (fences[i] != NULL)
+			glDeleteSync(fences[i]);
+		fences[i] = NULL;
+		buffers[i].Reset();
+	}
+}
+
+void FrameReader::finish(unsigned int slot)
+{
+	// Mapping waits for the copy on its own, but flushing first makes sure the fence is ever reached
+	glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+	glDeleteSync(fences[slot]);
+	fences[slot] = NULL;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot].ID);
+	const char* pixels = (const char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)width * height * 3, GL_MAP_READ_BIT);
+	if (pixels != NULL)
+	{
+		// 18 byte TGA header: uncompressed true color, 24 bits per pixel, origin at the bottom left
+		unsigned char header[18] = {};
+		header[2] = 2;
+		header[12] = width & 0xFF;
+		header[13] = (width >> 8) & 0xFF;
+		header[14] = height & 0xFF;
+		header[15] = (height >> 8) & 0xFF;
+		header[16] = 24;
+
+		std::ofstream out(files[slot], std::ios::binary);
+		if (out)
+		{
+			out.write((const char*)header, sizeof(header));
+			out.write(pixels, (std::streamsize)width * height * 3);
+			written++;
+		}
+		else
+			std::cout << "FRAME_READER_WRITE_ERROR for file: " << files[slot] << std::endl;
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
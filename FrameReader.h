@@ -0,0 +1,58 @@
+// If FRAME_READER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef FRAME_READER_CLASS_H
+#define FRAME_READER_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+
+#include"GPUResources.h"
+
+
+// How many frames can be in flight between Capture and the file being written.
+// Three gives the GPU two more frames of work to finish before a copy is waited on.
+const unsigned int FRAME_READER_BUFFERS = 3;
+
+
+// The FrameReader saves rendered frames as images without stalling the CPU on the GPU.
+// Capture only asks for a copy of the framebuffer into a pixel buffer object and puts a
+// fence behind it. Poll writes the copies whose fences have passed, usually a frame or
+// two later, so glReadPixels never waits for the frame to finish drawing.
+// Images are written as uncompressed 24 bit TGA files, which store rows bottom up just
+// like OpenGL does, so no flipping is needed.
+class FrameReader
+{
+public:
+	// Number of images written so far
+	unsigned int written = 0;
+
+	// Creates the pixel buffers for frames of the given size.
+	FrameReader(int width, int height);
+
+	// Starts copying the color buffer of the bound read framebuffer, to be saved as file.
+	// If all buffers are still busy the oldest one is finished first.
+	void Capture(const std::string& file);
+
+	// Writes every capture the GPU has finished, call once per frame.
+	void Poll();
+
+	// Waits for and writes every capture still in flight.
+	void Flush();
+
+	// Deletes the pixel buffers and fences.
+	void Delete();
+
+private:
+	int width;
+	int height;
+	GPUHandle buffers[FRAME_READER_BUFFERS];
+	GLsync fences[FRAME_READER_BUFFERS] = {};
+	std::string files[FRAME_READER_BUFFERS];
+	// Slot the next capture goes to, slots are reused in order
+	unsigned int next = 0;
+
+	// Maps the buffer of a slot and writes its image, then frees the slot.
+	void finish(unsigned int slot);
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include"Framebuffer.h"
+
+#include<iostream>
+
+Framebuffer::Framebuffer(int width, int height)
+{
+	Framebuffer::width = width;
+	Framebuffer::height = height;
+
+	color = GPUHandle::Create(GPU_TEXTURE, VRAM_RENDER_TARGETS, (GLsizeiptr)width * height * 4);
+	glBindTexture(GL_TEXTURE_2D, color.ID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	depth = GPUHandle::Create(GPU_RENDERBUFFER, VRAM_RENDER_TARGETS, (GLsizeiptr)width * height * 4);
+	glBindRenderbuffer(GL_RENDERBUFFER, depth.ID);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	// Put back whatever framebuffer was bound once this one is set up
+	GLint previous = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+
+	ID = GPUHandle::Create(GPU_FRAMEBUFFER, VRAM_RENDER_TARGETS);
+	glBindFramebuffer(GL_FRAMEBUFFER, ID.ID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color.ID, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth.ID);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "FRAMEBUFFER_INCOMPLETE_ERROR" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void Framebuffer::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, ID.ID);
+	glViewport(0, 0, width, height);
+}
+
+void Framebuffer::Delete()
+{
+	color.Reset();
+	depth.Reset();
+	ID.Reset();
+}
@@ -0,0 +1,33 @@
+// If FRAMEBUFFER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef FRAMEBUFFER_CLASS_H
+#define FRAMEBUFFER_CLASS_H
+
+#include<glad/glad.h>
+#include"GPUResources.h"
+
+
+// A Framebuffer is an offscreen render target with a color texture and a depth buffer,
+// used in place of the window when rendering headless.
+//   color  RGBA8 texture
+//   depth  DEPTH24_STENCIL8 renderbuffer, since it is never sampled
+class Framebuffer
+{
+public:
+	// Reference ID of the framebuffer, and what is attached to it
+	GPUHandle ID;
+	GPUHandle color;
+	GPUHandle depth;
+	int width;
+	int height;
+
+	// Creates the framebuffer and its attachments at the given size.
+	Framebuffer(int width, int height);
+
+	// Makes the framebuffer the target of the following draws and reads.
+	void Bind();
+	// Deletes the framebuffer and its attachments.
+	void Delete();
+};
+
+#endif
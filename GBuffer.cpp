@@ -0,0 +1,80 @@
+#include"GBuffer.h"
+
+#include<iostream>
+
+// Creates a screen sized texture that is read with texelFetch, so no filtering is needed
+static GPUHandle create_target(int width, int height, GLint internalFormat, GLenum format, GLenum type, GLsizeiptr bytesPerPixel)
+{
+	GPUHandle texture = GPUHandle::Create(GPU_TEXTURE, VRAM_RENDER_TARGETS, (GLsizeiptr)width * height * bytesPerPixel);
+	glBindTexture(GL_TEXTURE_2D, texture.ID);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texture;
+}
+
+GBuffer::GBuffer(int width, int height)
+{
+	GBuffer::width = width;
+	GBuffer::height = height;
+
+	albedo = create_target(width, height, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+	normal = create_target(width, height, GL_RG16F, GL_RG, GL_FLOAT, 4);
+	material = create_target(width, height, GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2);
+	emissive = create_target(width, height, GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, 4);
+	depth = create_target(width, height, GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, 4);
+
+	// Put back whatever framebuffer was bound once the G-buffer is set up
+	GLint previous = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+
+	ID = GPUHandle::Create(GPU_FRAMEBUFFER, VRAM_RENDER_TARGETS);
+	glBindFramebuffer(GL_FRAMEBUFFER, ID.ID);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo.ID, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal.ID, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, material.ID, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT3, GL_TEXTURE_2D, emissive.ID, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth.ID, 0);
+
+	// The geometry pass writes the first three color targets at once, Bind adds the fourth
+	GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
+	glDrawBuffers(3, drawBuffers);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "GBUFFER_INCOMPLETE_ERROR" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+}
+
+void GBuffer::Bind(bool withEmissive)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, ID.ID);
+	glViewport(0, 0, width, height);
+	GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3 };
+	glDrawBuffers(withEmissive ? 4 : 3, drawBuffers);
+}
+
+void GBuffer::BindTextures()
+{
+	GLuint textures[] = { albedo.ID, normal.ID, material.ID, depth.ID };
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glActiveTexture(GL_TEXTURE0 + GBUFFER_FIRST_UNIT + i);
+		glBindTexture(GL_TEXTURE_2D, textures[i]);
+	}
+	glActiveTexture(GL_TEXTURE0 + GBUFFER_EMISSIVE_UNIT);
+	glBindTexture(GL_TEXTURE_2D, emissive.ID);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void GBuffer::Delete()
+{
+	albedo.Reset();
+	normal.Reset();
+	material.Reset();
+	emissive.Reset();
+	depth.Reset();
+	ID.Reset();
+}
@@ -0,0 +1,53 @@
+// If GBUFFER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef GBUFFER_CLASS_H
+#define GBUFFER_CLASS_H
+
+#include<glad/glad.h>
+#include"GPUResources.h"
+
+
+// First texture unit the G-buffer is bound to for the lighting pass.
+// Units below it hold the material arrays and the light cluster buffers.
+const GLuint GBUFFER_FIRST_UNIT = 5;
+// Unit of the emissive target, which only the PBR lighting pass reads.
+// It comes after the units the materials and the environment use.
+const GLuint GBUFFER_EMISSIVE_UNIT = 17;
+
+
+// The GBuffer is the framebuffer the deferred renderer draws the scene's surfaces into.
+// The lighting pass reads it back instead of evaluating every material per light.
+//   albedo   RGBA8  diffuse color, and the specular map in alpha
+//   normal   RG16F  world space normal, octahedral encoded
+//   material RG8    roughness and metalness from the metallic roughness texture
+//   emissive R11F_G11F_B10F  light given off by PBR materials, only written for them
+//   depth    DEPTH24_STENCIL8, used to rebuild each pixel's world position
+// PBR materials store their base color in albedo and their occlusion in its alpha.
+class GBuffer
+{
+public:
+	// Reference ID of the framebuffer, and the textures attached to it
+	GPUHandle ID;
+	GPUHandle albedo;
+	GPUHandle normal;
+	GPUHandle material;
+	GPUHandle emissive;
+	GPUHandle depth;
+	int width;
+	int height;
+
+	// Creates the framebuffer and its textures at the given size.
+	GBuffer(int width, int height);
+
+	// Makes the G-buffer the target of the following draws.
+	// The emissive target is only drawn to when withEmissive is true, so surfaces
+	// that can't give off light don't pay for writing it.
+	void Bind(bool withEmissive = false);
+	// Binds the albedo, normal, material, and depth textures to GBUFFER_FIRST_UNIT and
+	// the units after it, and the emissive texture to GBUFFER_EMISSIVE_UNIT.
+	void BindTextures();
+	// Deletes the framebuffer and its textures.
+	void Delete();
+};
+
+#endif
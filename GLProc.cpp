@@ -0,0 +1,10 @@
+#include"GLProc.h"
+
+#include<GLFW/glfw3.h>
+
+GLADloadproc gl_proc_loader = (GLADloadproc)glfwGetProcAddress;
+
+void* gl_proc_address(const char* name)
+{
+	return gl_proc_loader(name);
+}
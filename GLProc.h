@@ -0,0 +1,19 @@
+// If GL_PROC_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions during compilation.
+#ifndef GL_PROC_CLASS_H
+#define GL_PROC_CLASS_H
+
+#include<glad/glad.h>
+
+
+// Returns the address of an OpenGL function glad doesn't load, such as the ones from
+// versions or extensions newer than the 3.3 core glad was generated for.
+// Works with whichever API made the current context: GLFW for a window, or EGL for
+// a HeadlessContext. Returns NULL if the driver doesn't have the function.
+void* gl_proc_address(const char* name);
+
+// The loader gl_proc_address asks. It is glfwGetProcAddress unless a HeadlessContext
+// replaced it, and can also be passed to gladLoadGLLoader.
+extern GLADloadproc gl_proc_loader;
+
+#endif
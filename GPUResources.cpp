@@ -0,0 +1,218 @@
+#include"GPUResources.h"
+
+#include<cstdio>
+
+GLsizeiptr GPUResources::bytes[VRAM_CATEGORIES] = { 0 };
+unsigned int GPUResources::objects[VRAM_CATEGORIES] = { 0 };
+GLsizeiptr GPUResources::pendingBytes = 0;
+std::unordered_map<unsigned long long, GPUResources::Object> GPUResources::live;
+std::vector<GPUResources::Released> GPUResources::released;
+std::deque<GPUResources::Retired> GPUResources::retired;
+
+// Names the ledger prints for every category, in VRAMCategory order
+static const char* const VRAM_CATEGORY_NAMES[VRAM_CATEGORIES] =
+{
+	"vertices",
+	"indices",
+	"textures",
+	"uniforms",
+	"render targets",
+	"streaming",
+};
+
+
+GPUHandle::GPUHandle()
+{
+}
+
+GPUHandle::GPUHandle(GPUObjectType type, GLuint ID, VRAMCategory category, GLsizeiptr bytes)
+{
+	GPUHandle::type = type;
+	GPUHandle::ID = ID;
+	if (ID != 0)
+		GPUResources::add(type, ID, category, bytes);
+}
+
+GPUHandle GPUHandle::Create(GPUObjectType type, VRAMCategory category, GLsizeiptr bytes)
+{
+	GLuint ID = 0;
+	switch (type)
+	{
+	case GPU_BUFFER: glGenBuffers(1, &ID); break;
+	case GPU_TEXTURE: glGenTextures(1, &ID); break;
+	case GPU_VERTEX_ARRAY: glGenVertexArrays(1, &ID); break;
+	case GPU_FRAMEBUFFER: glGenFramebuffers(1, &ID); break;
+	case GPU_RENDERBUFFER: glGenRenderbuffers(1, &ID); break;
+	}
+	return GPUHandle(type, ID, category, bytes);
+}
+
+GPUHandle::GPUHandle(GPUHandle&& other)
+{
+	type = other.type;
+	ID = other.ID;
+	other.ID = 0;
+}
+
+GPUHandle& GPUHandle::operator=(GPUHandle&& other)
+{
+	if (this != &other)
+	{
+		Reset();
+		type = other.type;
+		ID = other.ID;
+		other.ID = 0;
+	}
+	return *this;
+}
+
+GPUHandle::~GPUHandle()
+{
+	Reset();
+}
+
+GPUHandle GPUHandle::Share() const
+{
+	GPUHandle shared;
+	shared.type = type;
+	shared.ID = ID;
+	if (ID != 0)
+		GPUResources::retain(type, ID);
+	return shared;
+}
+
+void GPUHandle::Resize(GLsizeiptr bytes)
+{
+	if (ID != 0)
+		GPUResources::resize(type, ID, bytes);
+}
+
+GLsizeiptr GPUHandle::Bytes() const
+{
+	return ID != 0 ? GPUResources::size(type, ID) : 0;
+}
+
+void GPUHandle::Reset()
+{
+	if (ID != 0)
+		GPUResources::release(type, ID);
+	ID = 0;
+}
+
+
+void GPUResources::EndFrame()
+{
+	if (!released.empty())
+	{
+		retired.push_back(Retired{ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::vector<Released>() });
+		retired.back().objects.swap(released);
+	}
+
+	// Fences pass in order, so stop at the first frame the GPU is still working on
+	while (!retired.empty() && glClientWaitSync(retired.front().fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+	{
+		glDeleteSync(retired.front().fence);
+		destroy(retired.front().objects);
+		retired.pop_front();
+	}
+}
+
+void GPUResources::Flush()
+{
+	glFinish();
+	while (!retired.empty())
+	{
+		glDeleteSync(retired.front().fence);
+		destroy(retired.front().objects);
+		retired.pop_front();
+	}
+	destroy(released);
+	released.clear();
+}
+
+GLsizeiptr GPUResources::TotalBytes()
+{
+	GLsizeiptr total = 0;
+	for (unsigned int i = 0; i < VRAM_CATEGORIES; i++)
+		total += bytes[i];
+	return total;
+}
+
+std::string GPUResources::LedgerLine()
+{
+	char part[64];
+	std::snprintf(part, sizeof(part), "VRAM: %.1f MB", TotalBytes() / 1048576.0);
+	std::string line = part;
+	for (unsigned int i = 0; i < VRAM_CATEGORIES; i++)
+	{
+		std::snprintf(part, sizeof(part), ", %s %.1f MB (%u)", VRAM_CATEGORY_NAMES[i], bytes[i] / 1048576.0, objects[i]);
+		line += part;
+	}
+	std::snprintf(part, sizeof(part), ", waiting to be deleted %.1f MB", pendingBytes / 1048576.0);
+	return line + part;
+}
+
+unsigned long long GPUResources::key(GPUObjectType type, GLuint ID)
+{
+	return ((unsigned long long)type << 32) | ID;
+}
+
+void GPUResources::add(GPUObjectType type, GLuint ID, VRAMCategory category, GLsizeiptr bytes)
+{
+	live[key(type, ID)] = Object{ category, bytes, 1 };
+	GPUResources::bytes[category] += bytes;
+	objects[category]++;
+}
+
+void GPUResources::retain(GPUObjectType type, GLuint ID)
+{
+	auto it = live.find(key(type, ID));
+	if (it != live.end())
+		it->second.references++;
+}
+
+void GPUResources::release(GPUObjectType type, GLuint ID)
+{
+	auto it = live.find(key(type, ID));
+	if (it == live.end() || --it->second.references > 0)
+		return;
+
+	Object& object = it->second;
+	bytes[object.category] -= object.bytes;
+	objects[object.category]--;
+	pendingBytes += object.bytes;
+	released.push_back(Released{ type, ID, object.bytes });
+	live.erase(it);
+}
+
+void GPUResources::resize(GPUObjectType type, GLuint ID, GLsizeiptr bytes)
+{
+	auto it = live.find(key(type, ID));
+	if (it == live.end())
+		return;
+	GPUResources::bytes[it->second.category] += bytes - it->second.bytes;
+	it->second.bytes = bytes;
+}
+
+GLsizeiptr GPUResources::size(GPUObjectType type, GLuint ID)
+{
+	auto it = live.find(key(type, ID));
+	return it != live.end() ? it->second.bytes : 0;
+}
+
+void GPUResources::destroy(const std::vector<Released>& objects)
+{
+	for (unsigned int i = 0; i < objects.size(); i++)
+	{
+		const Released& object = objects[i];
+		switch (object.type)
+		{
+		case GPU_BUFFER: glDeleteBuffers(1, &object.ID); break;
+		case GPU_TEXTURE: glDeleteTextures(1, &object.ID); break;
+		case GPU_VERTEX_ARRAY: glDeleteVertexArrays(1, &object.ID); break;
+		case GPU_FRAMEBUFFER: glDeleteFramebuffers(1, &object.ID); break;
+		case GPU_RENDERBUFFER: glDeleteRenderbuffers(1, &object.ID); break;
+		}
+		pendingBytes -= object.bytes;
+	}
+}
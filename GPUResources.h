@@ -0,0 +1,148 @@
+// If GPU_RESOURCES_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef GPU_RESOURCES_CLASS_H
+#define GPU_RESOURCES_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+#include<vector>
+#include<deque>
+#include<unordered_map>
+
+
+// Kinds of OpenGL objects a GPUHandle can own, each is deleted with its own glDelete call.
+enum GPUObjectType
+{
+	GPU_BUFFER,
+	GPU_TEXTURE,
+	GPU_VERTEX_ARRAY,
+	GPU_FRAMEBUFFER,
+	GPU_RENDERBUFFER,
+};
+
+// What the memory of an object is used for, the VRAM ledger adds the bytes up per category.
+enum VRAMCategory
+{
+	VRAM_VERTICES,
+	VRAM_INDICES,
+	VRAM_TEXTURES,
+	VRAM_UNIFORMS,
+	VRAM_RENDER_TARGETS,
+	VRAM_STREAMING,
+	VRAM_CATEGORIES
+};
+
+
+// A GPUHandle owns one OpenGL object and deletes it when it goes away, so a class that
+// keeps its objects in handles can't leak them. Handles can be moved but not copied.
+// An object can still have several owners: Share returns another handle to it, and it
+// is only deleted once every handle is gone.
+// Deleting goes through GPUResources, which waits until the GPU is done with the frames
+// that could still use the object. Handles never call OpenGL when they go away, so they
+// may outlive the context.
+class GPUHandle
+{
+public:
+	// Name of the object, 0 for an empty handle
+	GLuint ID = 0;
+
+	// An empty handle.
+	GPUHandle();
+
+	// Takes ownership of an object made with glGen*, counting bytes of memory under
+	// category in the ledger.
+	GPUHandle(GPUObjectType type, GLuint ID, VRAMCategory category, GLsizeiptr bytes = 0);
+
+	// Makes a new object of type with its glGen function and takes ownership of it.
+	static GPUHandle Create(GPUObjectType type, VRAMCategory category, GLsizeiptr bytes = 0);
+
+	GPUHandle(GPUHandle&& other);
+	GPUHandle& operator=(GPUHandle&& other);
+	GPUHandle(const GPUHandle&) = delete;
+	GPUHandle& operator=(const GPUHandle&) = delete;
+	~GPUHandle();
+
+	// Returns another handle to the same object.
+	GPUHandle Share() const;
+
+	// Changes how many bytes the object is counted with, for example after its storage
+	// was specified again. Shared objects are counted once, whichever handle resizes them.
+	void Resize(GLsizeiptr bytes);
+	GLsizeiptr Bytes() const;
+
+	// Lets go of the object, deleting it once the GPU is done with it if this was the
+	// last handle. The handle is empty afterwards.
+	void Reset();
+
+private:
+	GPUObjectType type = GPU_BUFFER;
+};
+
+
+// GPUResources keeps count of the OpenGL objects held by GPUHandles: how many handles
+// each one has, and how much memory every category uses. An object whose last handle
+// went away is kept until the end of the frame, then a fence goes behind it and it is
+// deleted once the GPU passed that fence, so deleting never stalls on frames in flight.
+class GPUResources
+{
+public:
+	// Bytes and number of objects held in every category, and the bytes of objects
+	// waiting to be deleted
+	static GLsizeiptr bytes[VRAM_CATEGORIES];
+	static unsigned int objects[VRAM_CATEGORIES];
+	static GLsizeiptr pendingBytes;
+
+	// Fences the objects released this frame and deletes the ones whose fence passed.
+	// Call once at the end of every frame.
+	static void EndFrame();
+
+	// Waits for the GPU and deletes every released object, before the context goes away.
+	static void Flush();
+
+	// Returns the bytes held in every category together.
+	static GLsizeiptr TotalBytes();
+
+	// Returns one line with the megabytes and objects of every category.
+	static std::string LedgerLine();
+
+private:
+	friend class GPUHandle;
+
+	struct Object
+	{
+		VRAMCategory category;
+		GLsizeiptr bytes;
+		unsigned int references;
+	};
+
+	// Objects released since the last EndFrame, then behind the fence of that frame
+	struct Released
+	{
+		GPUObjectType type;
+		GLuint ID;
+		GLsizeiptr bytes;
+	};
+	struct Retired
+	{
+		GLsync fence;
+		std::vector<Released> objects;
+	};
+
+	static std::unordered_map<unsigned long long, Object> live;
+	static std::vector<Released> released;
+	static std::deque<Retired> retired;
+
+	// Key of an object in live, names are only unique per type
+	static unsigned long long key(GPUObjectType type, GLuint ID);
+
+	static void add(GPUObjectType type, GLuint ID, VRAMCategory category, GLsizeiptr bytes);
+	static void retain(GPUObjectType type, GLuint ID);
+	static void release(GPUObjectType type, GLuint ID);
+	static void resize(GPUObjectType type, GLuint ID, GLsizeiptr bytes);
+	static GLsizeiptr size(GPUObjectType type, GLuint ID);
+
+	// Calls the glDelete function of every object in the list.
+	static void destroy(const std::vector<Released>& objects);
+};
+
+#endif
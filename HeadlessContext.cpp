@@ -0,0 +1,146 @@
+#include"HeadlessContext.h"
+#include"GLProc.h"
+
+#ifdef __linux__
+#include<EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext()
+{
+#ifdef __linux__
+	// The platform extensions are optional, so look their entry points up at runtime
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	PFNEGLQUERYDEVICESEXTPROC queryDevices = (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+	if (getPlatformDisplay != NULL && createEGL(getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL)))
+	{
+		api = "EGL surfaceless";
+		return;
+	}
+#endif
+	EGLDeviceEXT device;
+	EGLint numDevices = 0;
+	if (getPlatformDisplay != NULL && queryDevices != NULL && queryDevices(1, &device, &numDevices) && numDevices > 0
+		&& createEGL(getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT, device, NULL)))
+	{
+		api = "EGL device";
+		return;
+	}
+	if (createEGL(eglGetDisplay(EGL_DEFAULT_DISPLAY)))
+	{
+		api = "EGL";
+		return;
+	}
+#endif
+
+	if (createGLFW())
+		return;
+}
+
+bool HeadlessContext::Valid()
+{
+	return !api.empty();
+}
+
+std::string HeadlessContext::API()
+{
+	return api;
+}
+
+bool HeadlessContext::LoadGL()
+{
+	return gladLoadGLLoader(gl_proc_loader) != 0;
+}
+
+void HeadlessContext::Delete()
+{
+#ifdef __linux__
+	if (context != EGL_NO_CONTEXT)
+	{
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(display, context);
+		eglTerminate(display);
+		context = EGL_NO_CONTEXT;
+	}
+#endif
+	if (window != NULL)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		window = NULL;
+	}
+	api.clear();
+}
+
+#ifdef __linux__
+bool HeadlessContext::createEGL(EGLDisplay display)
+{
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	// No surface is ever made, but the config still has to support desktop OpenGL
+	EGLint configAttribs[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0 || !eglBindAPI(EGL_OPENGL_API))
+	{
+		eglTerminate(display);
+		return false;
+	}
+
+	EGLint contextAttribs[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+	{
+		if (context != EGL_NO_CONTEXT)
+			eglDestroyContext(display, context);
+		eglTerminate(display);
+		return false;
+	}
+
+	HeadlessContext::display = display;
+	HeadlessContext::context = context;
+	gl_proc_loader = (GLADloadproc)eglGetProcAddress;
+	return true;
+}
+#endif
+
+bool HeadlessContext::createGLFW()
+{
+	if (!glfwInit())
+		return false;
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	// OSMesa renders on the CPU without any window system, if GLFW was built with it
+	glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+	window = glfwCreateWindow(1, 1, "", NULL, NULL);
+	api = "GLFW OSMesa";
+	if (window == NULL)
+	{
+		glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_NATIVE_CONTEXT_API);
+		window = glfwCreateWindow(1, 1, "", NULL, NULL);
+		api = "GLFW (hidden window)";
+	}
+	if (window == NULL)
+	{
+		api.clear();
+		glfwTerminate();
+		return false;
+	}
+
+	glfwMakeContextCurrent(window);
+	gl_proc_loader = (GLADloadproc)glfwGetProcAddress;
+	return true;
+}
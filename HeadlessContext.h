@@ -0,0 +1,56 @@
+// If HEADLESS_CONTEXT_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef HEADLESS_CONTEXT_CLASS_H
+#define HEADLESS_CONTEXT_CLASS_H
+
+#include<glad/glad.h>
+#include<GLFW/glfw3.h>
+#include<string>
+
+#ifdef __linux__
+#include<EGL/egl.h>
+#endif
+
+
+// HeadlessContext makes an OpenGL 3.3 core context current without opening a window,
+// so the renderer can run on servers and in CI. Everything is drawn into framebuffer
+// objects, since there is no window to draw to.
+// On Linux it asks EGL for a display that needs no window system: Mesa's surfaceless
+// platform (llvmpipe when there is no GPU), then the first EGL device, then the default
+// display. If EGL isn't there, or on other systems, it falls back to a hidden GLFW
+// window, using OSMesa if GLFW was built with it and the normal context API otherwise.
+class HeadlessContext
+{
+public:
+	// Creates the context and makes it current. Check Valid() before using it.
+	HeadlessContext();
+
+	// Returns true if a context was created.
+	bool Valid();
+
+	// Returns which API provided the context, such as "EGL surfaceless" or "GLFW (hidden window)".
+	std::string API();
+
+	// Loads the OpenGL functions through glad with the loader of the API that made the context.
+	bool LoadGL();
+
+	// Destroys the context.
+	void Delete();
+
+private:
+	std::string api;
+	// Used by the GLFW fallback
+	GLFWwindow* window = NULL;
+
+#ifdef __linux__
+	EGLDisplay display = EGL_NO_DISPLAY;
+	EGLContext context = EGL_NO_CONTEXT;
+
+	// Tries to make a context on one EGL display, returns true on success
+	bool createEGL(EGLDisplay display);
+#endif
+	// Tries a hidden GLFW window, returns true on success
+	bool createGLFW();
+};
+
+#endif
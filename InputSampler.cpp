@@ -0,0 +1,61 @@
+#include"InputSampler.h"
+
+InputSampler::InputSampler(GLFWwindow* window)
+{
+	InputSampler::window = window;
+
+	// Sticky keys report a press until it is read, even if the key was already released
+	glfwSetInputMode(window, GLFW_STICKY_KEYS, GLFW_TRUE);
+	glfwSetWindowUserPointer(window, this);
+	glfwSetMouseButtonCallback(window, mouseButtonCallback);
+	glfwSetCursorPosCallback(window, cursorPosCallback);
+}
+
+InputState InputSampler::Sample()
+{
+	InputState state;
+	state.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+	state.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+	state.backward = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+	state.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+	state.up = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
+	state.down = glfwGetKey(window, GLFW_KEY_LEFT_CONTROL) == GLFW_PRESS;
+	state.sprint = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
+
+	state.look = look;
+	look = glm::vec2(0.0f, 0.0f);
+	return state;
+}
+
+void InputSampler::mouseButtonCallback(GLFWwindow* window, int button, int action, int /*mods*/)
+{
+	InputSampler* sampler = (InputSampler*)glfwGetWindowUserPointer(window);
+	if (button != GLFW_MOUSE_BUTTON_LEFT)
+		return;
+
+	// Capture the cursor while looking around, so it never stops at the edge of the screen
+	if (action == GLFW_PRESS)
+	{
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+		sampler->looking = true;
+		sampler->firstMove = true;
+	}
+	else if (action == GLFW_RELEASE)
+	{
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+		sampler->looking = false;
+	}
+}
+
+void InputSampler::cursorPosCallback(GLFWwindow* window, double x, double y)
+{
+	InputSampler* sampler = (InputSampler*)glfwGetWindowUserPointer(window);
+	if (!sampler->looking)
+		return;
+
+	if (!sampler->firstMove)
+		sampler->look += glm::vec2((float)(x - sampler->lastX), (float)(y - sampler->lastY));
+	sampler->firstMove = false;
+	sampler->lastX = x;
+	sampler->lastY = y;
+}
@@ -0,0 +1,39 @@
+// If INPUT_SAMPLER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef INPUT_SAMPLER_CLASS_H
+#define INPUT_SAMPLER_CLASS_H
+
+#include<GLFW/glfw3.h>
+
+#include"InputState.h"
+
+
+// The InputSampler collects keyboard and mouse input from a window as GLFW reports it,
+// rather than reading it once per rendered frame. Mouse movement is added up by a
+// callback and keys are sticky, so a tap or a flick that happens between two frames
+// still counts no matter how long the frames take. Sample hands over everything since
+// the last call as an InputState.
+class InputSampler
+{
+public:
+	// Installs the callbacks on the window. Only one sampler can be attached to a window.
+	InputSampler(GLFWwindow* window);
+
+	// Returns the input since the last call and starts collecting anew.
+	InputState Sample();
+
+private:
+	GLFWwindow* window;
+	// True while the left mouse button is held and the cursor is captured
+	bool looking = false;
+	// Set when looking starts, so the jump to the captured cursor isn't counted as movement
+	bool firstMove = true;
+	double lastX = 0.0;
+	double lastY = 0.0;
+	glm::vec2 look = glm::vec2(0.0f, 0.0f);
+
+	static void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
+	static void cursorPosCallback(GLFWwindow* window, double x, double y);
+};
+
+#endif
@@ -0,0 +1,26 @@
+// If INPUT_STATE_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the struct during compilation.
+#ifndef INPUT_STATE_CLASS_H
+#define INPUT_STATE_CLASS_H
+
+#include<glm/glm.hpp>
+
+
+// InputState is a snapshot of the controls that move the camera.
+// It holds no GLFW types, so the camera can be driven by a window, a script, or a test alike.
+struct InputState
+{
+	// Movement keys held during the frame (WASD, Space, Left Control)
+	bool forward = false;
+	bool backward = false;
+	bool left = false;
+	bool right = false;
+	bool up = false;
+	bool down = false;
+	// Left Shift, moves faster
+	bool sprint = false;
+	// How far the mouse moved in pixels while the left button was held, since the last snapshot
+	glm::vec2 look = glm::vec2(0.0f, 0.0f);
+};
+
+#endif
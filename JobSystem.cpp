@@ -0,0 +1,148 @@
+#include"JobSystem.h"
+
+// The system and deque the current thread belongs to, set once by each worker
+static thread_local JobSystem* currentSystem = NULL;
+static thread_local unsigned int currentIndex = 0;
+
+JobSystem::JobSystem(unsigned int numThreads)
+{
+	// The thread waiting for the jobs is the last of the one per core.
+	// A single core gets no workers at all, the waiting thread runs every job.
+	if (numThreads == 0)
+	{
+		unsigned int hardware = std::thread::hardware_concurrency();
+		numThreads = hardware > 1 ? hardware - 1 : 0;
+	}
+
+	for (unsigned int i = 0; i <= numThreads; i++)
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	for (unsigned int i = 1; i <= numThreads; i++)
+		workers.push_back(std::thread(&JobSystem::workerLoop, this, i));
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void JobSystem::Run(std::function<void()> job, JobCounter& counter)
+{
+	counter.pending.fetch_add(1);
+	push(currentQueue(), Job{ std::move(job), &counter });
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_one();
+}
+
+void JobSystem::ParallelFor(unsigned int count, unsigned int batchSize, std::function<void(unsigned int, unsigned int)> job, JobCounter& counter)
+{
+	if (count == 0)
+		return;
+	batchSize = batchSize > 0 ? batchSize : 1;
+
+	// Queue every batch first and wake the workers once, they steal the batches from the front
+	unsigned int queue = currentQueue();
+	for (unsigned int begin = 0; begin < count; begin += batchSize)
+	{
+		unsigned int end = begin + batchSize < count ? begin + batchSize : count;
+		counter.pending.fetch_add(1);
+		push(queue, Job{ [job, begin, end]() { job(begin, end); }, &counter });
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	wake.notify_all();
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	// Help out instead of sleeping, the jobs being waited on may be sitting in this thread's deque
+	unsigned int queue = currentQueue();
+	while (counter.pending.load(std::memory_order_acquire) > 0)
+	{
+		if (!runOne(queue))
+			std::this_thread::yield();
+	}
+}
+
+unsigned int JobSystem::Size()
+{
+	return (unsigned int)workers.size() + 1;
+}
+
+unsigned int JobSystem::currentQueue()
+{
+	return currentSystem == this ? currentIndex : 0;
+}
+
+void JobSystem::push(unsigned int queue, Job job)
+{
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		queues[queue]->jobs.push_back(std::move(job));
+	}
+	queued.fetch_add(1);
+}
+
+bool JobSystem::runOne(unsigned int queue)
+{
+	Job job;
+	bool found = false;
+
+	// Newest job of the own deque first, its data is the most likely to still be in the cache
+	{
+		std::lock_guard<std::mutex> lock(queues[queue]->mutex);
+		if (!queues[queue]->jobs.empty())
+		{
+			job = std::move(queues[queue]->jobs.back());
+			queues[queue]->jobs.pop_back();
+			found = true;
+		}
+	}
+
+	// Otherwise steal the oldest job of the next deque that has one
+	for (unsigned int i = 1; i < queues.size() && !found; i++)
+	{
+		Queue& victim = *queues[(queue + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.jobs.empty())
+		{
+			job = std::move(victim.jobs.front());
+			victim.jobs.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+	queued.fetch_sub(1);
+	job.function();
+	job.counter->pending.fetch_sub(1, std::memory_order_release);
+	return true;
+}
+
+void JobSystem::workerLoop(unsigned int queue)
+{
+	currentSystem = this;
+	currentIndex = queue;
+
+	while (true)
+	{
+		if (runOne(queue))
+			continue;
+
+		// Sleep until a job is queued, or exit once stopping with nothing left
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+		if (stopping && queued.load() == 0)
+			return;
+	}
+}
@@ -0,0 +1,93 @@
+// If JOB_SYSTEM_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef JOB_SYSTEM_CLASS_H
+#define JOB_SYSTEM_CLASS_H
+
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<atomic>
+#include<deque>
+#include<memory>
+#include<vector>
+
+
+// Counts the jobs of one fork that haven't finished yet. Every job is run with a
+// counter, and JobSystem::Wait on it returns once all of them are done (the join).
+struct JobCounter
+{
+	std::atomic<unsigned int> pending{ 0 };
+};
+
+// The JobSystem runs short CPU jobs within a frame, such as sampling animations and
+// updating transforms, on one worker per core. Unlike the ThreadPool, whose jobs run
+// in the background for as long as they take, the thread that forks jobs waits for
+// them right away and runs jobs itself while it waits.
+// Every thread has its own deque of jobs. It pushes and pops its own jobs at the back,
+// newest first, and when it runs out it steals the oldest job from another thread's
+// front, so the work spreads out without every thread fighting over one queue.
+// Jobs must not touch OpenGL, only the thread that owns the context may.
+class JobSystem
+{
+public:
+	// Starts numThreads workers. 0 means one worker per hardware thread minus one,
+	// since the thread waiting for the jobs runs them as well.
+	// Callers can check Size() and skip splitting their work when it is 1.
+	JobSystem(unsigned int numThreads = 0);
+
+	// Finishes the queued jobs and joins all workers.
+	~JobSystem();
+
+	// Queues a job on the calling thread's deque and adds it to counter.
+	void Run(std::function<void()> job, JobCounter& counter);
+
+	// Splits [0, count) into batches of batchSize and queues one job per batch,
+	// each calling job(begin, end).
+	void ParallelFor(unsigned int count, unsigned int batchSize, std::function<void(unsigned int, unsigned int)> job, JobCounter& counter);
+
+	// Runs queued jobs until every job counted by counter is done.
+	void Wait(JobCounter& counter);
+
+	// Returns how many threads run jobs, the workers plus the waiting thread.
+	unsigned int Size();
+
+private:
+	struct Job
+	{
+		std::function<void()> function;
+		JobCounter* counter;
+	};
+
+	// A thread's deque and the lock guarding it
+	struct Queue
+	{
+		std::deque<Job> jobs;
+		std::mutex mutex;
+	};
+
+	// One deque per worker, plus deque 0 for threads outside the system such as the render thread
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+
+	// Jobs in all deques, workers sleep while it is 0
+	std::atomic<unsigned int> queued{ 0 };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// Returns the deque of the calling thread.
+	unsigned int currentQueue();
+
+	// Adds a job to a deque without waking anyone.
+	void push(unsigned int queue, Job job);
+
+	// Runs the newest job of the thread's own deque, or steals the oldest job of another.
+	// Returns false if every deque was empty.
+	bool runOne(unsigned int queue);
+
+	// Loop every worker runs until the system stops.
+	void workerLoop(unsigned int queue);
+};
+
+#endif
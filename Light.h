@@ -0,0 +1,33 @@
+// If LIGHT_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the struct during compilation.
+#ifndef LIGHT_CLASS_H
+#define LIGHT_CLASS_H
+
+#include<glm/glm.hpp>
+
+
+// The kinds of local light the clustered lighting pass knows about.
+enum LightType
+{
+	LIGHT_POINT = 0,
+	LIGHT_SPOT = 1,
+};
+
+// A point or spot light in world space.
+// Every light has a radius past which it adds nothing, which is what lets it be
+// assigned to only the clusters it actually reaches.
+struct Light
+{
+	LightType type = LIGHT_POINT;
+	glm::vec3 position = glm::vec3(0.0f);
+	// Distance at which the light has faded out completely
+	float radius = 1.0f;
+	glm::vec3 color = glm::vec3(1.0f);
+	// Spot lights only: the direction the cone points in, and the cosines of the
+	// angles where the cone starts to fade and where it ends
+	glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+	float innerCone = 0.95f;
+	float outerCone = 0.90f;
+};
+
+#endif
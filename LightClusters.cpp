@@ -0,0 +1,301 @@
+#include"LightClusters.h"
+
+#include<cmath>
+#include<algorithm>
+#include<mutex>
+#include<condition_variable>
+
+// SSE is always there on x86 and x64. Other targets use the plain loop below.
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+#include<xmmintrin.h>
+#define CLUSTERS_SSE
+#endif
+
+// Each slice is tested four clusters at a time, so it has to hold a multiple of four
+static_assert((CLUSTER_X * CLUSTER_Y) % 4 == 0, "clusters per slice must be a multiple of 4");
+
+// Fewer visible lights than this are assigned on the render thread alone,
+// since waking the workers would cost more than it saves
+const unsigned int CLUSTER_PARALLEL_LIGHTS = 32;
+
+// std140 layout of the Clusters block in default.frag
+struct ClusterParams
+{
+	GLuint count[4];
+	GLfloat tileSize[2];
+	GLfloat sliceScale;
+	GLfloat sliceBias;
+	GLfloat nearPlane;
+	GLfloat farPlane;
+	GLfloat padding[2];
+};
+
+// Creates a buffer and a buffer texture viewing it with the given format
+static void create_texture_buffer(GPUHandle& buffer, GPUHandle& texture, GLenum format)
+{
+	buffer = GPUHandle::Create(GPU_BUFFER, VRAM_UNIFORMS, 16);
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer.ID);
+	glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+	texture = GPUHandle::Create(GPU_TEXTURE, VRAM_UNIFORMS);
+	glBindTexture(GL_TEXTURE_BUFFER, texture.ID);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer.ID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Replaces the contents of a texture buffer, orphaning the old storage so the
+// upload doesn't wait for draws from the last frame that still read it
+static void upload_texture_buffer(GPUHandle& buffer, const void* data, GLsizeiptr size)
+{
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer.ID);
+	glBufferData(GL_TEXTURE_BUFFER, std::max(size, (GLsizeiptr)16), NULL, GL_STREAM_DRAW);
+	if (size > 0)
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	buffer.Resize(std::max(size, (GLsizeiptr)16));
+}
+
+LightClusters::LightClusters()
+{
+	create_texture_buffer(lightBuffer, lightTexture, GL_RGBA32F);
+	create_texture_buffer(gridBuffer, gridTexture, GL_RG32UI);
+	create_texture_buffer(indexBuffer, indexTexture, GL_R16UI);
+
+	clusterUBO = GPUHandle::Create(GPU_BUFFER, VRAM_UNIFORMS, sizeof(ClusterParams));
+	glBindBuffer(GL_UNIFORM_BUFFER, clusterUBO.ID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ClusterParams), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	minX.resize(CLUSTER_COUNT); minY.resize(CLUSTER_COUNT); minZ.resize(CLUSTER_COUNT);
+	maxX.resize(CLUSTER_COUNT); maxY.resize(CLUSTER_COUNT); maxZ.resize(CLUSTER_COUNT);
+	clusterCounts.resize(CLUSTER_COUNT);
+	clusterLights.resize(CLUSTER_COUNT * MAX_LIGHTS_PER_CLUSTER);
+	gridData.resize(CLUSTER_COUNT * 2);
+}
+
+void LightClusters::Update(Camera& camera)
+{
+	// The cluster boxes only depend on the projection, so they are reused while it stays the same
+	float aspect = (float)camera.width / camera.height;
+	if (camera.FOVdeg != builtFOV || aspect != builtAspect || camera.nearPlane != builtNear || camera.farPlane != builtFar)
+		buildClusters(camera);
+
+	// Move every light into view space and drop the ones outside the depth range.
+	// Their slice range is worked out here so the workers only look at slices a light reaches.
+	unsigned int numLights = (unsigned int)std::min(lights.size(), (size_t)MAX_LIGHTS);
+	viewLights.clear();
+	lightData.resize(numLights * 4);
+	for (unsigned int i = 0; i < numLights; i++)
+	{
+		const Light& light = lights[i];
+		lightData[i * 4 + 0] = glm::vec4(light.position, light.radius);
+		lightData[i * 4 + 1] = glm::vec4(light.color, (float)light.type);
+		lightData[i * 4 + 2] = glm::vec4(glm::normalize(light.direction), light.innerCone);
+		lightData[i * 4 + 3] = glm::vec4(light.outerCone, 0.0f, 0.0f, 0.0f);
+
+		glm::vec3 center = glm::vec3(camera.view * glm::vec4(light.position, 1.0f));
+		float depth = -center.z;
+		if (depth + light.radius < camera.nearPlane || depth - light.radius > camera.farPlane)
+			continue;
+
+		ViewLight viewLight;
+		viewLight.x = center.x;
+		viewLight.y = center.y;
+		viewLight.z = center.z;
+		viewLight.radius = light.radius;
+		viewLight.firstSlice = sliceOf(depth - light.radius);
+		viewLight.lastSlice = sliceOf(depth + light.radius);
+		viewLight.index = (unsigned short)i;
+		viewLights.push_back(viewLight);
+	}
+
+	// Assign the lights slice by slice. Every slice only writes its own clusters,
+	// so the workers need no locking, just a count of how many are still busy.
+	unsigned int chunks = viewLights.size() < CLUSTER_PARALLEL_LIGHTS ? 1 : std::min(pool.Size() + 1, CLUSTER_Z);
+	std::mutex doneMutex;
+	std::condition_variable done;
+	unsigned int pending = chunks - 1;
+	for (unsigned int chunk = 1; chunk < chunks; chunk++)
+	{
+		pool.Submit([&, chunk]()
+		{
+			assignSlices(CLUSTER_Z * chunk / chunks, CLUSTER_Z * (chunk + 1) / chunks);
+			std::lock_guard<std::mutex> lock(doneMutex);
+			pending--;
+			done.notify_one();
+		});
+	}
+	assignSlices(0, CLUSTER_Z / chunks);
+	{
+		std::unique_lock<std::mutex> lock(doneMutex);
+		done.wait(lock, [&] { return pending == 0; });
+	}
+
+	// Pack the per cluster lists into one index list with an offset and count per cluster
+	indexData.clear();
+	for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++)
+	{
+		gridData[cluster * 2 + 0] = (GLuint)indexData.size();
+		gridData[cluster * 2 + 1] = clusterCounts[cluster];
+		const unsigned short* list = &clusterLights[cluster * MAX_LIGHTS_PER_CLUSTER];
+		indexData.insert(indexData.end(), list, list + clusterCounts[cluster]);
+	}
+	assignedLights = (unsigned int)indexData.size();
+
+	// Count the lights that made it into any cluster
+	visibleLights = 0;
+	std::vector<bool> seen(numLights, false);
+	for (unsigned int i = 0; i < indexData.size(); i++)
+	{
+		if (!seen[indexData[i]])
+			visibleLights++;
+		seen[indexData[i]] = true;
+	}
+
+	upload_texture_buffer(lightBuffer, lightData.data(), lightData.size() * sizeof(glm::vec4));
+	upload_texture_buffer(gridBuffer, gridData.data(), gridData.size() * sizeof(GLuint));
+	upload_texture_buffer(indexBuffer, indexData.data(), indexData.size() * sizeof(unsigned short));
+
+	// Bind everything where Bind told the shaders to look
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_LIGHTS_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, lightTexture.ID);
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_GRID_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, gridTexture.ID);
+	glActiveTexture(GL_TEXTURE0 + CLUSTER_INDICES_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, indexTexture.ID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, CLUSTER_UBO_BINDING, clusterUBO.ID);
+}
+
+void LightClusters::Bind(Shader& shader)
+{
+	shader.Activate();
+	glUniform1i(shader.Uniform("clusterLights"), CLUSTER_LIGHTS_UNIT);
+	glUniform1i(shader.Uniform("clusterGrid"), CLUSTER_GRID_UNIT);
+	glUniform1i(shader.Uniform("clusterIndices"), CLUSTER_INDICES_UNIT);
+
+	GLuint blockIndex = glGetUniformBlockIndex(shader.ID, "Clusters");
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader.ID, blockIndex, CLUSTER_UBO_BINDING);
+}
+
+void LightClusters::Delete()
+{
+	lightTexture.Reset();
+	gridTexture.Reset();
+	indexTexture.Reset();
+	lightBuffer.Reset();
+	gridBuffer.Reset();
+	indexBuffer.Reset();
+	clusterUBO.Reset();
+}
+
+void LightClusters::buildClusters(Camera& camera)
+{
+	builtFOV = camera.FOVdeg;
+	builtAspect = (float)camera.width / camera.height;
+	builtNear = camera.nearPlane;
+	builtFar = camera.farPlane;
+
+	// Half the size of the view at a distance of 1
+	float halfHeight = std::tan(glm::radians(builtFOV) * 0.5f);
+	float halfWidth = halfHeight * builtAspect;
+
+	for (unsigned int z = 0; z < CLUSTER_Z; z++)
+	{
+		// Slices grow exponentially with distance, so clusters stay roughly cube shaped
+		float sliceNear = builtNear * std::pow(builtFar / builtNear, (float)z / CLUSTER_Z);
+		float sliceFar = builtNear * std::pow(builtFar / builtNear, (float)(z + 1) / CLUSTER_Z);
+
+		for (unsigned int y = 0; y < CLUSTER_Y; y++)
+		{
+			float bottom = -1.0f + 2.0f * y / CLUSTER_Y;
+			float top = -1.0f + 2.0f * (y + 1) / CLUSTER_Y;
+			for (unsigned int x = 0; x < CLUSTER_X; x++)
+			{
+				float left = -1.0f + 2.0f * x / CLUSTER_X;
+				float right = -1.0f + 2.0f * (x + 1) / CLUSTER_X;
+
+				// The cluster's box has to hold its tile's corners at both ends of the slice
+				unsigned int cluster = x + CLUSTER_X * (y + CLUSTER_Y * z);
+				minX[cluster] = std::min(left * sliceNear, left * sliceFar) * halfWidth;
+				maxX[cluster] = std::max(right * sliceNear, right * sliceFar) * halfWidth;
+				minY[cluster] = std::min(bottom * sliceNear, bottom * sliceFar) * halfHeight;
+				maxY[cluster] = std::max(top * sliceNear, top * sliceFar) * halfHeight;
+				minZ[cluster] = -sliceFar;
+				maxZ[cluster] = -sliceNear;
+			}
+		}
+	}
+
+	// The shaders find a fragment's cluster with the same slicing
+	float logRatio = std::log(builtFar / builtNear);
+	ClusterParams params =
+	{
+		{ CLUSTER_X, CLUSTER_Y, CLUSTER_Z, 0 },
+		{ (float)camera.width / CLUSTER_X, (float)camera.height / CLUSTER_Y },
+		CLUSTER_Z / logRatio,
+		CLUSTER_Z * std::log(builtNear) / logRatio,
+		builtNear,
+		builtFar,
+		{ 0.0f, 0.0f }
+	};
+	glBindBuffer(GL_UNIFORM_BUFFER, clusterUBO.ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(params), &params);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+unsigned int LightClusters::sliceOf(float depth)
+{
+	if (depth <= builtNear)
+		return 0;
+	float slice = std::log(depth / builtNear) / std::log(builtFar / builtNear) * CLUSTER_Z;
+	return std::min((unsigned int)slice, CLUSTER_Z - 1);
+}
+
+void LightClusters::assignSlices(unsigned int firstSlice, unsigned int lastSlice)
+{
+	const unsigned int perSlice = CLUSTER_X * CLUSTER_Y;
+	for (unsigned int z = firstSlice; z < lastSlice; z++)
+	{
+		unsigned int sliceStart = z * perSlice;
+		std::fill(clusterCounts.begin() + sliceStart, clusterCounts.begin() + sliceStart + perSlice, 0);
+
+		for (unsigned int i = 0; i < viewLights.size(); i++)
+		{
+			const ViewLight& light = viewLights[i];
+			if (z < light.firstSlice || z > light.lastSlice)
+				continue;
+
+			// A sphere touches a box when the closest point of the box is within its radius
+			for (unsigned int c = sliceStart; c < sliceStart + perSlice; c += 4)
+			{
+#ifdef CLUSTERS_SSE
+				__m128 zero = _mm_setzero_ps();
+				__m128 cx = _mm_set1_ps(light.x), cy = _mm_set1_ps(light.y), cz = _mm_set1_ps(light.z);
+				__m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minX[c]), cx), zero), _mm_max_ps(_mm_sub_ps(cx, _mm_loadu_ps(&maxX[c])), zero));
+				__m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minY[c]), cy), zero), _mm_max_ps(_mm_sub_ps(cy, _mm_loadu_ps(&maxY[c])), zero));
+				__m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&minZ[c]), cz), zero), _mm_max_ps(_mm_sub_ps(cz, _mm_loadu_ps(&maxZ[c])), zero));
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				int hits = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_set1_ps(light.radius * light.radius)));
+#else
+				int hits = 0;
+				for (unsigned int j = 0; j < 4; j++)
+				{
+					float dx = std::max(minX[c + j] - light.x, 0.0f) + std::max(light.x - maxX[c + j], 0.0f);
+					float dy = std::max(minY[c + j] - light.y, 0.0f) + std::max(light.y - maxY[c + j], 0.0f);
+					float dz = std::max(minZ[c + j] - light.z, 0.0f) + std::max(light.z - maxZ[c + j], 0.0f);
+					if (dx * dx + dy * dy + dz * dz <= light.radius * light.radius)
+						hits |= 1 << j;
+				}
+#endif
+				for (unsigned int j = 0; j < 4; j++)
+				{
+					// Clusters that are full drop the rest of their lights
+					if ((hits & (1 << j)) && clusterCounts[c + j] < MAX_LIGHTS_PER_CLUSTER)
+						clusterLights[(c + j) * MAX_LIGHTS_PER_CLUSTER + clusterCounts[c + j]++] = light.index;
+				}
+			}
+		}
+	}
+}
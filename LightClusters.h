@@ -0,0 +1,109 @@
+// If LIGHT_CLUSTERS_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef LIGHT_CLUSTERS_CLASS_H
+#define LIGHT_CLUSTERS_CLASS_H
+
+#include<glad/glad.h>
+#include<vector>
+
+#include"Light.h"
+#include"Camera.h"
+#include"ThreadPool.h"
+#include"GPUResources.h"
+
+
+// Size of the cluster grid: tiles across, tiles down, and depth slices.
+// The shaders read it from the Clusters block, so it can be changed here alone.
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 9;
+const unsigned int CLUSTER_Z = 24;
+const unsigned int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// Most lights the grid is built from, and most lights a single cluster can list.
+const unsigned int MAX_LIGHTS = 4096;
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+
+// Texture units and uniform buffer binding the cluster data is bound to.
+// Units 0 and 1 are taken by the material texture arrays.
+const GLuint CLUSTER_LIGHTS_UNIT = 2;
+const GLuint CLUSTER_GRID_UNIT = 3;
+const GLuint CLUSTER_INDICES_UNIT = 4;
+const GLuint CLUSTER_UBO_BINDING = 1;
+
+
+// LightClusters implements clustered forward lighting. The camera's view frustum is cut
+// into a grid of CLUSTER_X by CLUSTER_Y screen tiles and CLUSTER_Z exponential depth slices.
+// Every frame the lights are tested against the bounding box of each cluster on the CPU,
+// four clusters at a time with SSE and with the depth slices split over worker threads.
+// The result goes to the GPU through texture buffers: every light's data, an offset and
+// count per cluster, and the light indices the counts refer to. A fragment compiled with
+// SHADER_CLUSTERED_LIGHTS finds its cluster from its screen position and depth, and only
+// shades the lights listed there.
+class LightClusters
+{
+public:
+	// The point and spot lights of the scene, change them freely between frames.
+	std::vector<Light> lights;
+
+	// Lights that reached at least one cluster, and light indices over all clusters,
+	// both from the last Update.
+	unsigned int visibleLights = 0;
+	unsigned int assignedLights = 0;
+
+	// Creates the buffers and starts the worker threads.
+	LightClusters();
+
+	// Assigns the lights to the clusters of this camera's frustum and uploads the result.
+	// Call once per frame after camera.updateMatrix and before drawing.
+	void Update(Camera& camera);
+
+	// Points a shader's cluster samplers and Clusters block at the data Update binds.
+	// Only needs to be called once per shader.
+	void Bind(Shader& shader);
+
+	// Deletes the buffers and textures.
+	void Delete();
+
+private:
+	// Texture buffers: RGBA32F light data (4 texels per light), RG32UI offset and count
+	// per cluster, and R16UI light indices
+	GPUHandle lightBuffer, lightTexture;
+	GPUHandle gridBuffer, gridTexture;
+	GPUHandle indexBuffer, indexTexture;
+	GPUHandle clusterUBO;
+
+	// View space bounding box of every cluster, one array per bound so four clusters
+	// load into one SSE register. Rebuilt when the projection changes.
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	float builtFOV = 0.0f, builtAspect = 0.0f, builtNear = 0.0f, builtFar = 0.0f;
+
+	// A light that survived culling: its view space sphere and the slices it spans
+	struct ViewLight
+	{
+		float x, y, z, radius;
+		unsigned int firstSlice, lastSlice;
+		unsigned short index;
+	};
+	std::vector<ViewLight> viewLights;
+
+	// Per cluster light lists written by the workers, MAX_LIGHTS_PER_CLUSTER slots each
+	std::vector<unsigned short> clusterCounts;
+	std::vector<unsigned short> clusterLights;
+
+	// Packed data uploaded to the texture buffers
+	std::vector<glm::vec4> lightData;
+	std::vector<GLuint> gridData;
+	std::vector<unsigned short> indexData;
+
+	// Workers that assign lights to the depth slices
+	ThreadPool pool;
+
+	// Computes the bounding boxes of every cluster for the camera's projection
+	void buildClusters(Camera& camera);
+	// Returns the depth slice a view space distance falls in
+	unsigned int sliceOf(float depth);
+	// Fills in the light lists of the clusters in slices [firstSlice, lastSlice)
+	void assignSlices(unsigned int firstSlice, unsigned int lastSlice);
+};
+
+#endif
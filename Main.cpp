@@ -3,44 +3,226 @@
 namespace fs = std::filesystem;
 
 #include"Model.h"
+#include"ShaderWatcher.h"
+#include"LightClusters.h"
+#include"Renderer.h"
+#include"ShadowCascades.h"
+#include"HeadlessContext.h"
+#include"Framebuffer.h"
+#include"FrameReader.h"
+#include"CameraPath.h"
+#include"Benchmark.h"
+#include"Profiler.h"
+#include"InputSampler.h"
+#include"JobSystem.h"
+#include"Environment.h"
+#include"StreamBuffer.h"
+#include"GPUResources.h"
+#include"SceneStreamer.h"
 
-const unsigned int width = 800;
-const unsigned int height = 800;
-
-int main()
+int main(int argc, char** argv)
 {
-	// Initialize GLFW
-	glfwInit();
-
-	// Tell GLFW which version of OpenGL to use (3.3 in this case)
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	unsigned int width = 800;
+	unsigned int height = 800;
 
-	// Use the core profile, which gives access only to modern OpenGL functions
-	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	/*
+	* Command line options:
+	*   --headless        render without a window, into an offscreen framebuffer
+	*   --benchmark file  replay the camera path and write frame times and draw statistics to a JSON file
+	*   --frames N        number of frames to render, save, or measure (default 60)
+	*   --size WxH        resolution of the frames (default 800x800)
+	*   --poses file      camera poses to render from, see CameraPath::Load (default an orbit around the model)
+	*   --spline          use the poses as keys of a smooth spline stretched over all the frames
+	*   --record file     save the path flown with the keyboard and mouse, to replay it with --poses
+	*   --trace file      profile every frame and write the timings as a Chrome trace when the program ends
+	*   --profile-meshes  time every mesh draw as well, not just the passes
+	*   --deferred        start with deferred shading
+	*   --prepass         start with the depth pre-pass on
+	*   --out dir         directory headless frames are saved to as frame_0000.tga and so on (default "frames")
+	*   --model file      glTF file to load instead of the default model
+	*   --scene file      regions of a large scene, loaded and unloaded around the camera as it moves, see SceneStreamer::Load
+	*   --animation N     which of the model's animations to play (default 0, the first)
+	*   --cpu-skinning    skin animated meshes on the CPU instead of in the vertex shader
+	*   --cpu-morphing    blend morph targets on the CPU instead of in the vertex shader
+	*   --pbr             start with the glTF metallic roughness materials instead of Blinn-Phong
+	*   --environment file  equirectangular .hdr image the PBR materials are lit by (default a sky gradient)
+	*/
+	bool headless = false;
+	unsigned int frames = 60;
+	std::string benchmarkFile;
+	std::string posesFile;
+	bool spline = false;
+	std::string recordFile;
+	std::string traceFile;
+	bool profileMeshes = false;
+	bool deferred = false;
+	bool prepass = false;
+	std::string outDir = "frames";
+	std::string modelFile;
+	std::string sceneFile;
+	unsigned int animation = 0;
+	bool cpuSkinning = false;
+	bool cpuMorphing = false;
+	bool pbr = false;
+	std::string environmentFile;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--headless")
+			headless = true;
+		else if (arg == "--benchmark" && hasValue)
+			benchmarkFile = argv[++i];
+		else if (arg == "--spline")
+			spline = true;
+		else if (arg == "--record" && hasValue)
+			recordFile = argv[++i];
+		else if (arg == "--trace" && hasValue)
+			traceFile = argv[++i];
+		else if (arg == "--profile-meshes")
+			profileMeshes = true;
+		else if (arg == "--deferred")
+			deferred = true;
+		else if (arg == "--prepass")
+			prepass = true;
+		else if (arg == "--frames" && hasValue)
+			frames = (unsigned int)std::stoul(argv[++i]);
+		else if (arg == "--size" && hasValue)
+			std::sscanf(argv[++i], "%ux%u", &width, &height);
+		else if (arg == "--poses" && hasValue)
+			posesFile = argv[++i];
+		else if (arg == "--out" && hasValue)
+			outDir = argv[++i];
+		else if (arg == "--model" && hasValue)
+			modelFile = argv[++i];
+		else if (arg == "--scene" && hasValue)
+			sceneFile = argv[++i];
+		else if (arg == "--animation" && hasValue)
+			animation = (unsigned int)std::stoul(argv[++i]);
+		else if (arg == "--cpu-skinning")
+			cpuSkinning = true;
+		else if (arg == "--cpu-morphing")
+			cpuMorphing = true;
+		else if (arg == "--pbr")
+			pbr = true;
+		else if (arg == "--environment" && hasValue)
+			environmentFile = argv[++i];
+		else
+			std::cout << "Unknown option: " << arg << std::endl;
+	}
 
-	// Create a GLFW window with a resolution of 800x800 pixels
-	GLFWwindow* window = glfwCreateWindow(width, height, "OpenGL 3D Rendering", NULL, NULL);
+	// Headless runs and benchmarks follow a camera path for a fixed number of frames
+	bool benchmarking = !benchmarkFile.empty();
+	bool scripted = headless || benchmarking;
 
-	// Check if the window failed to create
-	if (window == NULL)
+	// Headless rendering makes its context without a window and draws into a framebuffer object instead
+	GLFWwindow* window = NULL;
+	HeadlessContext* headlessContext = NULL;
+	if (headless)
 	{
-		std::cout << "Failed to create GLFW window" << std::endl;
-		glfwTerminate();
-		return -1;
+		headlessContext = new HeadlessContext();
+		if (!headlessContext->Valid() || !headlessContext->LoadGL())
+		{
+			std::cout << "Failed to create a headless OpenGL context" << std::endl;
+			return -1;
+		}
+		std::cout << "Headless context: " << headlessContext->API() << ", " << glGetString(GL_RENDERER) << std::endl;
 	}
+	else
+	{
+		// Initialize GLFW
+		glfwInit();
+
+		// Tell GLFW which version of OpenGL to use (3.3 in this case)
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+
+		// Use the core profile, which gives access only to modern OpenGL functions
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	// Make the window the current OpenGL context
-	glfwMakeContextCurrent(window);
+		// Create a GLFW window with a resolution of 800x800 pixels, unless --size asked for another
+		window = glfwCreateWindow(width, height, "OpenGL 3D Rendering", NULL, NULL);
 
-	// Load OpenGL function pointers using GLAD
-	gladLoadGL();
+		// Check if the window failed to create
+		if (window == NULL)
+		{
+			std::cout << "Failed to create GLFW window" << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+
+		// Make the window the current OpenGL context
+		glfwMakeContextCurrent(window);
+
+		// Load OpenGL function pointers using GLAD
+		gladLoadGL();
+
+		// Don't let the monitor's refresh rate cap the measured frame times
+		if (benchmarking)
+			glfwSwapInterval(0);
+	}
 
 	// Set the OpenGL viewport (the drawable area inside the window)
 	glViewport(0, 0, width, height);
 
-	// Create a Shader object and load the vertex and fragment shaders
-	Shader shaderProgram("default.vert", "default.frag");
+	// Without a window the frames are drawn into an offscreen framebuffer, and copied
+	// from it to image files in the background while the next frames are drawn
+	Framebuffer* offscreen = NULL;
+	FrameReader* frameReader = NULL;
+	if (headless)
+	{
+		offscreen = new Framebuffer(width, height);
+		offscreen->Bind();
+	}
+	// Benchmarks don't save their frames, since the readback would skew the measurements
+	if (headless && !benchmarking)
+	{
+		frameReader = new FrameReader(width, height);
+		fs::create_directories(outDir);
+	}
+
+	// Linked shader programs are cached on disk so later launches skip compiling them
+	ProgramCache programCache;
+
+	// Load the vertex and fragment shaders, every combination of features
+	// the scene and its materials need is compiled from them on demand
+	ShaderVariants shaderVariants("default.vert", "default.frag", &programCache, "lighting.glsl");
+
+	// The light types the scene is lit by, each one becomes a #define in the shaders.
+	// SHADER_PBR shades every material as glTF metallic roughness, M turns it on and off.
+	unsigned int sceneFeatures = SHADER_DIRECTIONAL_LIGHT | SHADER_CLUSTERED_LIGHTS | SHADER_SHADOWS;
+	if (pbr)
+		sceneFeatures |= SHADER_PBR;
+	bool mPressed = false;
+
+	// Generates tangents while loading, then samples the animations and updates the
+	// transforms and skins, on every core
+	JobSystem jobSystem;
+
+	// The light reaching the PBR materials from far away. Its prefiltered maps and lookup
+	// table are generated on the job system the first time, then read from the asset cache.
+	Environment environment(environmentFile, &jobSystem);
+
+	// Shadows of the directional light, 4 cascades of 2048 by 2048 texels.
+	// Fewer cascades or a lower resolution trade shadow detail for speed.
+	ShadowCascades shadowCascades(4, 2048, &programCache);
+
+	// Local lights are sorted into clusters of the view frustum every frame, so each
+	// fragment only shades the few lights that reach it
+	LightClusters lightClusters;
+	// Fill the scene with a grid of colored point lights, with every fourth one a spot light
+	for (int z = 0; z < 16; z++)
+	{
+		for (int x = 0; x < 16; x++)
+		{
+			Light light;
+			light.type = (x + z) % 4 == 0 ? LIGHT_SPOT : LIGHT_POINT;
+			light.position = glm::vec3((x - 7.5f) * 0.5f, 0.5f, (z - 7.5f) * 0.5f);
+			light.radius = 1.0f;
+			light.color = glm::vec3(0.5f + 0.5f * std::sin(x * 0.8f), 0.5f + 0.5f * std::sin(z * 0.8f + 2.0f), 0.5f + 0.5f * std::sin((x + z) * 0.4f + 4.0f));
+			lightClusters.lights.push_back(light);
+		}
+	}
 
 	// Define properties for the light source
 	glm::vec4 lightColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
@@ -48,10 +230,31 @@ int main()
 	glm::mat4 lightModel = glm::mat4(1.0f);
 	lightModel = glm::translate(lightModel, lightPos);
 
-	// Activate the shader and send the light data to it
-	shaderProgram.Activate();
-	glUniform4f(glGetUniformLocation(shaderProgram.ID, "lightColor"), lightColor.x, lightColor.y, lightColor.z, lightColor.w);
-	glUniform3f(glGetUniformLocation(shaderProgram.ID, "lightPos"), lightPos.x, lightPos.y, lightPos.z);
+	// Send the light data to every shader variant as soon as it is built
+	shaderVariants.onCreate = [&](Shader& shader)
+	{
+		shader.Activate();
+		glUniform4f(shader.Uniform("lightColor"), lightColor.x, lightColor.y, lightColor.z, lightColor.w);
+		glUniform3f(shader.Uniform("lightPos"), lightPos.x, lightPos.y, lightPos.z);
+		lightClusters.Bind(shader);
+		shadowCascades.Bind(shader);
+		environment.Bind(shader);
+	};
+
+	// Draws the scene with forward or deferred shading, Tab switches between the two.
+	// The deferred lighting pass gets the same light uniforms as the forward shaders.
+	Renderer renderer(width, height, shaderVariants, &programCache);
+	renderer.lightingVariants.onCreate = shaderVariants.onCreate;
+	bool tabPressed = false;
+
+	// Z turns the depth pre-pass on and off, the overdraw it saves is printed every few seconds.
+	// Counting overdraw takes extra passes, so benchmarks leave it off.
+	renderer.mode = deferred ? RENDER_DEFERRED : RENDER_FORWARD;
+	renderer.depthPrepass = prepass;
+	renderer.countOverdraw = !benchmarking;
+	bool zPressed = false;
+	// Only windowed runs report, scripted runs may not have initialized GLFW at all
+	double lastOverdrawReport = scripted ? 0.0 : glfwGetTime();
 
 	// Enable the depth buffer so OpenGL can handle which objects are in front or behind
 	glEnable(GL_DEPTH_TEST);
@@ -59,6 +262,11 @@ int main()
 	// Create a camera at position (0, 0, 2)
 	Camera camera(width, height, glm::vec3(0.0f, 0.0f, 2.0f));
 
+	// Collect the window's keyboard and mouse input as it arrives, the camera takes it once per frame.
+	// The camera moves by how long each frame took, so its speed doesn't depend on the frame rate.
+	InputSampler* inputSampler = window != NULL ? new InputSampler(window) : NULL;
+	double lastFrameTime = scripted ? 0.0 : glfwGetTime();
+
 	/*
 	* This relative path setup keeps all resources in one centralized folder.
 	* It prevents duplicating assets between tutorial folders.
@@ -67,26 +275,235 @@ int main()
 	std::string parentDir = (fs::current_path().fs::path::parent_path()).string();
 	std::string modelPath = "/Resources/OpenGL3DRenderer/models/scroll/scene.gltf";
 
-	// Load the 3D model
-	Model model((parentDir + modelPath).c_str());
+	// Stream textures in the background so the model shows up before every image is decoded
+	TextureStreamer textureStreamer;
+
+	// Data that changes every frame, such as skin palettes, is written into a ring of
+	// 4 MB per frame in flight instead of over buffers the GPU may still be reading
+	StreamBuffer streamBuffer(4 * 1024 * 1024);
+
+	// Load the 3D model. It is deleted before the context, so its objects are deleted too.
+	Model* loadedModel = new Model(modelFile.empty() ? (parentDir + modelPath).c_str() : modelFile.c_str(), &textureStreamer, &jobSystem);
+	Model& model = *loadedModel;
+	model.cpuSkinning = cpuSkinning;
+	model.cpuMorphing = cpuMorphing;
+	model.stream = &streamBuffer;
+
+	// The regions of a scene are read on worker threads as the camera nears them, and drawn
+	// along with the model once they are uploaded
+	SceneStreamer sceneStreamer(&textureStreamer, &jobSystem);
+	sceneStreamer.stream = &streamBuffer;
+	if (!sceneFile.empty() && !sceneStreamer.Load(sceneFile.c_str()))
+		std::cout << "Failed to load the scene " << sceneFile << std::endl;
+	std::vector<Model*> drawnModels;
+
+	// Scripted frames are rendered from poses, by default a circle around the model
+	CameraPath cameraPath;
+	if (scripted && (posesFile.empty() || !cameraPath.Load(posesFile.c_str())))
+	{
+		if (!posesFile.empty())
+			std::cout << "Failed to load camera poses from " << posesFile << ", orbiting instead" << std::endl;
+		cameraPath.Orbit(glm::vec3(0.0f), 2.0f, 0.5f, frames);
+	}
+	else if (scripted && spline)
+		cameraPath.Spline(frames);
+	unsigned int frame = 0;
+
+	// Measures the frames of a benchmark run
+	Benchmark benchmark;
+
+	// Times the passes of each frame on the CPU and GPU. P turns it on and off, and while it
+	// is on the timing tree is printed every few seconds. --trace keeps it on from the start.
+	Profiler profiler;
+	profiler.detailed = profileMeshes;
+	profiler.tracing = !traceFile.empty();
+	if (profiler.tracing)
+		Profiler::active = &profiler;
+	bool pPressed = false;
+
+	// Rebuild the shaders whenever their source files are saved
+	ShaderWatcher shaderWatcher;
+	shaderWatcher.Watch("default.vert");
+	shaderWatcher.Watch("default.frag");
+	shaderWatcher.Watch("lighting.glsl");
+	shaderWatcher.Watch("gbuffer.frag");
+	shaderWatcher.Watch("deferred.vert");
+	shaderWatcher.Watch("deferred.frag");
+	shaderWatcher.Watch("depth.vert");
+	shaderWatcher.Watch("depth.frag");
+
+	// Used to report the shader cache once the first frame has built every variant
+	bool firstFrame = true;
 
 	// Main render loop  runs every frame until the window is closed
-	while (!glfwWindowShouldClose(window))
+	// Scripted runs stop after a fixed number of frames
+	while ((headless || !glfwWindowShouldClose(window)) && (!scripted || frame < frames))
 	{
+		if (benchmarking)
+			benchmark.BeginFrame();
+		if (Profiler::active != NULL)
+			profiler.BeginFrame();
+
 		// Set the background color
 		glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
 
 		// Clear the color and depth buffers to prepare for a new frame
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// Handle user input for the camera (keyboard and mouse)
-		camera.Inputs(window);
+		// Whether this frame is drawn with every texture the last one asked for
+		bool texturesSettled = textureStreamer.Idle();
+
+		// Handle user input for the camera (keyboard and mouse), or follow the script
+		if (scripted)
+			cameraPath.Apply(camera, frame);
+		else
+		{
+			// Long stalls, such as dragging the window, shouldn't throw the camera across the scene
+			double now = glfwGetTime();
+			float dt = (float)std::min(now - lastFrameTime, 0.1);
+			lastFrameTime = now;
+			camera.update(dt, inputSampler->Sample());
+		}
+
+		// Remember where the camera went, to save the path when the window closes
+		if (!recordFile.empty() && !scripted)
+			cameraPath.Record(camera);
 
 		// Update the cameras matrix and send it to the shader
 		camera.updateMatrix(45.0f, 0.1f, 1000.0f);
 
-		// Draw the loaded model
-		model.Draw(shaderProgram, camera);
+		// Pose the model. Scripted frames advance the animation by a fixed 1/60 of a second,
+		// so every run renders the same poses.
+		model.Animate(animation, scripted ? frame / 60.0f : (float)glfwGetTime());
+
+		// Load and unload the scene's regions around the camera, then gather everything to draw
+		{
+			ProfileScope profile("Scene streaming");
+			sceneStreamer.Update(camera.Position);
+		}
+		drawnModels.clear();
+		drawnModels.push_back(&model);
+		sceneStreamer.Models(drawnModels);
+
+		// Sort the lights into the clusters of this frame's view
+		{
+			ProfileScope profile("Light clusters");
+			lightClusters.Update(camera);
+		}
+
+		// Draw the model's shadows from the directional light
+		{
+			ProfileScope profile("Shadows");
+			shadowCascades.Render(drawnModels, camera, sceneFeatures);
+		}
+
+		// Switch between forward and deferred shading when Tab is pressed
+		bool tabDown = !scripted && glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS;
+		if (tabDown && !tabPressed)
+		{
+			renderer.mode = renderer.mode == RENDER_FORWARD ? RENDER_DEFERRED : RENDER_FORWARD;
+			std::cout << "Rendering: " << renderer.ModeName() << std::endl;
+		}
+		tabPressed = tabDown;
+
+		// Toggle the depth pre-pass when Z is pressed
+		bool zDown = !scripted && glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+		if (zDown && !zPressed)
+		{
+			renderer.depthPrepass = !renderer.depthPrepass;
+			std::cout << "Depth pre-pass: " << (renderer.depthPrepass ? "on" : "off") << std::endl;
+		}
+		zPressed = zDown;
+
+		// Turn the profiler on and off when P is pressed
+		bool pDown = !scripted && glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+		if (pDown && !pPressed)
+		{
+			Profiler::active = Profiler::active == NULL ? &profiler : NULL;
+			std::cout << "Profiler: " << (Profiler::active != NULL ? "on" : "off") << std::endl;
+		}
+		pPressed = pDown;
+
+		// Switch between the PBR and Blinn-Phong materials when M is pressed
+		bool mDown = !scripted && glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+		if (mDown && !mPressed)
+		{
+			sceneFeatures ^= SHADER_PBR;
+			std::cout << "Materials: " << (sceneFeatures & SHADER_PBR ? "PBR" : "Blinn-Phong") << std::endl;
+		}
+		mPressed = mDown;
+
+		// Draw the loaded model and regions
+		{
+			ProfileScope profile("Scene");
+			renderer.Draw(drawnModels, camera, sceneFeatures);
+		}
+
+		// Report how often each covered pixel was shaded, and where the frame's time went
+		if (!scripted && glfwGetTime() - lastOverdrawReport > 2.0)
+		{
+			std::cout << renderer.OverdrawLine() << std::endl;
+			std::cout << GPUResources::LedgerLine() << std::endl;
+			if (!sceneFile.empty())
+				std::cout << sceneStreamer.StatsLine() << std::endl;
+			if (Profiler::active != NULL)
+				std::cout << profiler.TreeText();
+			lastOverdrawReport = glfwGetTime();
+		}
+
+		// All variants the model needs exist after its first draw
+		if (firstFrame)
+		{
+			std::cout << programCache.StatsLine() << std::endl;
+			firstFrame = false;
+		}
+
+		// Start reloading the shaders if they were edited, and do one step of any pending reload
+		if (shaderWatcher.Poll())
+		{
+			shaderVariants.Reload();
+			renderer.Reload();
+			shadowCascades.Reload();
+		}
+		shaderVariants.Update();
+		renderer.Update();
+		shadowCascades.Update();
+
+		// Upload the texture levels the model asked for while drawing
+		{
+			ProfileScope profile("Texture streaming");
+			textureStreamer.Update();
+		}
+		if (Profiler::active != NULL)
+			profiler.EndFrame();
+
+		// Everything this frame streamed has been drawn with, the ring moves on
+		streamBuffer.EndFrame();
+		// Objects released this frame are deleted once the GPU is done with it
+		GPUResources::EndFrame();
+
+		// A scripted pose is drawn again until every texture and region it needs is loaded, so saved
+		// and measured frames are the same no matter how fast they loaded
+		bool frameDone = scripted && texturesSettled && textureStreamer.Idle() && sceneStreamer.Idle();
+		if (benchmarking)
+			benchmark.EndFrame(frameDone);
+
+		if (frameReader != NULL)
+		{
+			// Queue the frame to be saved
+			if (frameDone)
+			{
+				char file[32];
+				std::snprintf(file, sizeof(file), "/frame_%04u.tga", frame);
+				frameReader->Capture(outDir + file);
+			}
+			// Save the earlier frames the GPU has finished
+			frameReader->Poll();
+		}
+		if (frameDone)
+			frame++;
+		if (headless)
+			continue;
 
 		// Swap the back buffer (the drawn frame) with the front buffer (the displayed frame)
 		glfwSwapBuffers(window);
@@ -95,10 +512,75 @@ int main()
 		glfwPollEvents();
 	}
 
+	if (benchmarking)
+	{
+		json info;
+		info["scene"] = modelFile.empty() ? modelPath : modelFile;
+		info["poses"] = posesFile.empty() ? "orbit" : posesFile;
+		info["width"] = width;
+		info["height"] = height;
+		info["mode"] = renderer.ModeName();
+		info["depthPrepass"] = renderer.depthPrepass;
+		info["pbr"] = (sceneFeatures & SHADER_PBR) != 0;
+		info["renderer"] = (const char*)glGetString(GL_RENDERER);
+		if (benchmark.Write(benchmarkFile.c_str(), info))
+			std::cout << "Wrote " << benchmark.Frames() << " frames of benchmark results to " << benchmarkFile << std::endl;
+		else
+			std::cout << "Failed to write benchmark results to " << benchmarkFile << std::endl;
+		benchmark.Delete();
+	}
+	if (profiler.tracing)
+	{
+		if (profiler.WriteTrace(traceFile.c_str()))
+			std::cout << "Wrote the profile trace to " << traceFile << std::endl;
+		else
+			std::cout << "Failed to write the profile trace to " << traceFile << std::endl;
+	}
+	profiler.Delete();
+	if (!recordFile.empty() && !scripted)
+	{
+		if (cameraPath.Save(recordFile.c_str()))
+			std::cout << "Recorded " << cameraPath.poses.size() << " camera poses to " << recordFile << std::endl;
+		else
+			std::cout << "Failed to save camera poses to " << recordFile << std::endl;
+	}
+
+	if (frameReader != NULL)
+	{
+		frameReader->Flush();
+		std::cout << "Saved " << frameReader->written << " frames to " << outDir << std::endl;
+		frameReader->Delete();
+		delete frameReader;
+	}
+	if (inputSampler != NULL)
+		delete inputSampler;
+	if (offscreen != NULL)
+	{
+		offscreen->Delete();
+		delete offscreen;
+	}
+
 	// Clean up resources before closing the program
-	shaderProgram.Delete();
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	delete loadedModel;
+	sceneStreamer.Delete();
+	shaderVariants.Delete();
+	renderer.Delete();
+	textureStreamer.Delete();
+	streamBuffer.Delete();
+	lightClusters.Delete();
+	shadowCascades.Delete();
+	environment.Delete();
+	GPUResources::Flush();
+	if (headless)
+	{
+		headlessContext->Delete();
+		delete headlessContext;
+	}
+	else
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include"MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include<windows.h>
+#else
+#include<sys/mman.h>
+#include<sys/stat.h>
+#include<fcntl.h>
+#include<unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+{
+	take(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+	if (this != &other)
+	{
+		Close();
+		take(other);
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const char* file)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize))
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+	MappedFile::fileHandle = fileHandle;
+
+	// Empty files can't be mapped, they are open with no bytes
+	if (fileSize.QuadPart == 0)
+		return true;
+	mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mappingHandle != NULL)
+		bytes = (const unsigned char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (bytes == NULL)
+	{
+		Close();
+		return false;
+	}
+	size = (size_t)fileSize.QuadPart;
+#else
+	int fd = open(file, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+	struct stat status;
+	if (fstat(fd, &status) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	// The mapping keeps the file open on its own, so the descriptor isn't needed after this
+	if (status.st_size > 0)
+	{
+		void* mapped = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped == MAP_FAILED)
+		{
+			close(fd);
+			return false;
+		}
+		bytes = (const unsigned char*)mapped;
+		size = (size_t)status.st_size;
+	}
+	close(fd);
+#endif
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (bytes != NULL)
+		UnmapViewOfFile(bytes);
+	if (mappingHandle != NULL)
+		CloseHandle(mappingHandle);
+	if (fileHandle != NULL)
+		CloseHandle(fileHandle);
+	fileHandle = NULL;
+	mappingHandle = NULL;
+#else
+	if (bytes != NULL)
+		munmap((void*)bytes, size);
+#endif
+	bytes = NULL;
+	size = 0;
+}
+
+void MappedFile::take(MappedFile& other)
+{
+	bytes = other.bytes;
+	size = other.size;
+	other.bytes = NULL;
+	other.size = 0;
+#ifdef _WIN32
+	fileHandle = other.fileHandle;
+	mappingHandle = other.mappingHandle;
+	other.fileHandle = NULL;
+	other.mappingHandle = NULL;
+#endif
+}
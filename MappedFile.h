@@ -0,0 +1,44 @@
+// If MAPPED_FILE_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef MAPPED_FILE_CLASS_H
+#define MAPPED_FILE_CLASS_H
+
+#include<cstddef>
+
+
+// A MappedFile maps a whole file into memory read-only, so its contents can be used in
+// place instead of being copied into a buffer first. Pages are only read from disk as
+// they are touched, and the mapping goes away with the object.
+// Mapped files can be moved but not copied, moving keeps bytes where it was.
+class MappedFile
+{
+public:
+	// The contents of the file, NULL while nothing is mapped or if the file is empty
+	const unsigned char* bytes = NULL;
+	size_t size = 0;
+
+	MappedFile();
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(MappedFile&& other);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile();
+
+	// Maps file, unmapping whatever was mapped before. Returns false if it can't be opened.
+	bool Open(const char* file);
+
+	// Unmaps the file.
+	void Close();
+
+private:
+#ifdef _WIN32
+	// The file and its mapping object, HANDLEs kept as void* to leave windows.h out of the header
+	void* fileHandle = NULL;
+	void* mappingHandle = NULL;
+#endif
+
+	// Takes over other's mapping, leaving it empty.
+	void take(MappedFile& other);
+};
+
+#endif
@@ -0,0 +1,82 @@
+// If MATERIAL_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the struct during compilation.
+#ifndef MATERIAL_CLASS_H
+#define MATERIAL_CLASS_H
+
+#include<glad/glad.h> // OpenGL functions.
+
+
+// The most materials a single model can hold.
+// Must match the size of the Materials uniform block in default.frag.
+const unsigned int MAX_MATERIALS = 256;
+
+// The uniform buffer binding point the material table is bound to.
+const GLuint MATERIAL_UBO_BINDING = 0;
+
+// Texture unit the normal map array is bound to, the diffuse and specular arrays use 0 and 1.
+const GLuint NORMAL_MAP_UNIT = 12;
+
+// Texture units of the occlusion and emissive arrays, only sampled by SHADER_PBR variants.
+const GLuint OCCLUSION_UNIT = 13;
+const GLuint EMISSIVE_UNIT = 14;
+
+// The uniform buffer binding point the PBR factors of the material table are bound to.
+const GLuint PBR_MATERIAL_UBO_BINDING = 4;
+
+
+// A Material tells a mesh which texture arrays to sample and which row
+// of the model's material table holds its layer indices.
+// Meshes with different materials that share texture arrays can be drawn
+// back to back without binding any textures in between.
+struct Material
+{
+	// Row of this material in the material uniform buffer.
+	GLuint index;
+	// Texture array holding the diffuse (base color) layer.
+	GLuint diffuseArray;
+	// Texture array holding the specular (metallic roughness) layer.
+	GLuint specularArray;
+	// Texture array holding the tangent space normal map layer, if the material has one.
+	GLuint normalArray;
+	// Texture arrays holding the occlusion and emissive layers, if the material has them.
+	GLuint occlusionArray;
+	GLuint emissiveArray;
+	// ShaderFeature bits this material needs, such as SHADER_ALPHA_TEST.
+	unsigned int features;
+};
+
+// One row of the material uniform buffer, laid out like the std140
+// MaterialData struct in default.frag (32 bytes per row).
+struct MaterialData
+{
+	GLint diffuseLayer;
+	GLint specularLayer;
+	// Fragments with a lower diffuse alpha are discarded when ALPHA_TEST is defined.
+	GLfloat alphaCutoff;
+	GLint normalLayer;
+	// Scales the x and y of the normal map, glTF's normalTexture.scale
+	GLfloat normalScale;
+	GLfloat padding[3];
+};
+
+// The rest of a glTF metallic roughness material, one row per material in a second
+// uniform buffer laid out like PBRMaterialData in default.frag (48 bytes per row).
+// It is kept apart from MaterialData so the Materials block stays within the 16KB
+// every driver allows, and variants without SHADER_PBR don't declare it at all.
+struct PBRMaterialData
+{
+	// Multiplies the base color texture, in linear color
+	GLfloat baseColorFactor[4];
+	// Multiplies the emissive texture, times KHR_materials_emissive_strength if it is there
+	GLfloat emissiveFactor[3];
+	GLfloat metallicFactor;
+	GLfloat roughnessFactor;
+	// How much the occlusion texture darkens the light from the environment
+	GLfloat occlusionStrength;
+	// Layers of the occlusion and emissive textures, -1 when the material has none,
+	// which skips the lookup
+	GLint occlusionLayer;
+	GLint emissiveLayer;
+};
+
+#endif
@@ -1,15 +1,68 @@
 // Header is included.
 #include "Mesh.h"
+#include"RenderStats.h"
+#include"Profiler.h"
+#include"Skin.h"
 
+#include<algorithm>
 
-// Constructor that initializes the meshs vertex, index, and texture data.
+
+// Writes data over part of a vertex buffer, through the stream buffer if there is one.
+static void update_buffer(StreamBuffer* stream, GLuint buffer, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	if (stream != NULL)
+	{
+		stream->Upload(buffer, offset, data, size);
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Constructor that initializes the meshs vertex, index, and material data.
 // It also sets up and links the necessary buffers (VBO, EBO, VAO) for rendering.
-Mesh::Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>& textures)
+Mesh::Mesh
+(
+	std::vector <Vertex>&& vertices,
+	std::vector <GLuint>&& indices,
+	const Material& material,
+	std::vector <SkinVertex>&& skin,
+	std::vector <MorphTarget>&& targets,
+	MeshGeometry geometry
+)
 {
-	// Store the provided data in the class members.
-	Mesh::vertices = vertices;
-	Mesh::indices = indices;
-	Mesh::textures = textures;
+	// Store the provided data in the class members. The vertices and indices are
+	// uploaded from the caller's vectors and only moved in at the end, if they are kept.
+	Mesh::material = material;
+	Mesh::skin = std::move(skin);
+	indexCount = (GLsizei)indices.size();
+
+	// Find the box around all vertices.
+	boundsMin = vertices.empty() ? glm::vec3(0.0f) : vertices[0].position;
+	boundsMax = boundsMin;
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+
+	// Morph targets can push vertices past it. Weights usually stay between 0 and 1,
+	// so the box grows by the furthest each target moves any vertex in either direction.
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		glm::vec3 lowest(0.0f);
+		glm::vec3 highest(0.0f);
+		for (unsigned int k = 0; k < targets[t].positions.size(); k++)
+		{
+			lowest = glm::min(lowest, glm::vec3(targets[t].positions[k]));
+			highest = glm::max(highest, glm::vec3(targets[t].positions[k]));
+		}
+		boundsMin += lowest;
+		boundsMax += highest;
+	}
+	bool morphed = !targets.empty();
+	morphs = MorphTargets(std::move(targets), (unsigned int)vertices.size());
 
 	// Bind the VAO before linking buffers and attributes.
 	VAO.Bind();
@@ -26,16 +79,62 @@ Mesh::Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::v
 	VAO.LinkAttrib(VBO, 1, 3, GL_FLOAT, sizeof(Vertex), (void*)(3 * sizeof(float))); // Normal
 	VAO.LinkAttrib(VBO, 2, 3, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float))); // Color
 	VAO.LinkAttrib(VBO, 3, 2, GL_FLOAT, sizeof(Vertex), (void*)(9 * sizeof(float))); // Texture coordinates
+	VAO.LinkAttrib(VBO, 6, 4, GL_FLOAT, sizeof(Vertex), (void*)(11 * sizeof(float))); // Tangent, read by NORMAL_MAP variants
 
 	// Unbind all to prevent accidental modifications.
 	VAO.Unbind();
 	VBO.Unbind();
 	EBO.Unbind();
+
+	// Set up the position only VAO. It shares the index buffer with the main VAO.
+	std::vector<glm::vec3> positions(vertices.size());
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		positions[i] = vertices[i].position;
+	depthVAO.Bind();
+	class VBO positionVBO(positions);
+	EBO.Bind();
+	depthVAO.LinkAttrib(positionVBO, 0, 3, GL_FLOAT, sizeof(glm::vec3), (void*)0); // Position
+	depthVAO.Unbind();
+	positionVBO.Unbind();
+	EBO.Unbind();
+
+	// Skinned meshes keep their joints and weights in a buffer of their own, read by both VAOs.
+	if (!Mesh::skin.empty())
+	{
+		class VBO skinVBO(Mesh::skin);
+		VAO.Bind();
+		VAO.LinkAttrib(skinVBO, 4, 4, GL_FLOAT, sizeof(SkinVertex), (void*)0);					 // Joints
+		VAO.LinkAttrib(skinVBO, 5, 4, GL_FLOAT, sizeof(SkinVertex), (void*)(4 * sizeof(float))); // Weights
+		depthVAO.Bind();
+		depthVAO.LinkAttrib(skinVBO, 4, 4, GL_FLOAT, sizeof(SkinVertex), (void*)0);
+		depthVAO.LinkAttrib(skinVBO, 5, 4, GL_FLOAT, sizeof(SkinVertex), (void*)(4 * sizeof(float)));
+		depthVAO.Unbind();
+		skinVBO.Unbind();
+		skinBuffer = GPUHandle(GPU_BUFFER, skinVBO.ID, VRAM_VERTICES, Mesh::skin.size() * sizeof(SkinVertex));
+	}
+
+	// The mesh owns everything it made from here on
+	vertexBuffer = GPUHandle(GPU_BUFFER, VBO.ID, VRAM_VERTICES, vertices.size() * sizeof(Vertex));
+	positionBuffer = GPUHandle(GPU_BUFFER, positionVBO.ID, VRAM_VERTICES, positions.size() * sizeof(glm::vec3));
+	indexBuffer = GPUHandle(GPU_BUFFER, EBO.ID, VRAM_INDICES, indices.size() * sizeof(GLuint));
+	vertexArray = GPUHandle(GPU_VERTEX_ARRAY, VAO.ID, VRAM_VERTICES);
+	depthArray = GPUHandle(GPU_VERTEX_ARRAY, depthVAO.ID, VRAM_VERTICES);
+
+	// Skinning and morphing on the CPU start from the loaded vertices, and either can be
+	// switched on at any time
+	if (!Mesh::skin.empty() || morphed)
+		geometry = MESH_GEOMETRY_FULL;
+	if (geometry == MESH_GEOMETRY_FULL)
+		Mesh::vertices = std::move(vertices);
+	else if (geometry == MESH_GEOMETRY_COMPACT)
+		Mesh::positions = std::move(positions);
+	if (geometry != MESH_GEOMETRY_RELEASE)
+		Mesh::indices = std::move(indices);
 }
 
 
 // Draw function renders the mesh using the provided shader and camera.
-// It also handles texture binding and applies transformations such as translation, rotation, and scaling.
+// It also handles material binding and applies transformations such as translation, rotation, and scaling.
 void Mesh::Draw
 (
 	Shader& shader,
@@ -46,40 +145,33 @@ void Mesh::Draw
 	glm::vec3 scale
 )
 {
+	// Time each mesh separately when the profiler asks for that much detail.
+	ProfileScope profile("Mesh::Draw", true);
+
 	// Activate the shader program so we can set uniforms and draw with it.
 	shader.Activate();
 	// Bind the VAO associated with this mesh.
 	VAO.Bind();
 
 
-	// Counters to keep track of how many textures of each type are used.
-	unsigned int numDiffuse = 0;
-	unsigned int numSpecular = 0;
-
-	// Loop through all textures in this mesh and bind them to the correct texture units.
-	for (unsigned int i = 0; i < textures.size(); i++)
-	{
-		std::string num;
-		std::string type = textures[i].type;
-
-		// Assign unique numbers to each diffuse/specular texture (e.g., diffuse0, diffuse1).
-		if (type == "diffuse")
-		{
-			num = std::to_string(numDiffuse++);
-		}
-		else if (type == "specular")
-		{
-			num = std::to_string(numSpecular++);
-		}
+	// Bind the texture arrays that hold this mesh's material.
+	// The diffuse array always goes to unit 0 and the specular array to unit 1,
+	// so if the previous mesh used the same arrays no texture calls are made at all.
+	TextureArray::BindID(material.diffuseArray, 0);
+	TextureArray::BindID(material.specularArray, 1);
+	if (material.features & SHADER_NORMAL_MAP)
+		TextureArray::BindID(material.normalArray, NORMAL_MAP_UNIT);
+	// Only PBR variants sample these, but they are almost always the white array or the
+	// specular array's, so the bind filter skips them between most meshes
+	TextureArray::BindID(material.occlusionArray, OCCLUSION_UNIT);
+	TextureArray::BindID(material.emissiveArray, EMISSIVE_UNIT);
 
-		// Connect the texture to the correct uniform in the shader and bind it to the GPU.
-		textures[i].texUnit(shader, (type + num).c_str(), i);
-		textures[i].Bind();
-	}
+	// Tell the shader which row of the material table to read the layer indices from.
+	glUniform1i(shader.Uniform("materialIndex"), material.index);
 
 
 	// Pass the cameras position to the shader (used for lighting calculations).
-	glUniform3f(glGetUniformLocation(shader.ID, "camPos"), camera.Position.x, camera.Position.y, camera.Position.z);
+	glUniform3f(shader.Uniform("camPos"), camera.Position.x, camera.Position.y, camera.Position.z);
 
 	// Pass the camera matrix (view + projection) to the shader.
 	camera.Matrix(shader, "camMatrix");
@@ -96,13 +188,118 @@ void Mesh::Draw
 	sca = glm::scale(sca, scale);
 
 
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "translation"), 1, GL_FALSE, glm::value_ptr(trans));
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "rotation"), 1, GL_FALSE, glm::value_ptr(rot));
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "scale"), 1, GL_FALSE, glm::value_ptr(sca));
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, "model"), 1, GL_FALSE, glm::value_ptr(matrix));
+	glUniformMatrix4fv(shader.Uniform("translation"), 1, GL_FALSE, glm::value_ptr(trans));
+	glUniformMatrix4fv(shader.Uniform("rotation"), 1, GL_FALSE, glm::value_ptr(rot));
+	glUniformMatrix4fv(shader.Uniform("scale"), 1, GL_FALSE, glm::value_ptr(sca));
+	glUniformMatrix4fv(shader.Uniform("model"), 1, GL_FALSE, glm::value_ptr(matrix));
 
 
 	// Draw the mesh using the currently bound VAO, shader, and textures.
-	// GL_TRIANGLES specifies the rendering mode, and indices.size() defines how many indices to draw.
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	// GL_TRIANGLES specifies the rendering mode, and indexCount defines how many indices to draw.
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	RenderStats::drawCalls++;
+	RenderStats::triangles += indexCount / 3;
+}
+
+
+// Draws the mesh's positions only, for depth only passes.
+// The transformation is sent the same way Draw does, so both place the mesh in the same spot.
+void Mesh::DrawDepth
+(
+	Shader& shader,
+	glm::mat4 matrix,
+	glm::vec3 translation,
+	glm::quat rotation,
+	glm::vec3 scale
+)
+{
+	ProfileScope profile("Mesh::DrawDepth", true);
+	if (material.features & SHADER_ALPHA_TEST)
+	{
+		// The cutout needs the texture coordinates, which only the full vertex buffer has
+		VAO.Bind();
+		TextureArray::BindID(material.diffuseArray, 0);
+		glUniform1i(shader.Uniform("materialIndex"), material.index);
+	}
+	else
+		depthVAO.Bind();
+
+	glm::mat4 trans = glm::translate(glm::mat4(1.0f), translation);
+	glm::mat4 rot = glm::mat4_cast(rotation);
+	glm::mat4 sca = glm::scale(glm::mat4(1.0f), scale);
+	glUniformMatrix4fv(shader.Uniform("translation"), 1, GL_FALSE, glm::value_ptr(trans));
+	glUniformMatrix4fv(shader.Uniform("rotation"), 1, GL_FALSE, glm::value_ptr(rot));
+	glUniformMatrix4fv(shader.Uniform("scale"), 1, GL_FALSE, glm::value_ptr(sca));
+	glUniformMatrix4fv(shader.Uniform("model"), 1, GL_FALSE, glm::value_ptr(matrix));
+
+	glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+	RenderStats::drawCalls++;
+	RenderStats::triangles += indexCount / 3;
+}
+
+
+// Skins the vertices on the CPU, keeping the result for UploadSkin.
+void Mesh::SkinCPU(const std::vector<glm::mat4>& palette)
+{
+	if (!skin.empty())
+		skin_vertices(palette, pose(), skin, skinnedVertices, skinnedPositions);
+}
+
+// Overwrites both vertex buffers with the vertices of the last SkinCPU.
+void Mesh::UploadSkin(StreamBuffer* stream)
+{
+	if (skinnedVertices.empty())
+		return;
+	update_buffer(stream, vertexBuffer.ID, 0, skinnedVertices.size() * sizeof(Vertex), skinnedVertices.data());
+	update_buffer(stream, positionBuffer.ID, 0, skinnedPositions.size() * sizeof(glm::vec3), skinnedPositions.data());
+}
+
+// Uploads the vertices as they were loaded, or as the CPU morphed them.
+void Mesh::RestoreBindPose(StreamBuffer* stream)
+{
+	const std::vector<Vertex>& vertices = pose();
+	std::vector<glm::vec3> positions(vertices.size());
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		positions[i] = vertices[i].position;
+
+	update_buffer(stream, vertexBuffer.ID, 0, vertices.size() * sizeof(Vertex), vertices.data());
+	update_buffer(stream, positionBuffer.ID, 0, positions.size() * sizeof(glm::vec3), positions.data());
+}
+
+// Blends the morph targets into morphedVertices, starting from a copy of the loaded vertices.
+void Mesh::MorphCPU(const std::vector<float>& weights)
+{
+	if (morphs.targets.empty())
+		return;
+	if (morphedVertices.empty())
+	{
+		morphedVertices = vertices;
+		morphs.Reset();
+	}
+	morphs.Apply(weights, vertices, morphedVertices, morphedFirst, morphedEnd);
+}
+
+// Overwrites the part of both vertex buffers the last MorphCPU changed.
+void Mesh::UploadMorph(StreamBuffer* stream)
+{
+	if (morphedFirst >= morphedEnd)
+		return;
+	std::vector<glm::vec3> positions(morphedEnd - morphedFirst);
+	for (unsigned int i = morphedFirst; i < morphedEnd; i++)
+		positions[i - morphedFirst] = morphedVertices[i].position;
+
+	update_buffer(stream, vertexBuffer.ID, morphedFirst * sizeof(Vertex), (morphedEnd - morphedFirst) * sizeof(Vertex), &morphedVertices[morphedFirst]);
+	update_buffer(stream, positionBuffer.ID, morphedFirst * sizeof(glm::vec3), positions.size() * sizeof(glm::vec3), positions.data());
+	morphedFirst = morphedEnd = 0;
+}
+
+void Mesh::ClearMorph()
+{
+	morphedVertices.clear();
+	morphedFirst = morphedEnd = 0;
+}
+
+const std::vector<Vertex>& Mesh::pose()
+{
+	return morphedVertices.empty() ? vertices : morphedVertices;
 }
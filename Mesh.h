@@ -9,7 +9,25 @@
 #include"VAO.h"
 #include"EBO.h"
 #include"Camera.h"
-#include"Texture.h"
+#include"TextureArray.h"
+#include"Material.h"
+#include"Morph.h"
+#include"StreamBuffer.h"
+#include"GPUResources.h"
+
+
+// What a mesh keeps of its geometry on the CPU once it is uploaded. Drawing only needs
+// the GPU buffers, so by default nothing stays behind.
+enum MeshGeometry
+{
+	// Only the GPU buffers hold the geometry
+	MESH_GEOMETRY_RELEASE,
+	// The positions and indices, 12 bytes a vertex instead of a whole Vertex,
+	// for picking and culling against the triangles
+	MESH_GEOMETRY_COMPACT,
+	// Every vertex and index as loaded
+	MESH_GEOMETRY_FULL,
+};
 
 
 // The Mesh class represents a single 3D object that can be drawn.
@@ -20,22 +38,60 @@ class Mesh
 public:
 	// Stores all vertices that make up this mesh.
 	// Each Vertex holds position, normal, color, and texture coordinate data.
+	// Only kept with MESH_GEOMETRY_FULL, or if the mesh is skinned or morphed, since
+	// skinning and morphing on the CPU start from it.
 	std::vector <Vertex> vertices;
 
+	// Positions of the vertices, kept instead of them with MESH_GEOMETRY_COMPACT.
+	std::vector <glm::vec3> positions;
+
 	// Stores the order in which vertices are drawn to form triangles.
-	// The indices refer to the vertex list above.
+	// The indices refer to the vertex list above. Empty with MESH_GEOMETRY_RELEASE.
 	std::vector <GLuint> indices;
 
-	// Stores all textures used by this mesh (e.g., diffuse, specular, normal maps).
-	std::vector <Texture> textures;
+	// How many indices a draw reads, whether the indices are kept or not.
+	GLsizei indexCount = 0;
+
+	// Joints and weights of every vertex, empty if the mesh isn't skinned.
+	std::vector <SkinVertex> skin;
+
+	// Morph targets of the mesh, blended by the weights of the node that places it.
+	MorphTargets morphs;
+
+	// Stores the material of this mesh, which texture arrays it samples
+	// and which row of the model's material table holds its layers.
+	Material material;
+
+	// Corners of the box around every vertex, in the mesh's own space.
+	// Used to estimate how large the mesh appears on screen.
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
 
 	// The VAO stores attribute configurations for the vertices.
 	// It is public so the Draw() function can access and bind it directly.
 	VAO VAO;
 
-	// Constructor that initializes the mesh by linking vertices, indices, and textures.
+	// A second VAO that reads only the positions, from their own tightly packed buffer.
+	// Depth only passes such as shadow maps draw with it and fetch 12 bytes per vertex
+	// instead of the whole Vertex.
+	class VAO depthVAO;
+
+	// Constructor that initializes the mesh by linking vertices, indices, and its material.
 	// Sets up all buffers and attribute pointers needed for rendering.
-	Mesh(std::vector <Vertex>& vertices, std::vector <GLuint>& indices, std::vector <Texture>& textures);
+	// Skinned meshes also pass the joints and weights of their vertices, which both VAOs
+	// read at locations 4 and 5 for the SKINNING shader variants.
+	// Morphed meshes pass their targets, which widen the bounds by every delta.
+	// The vectors are moved into the mesh rather than copied, and whatever geometry
+	// doesn't ask to keep is freed once it is uploaded.
+	Mesh
+	(
+		std::vector <Vertex>&& vertices,
+		std::vector <GLuint>&& indices,
+		const Material& material,
+		std::vector <SkinVertex>&& skin = std::vector <SkinVertex>(),
+		std::vector <MorphTarget>&& targets = std::vector <MorphTarget>(),
+		MeshGeometry geometry = MESH_GEOMETRY_RELEASE
+	);
 
 	// Draw function that renders the mesh to the screen using a given shader and camera.
 	// It applies transformations such as translation, rotation, and scaling.
@@ -48,6 +104,64 @@ public:
 		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), // Rotate the mesh with a quaternion
 		glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f)     // Scale the mesh size
 	);
+
+	// Draws only the mesh's depth with depthVAO. The shader must already be active
+	// and its camMatrix set, only the per mesh transformation is sent here.
+	// Alpha tested meshes are drawn with the full VAO instead, with their diffuse array
+	// bound, for the ALPHA_TEST variant of the depth shader.
+	void DrawDepth
+	(
+		Shader& shader,
+		glm::mat4 matrix = glm::mat4(1.0f),
+		glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f),
+		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+		glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f)
+	);
+
+	// Skins the vertices on the CPU with a skin's palette. Doesn't touch OpenGL, so meshes
+	// can be skinned on the job system, UploadSkin then writes the result over the vertex
+	// and position buffers. The mesh is then drawn without the SKINNING variant.
+	// The uploads go through stream if there is one, so they never wait for the GPU to
+	// finish drawing the last frame's vertices.
+	void SkinCPU(const std::vector<glm::mat4>& palette);
+	void UploadSkin(StreamBuffer* stream = NULL);
+
+	// Writes the unskinned vertices back, for when the shaders take over the skinning again.
+	void RestoreBindPose(StreamBuffer* stream = NULL);
+
+	// Blends the morph targets on the CPU by weights, only the vertices moved by targets
+	// whose weight changed. Doesn't touch OpenGL, like SkinCPU, and SkinCPU starts from the
+	// morphed vertices. UploadMorph writes the changed vertices over both vertex buffers.
+	void MorphCPU(const std::vector<float>& weights);
+	void UploadMorph(StreamBuffer* stream = NULL);
+
+	// Drops the CPU morphed vertices, for when the shaders take over the morphing again.
+	// RestoreBindPose then uploads the unmorphed vertices.
+	void ClearMorph();
+
+private:
+	// The buffers SkinCPU writes into
+	GPUHandle vertexBuffer;
+	GPUHandle positionBuffer;
+
+	// The rest of the mesh's objects, all deleted with the mesh
+	GPUHandle indexBuffer;
+	GPUHandle skinBuffer;
+	GPUHandle vertexArray;
+	GPUHandle depthArray;
+
+	// Skinned vertices of the last SkinCPU, kept to avoid reallocating
+	std::vector <Vertex> skinnedVertices;
+	std::vector <glm::vec3> skinnedPositions;
+
+	// Vertices with the CPU morph applied, empty while the shaders morph the mesh,
+	// and the range of them the last MorphCPU changed
+	std::vector <Vertex> morphedVertices;
+	unsigned int morphedFirst = 0;
+	unsigned int morphedEnd = 0;
+
+	// The vertices skinning starts from, morphed or as loaded.
+	const std::vector <Vertex>& pose();
 };
 
 // Ends the header guard  if this class was already defined, skip everything above.
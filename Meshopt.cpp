@@ -0,0 +1,393 @@
+#include"Meshopt.h"
+
+#include<cmath>
+#include<cstring>
+#include<algorithm>
+
+// First byte of every encoded stream: the kind of stream in the high 4 bits, its version in the low ones
+const unsigned char MESHOPT_VERTEX_HEADER = 0xA0;
+const unsigned char MESHOPT_TRIANGLE_HEADER = 0xE0;
+const unsigned char MESHOPT_SEQUENCE_HEADER = 0xD0;
+
+// Attribute bytes are coded in groups of 16, and elements in blocks that keep the
+// bytes of one block within 8 KB
+const size_t MESHOPT_BYTE_GROUP = 16;
+const size_t MESHOPT_BLOCK_BYTES = 8192;
+const size_t MESHOPT_MAX_BLOCK_ELEMENTS = 256;
+
+// Attribute streams end with the first element, padded to at least this many bytes
+const size_t MESHOPT_TAIL_MIN = 32;
+
+
+// Returns the signed number a zigzag coded number stands for: 0, -1, 1, -2, 2, ...
+static unsigned char unzigzag8(unsigned char value)
+{
+	return (unsigned char)(-(value & 1) ^ (value >> 1));
+}
+
+static int unzigzag32(unsigned int value)
+{
+	return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+// Reads a number of up to 5 bytes, 7 bits each and lowest first, while the top bit is set.
+static bool read_vbyte(const unsigned char*& data, const unsigned char* end, unsigned int& value)
+{
+	value = 0;
+	for (unsigned int shift = 0; shift < 35; shift += 7)
+	{
+		if (data >= end)
+			return false;
+		unsigned char byte = *data++;
+		value |= (unsigned int)(byte & 0x7F) << shift;
+		if (byte < 0x80)
+			return true;
+	}
+	return false;
+}
+
+// Decodes one group of 16 bytes, stored with bits bits each, high bits first, where the
+// largest value means the byte follows the group in full.
+static const unsigned char* decode_byte_group(const unsigned char* data, const unsigned char* end, unsigned char* group, unsigned int bits)
+{
+	if (bits == 0)
+	{
+		std::memset(group, 0, MESHOPT_BYTE_GROUP);
+		return data;
+	}
+	if (bits == 8)
+	{
+		if ((size_t)(end - data) < MESHOPT_BYTE_GROUP)
+			return NULL;
+		std::memcpy(group, data, MESHOPT_BYTE_GROUP);
+		return data + MESHOPT_BYTE_GROUP;
+	}
+
+	size_t packed = MESHOPT_BYTE_GROUP * bits / 8;
+	if ((size_t)(end - data) < packed)
+		return NULL;
+	const unsigned char* extra = data + packed;
+	unsigned int sentinel = (1u << bits) - 1;
+	for (size_t i = 0; i < MESHOPT_BYTE_GROUP; i++)
+	{
+		unsigned int shift = 8 - bits - (unsigned int)(i * bits % 8);
+		unsigned int value = (data[i * bits / 8] >> shift) & sentinel;
+		if (value == sentinel)
+		{
+			if (extra >= end)
+				return NULL;
+			value = *extra++;
+		}
+		group[i] = (unsigned char)value;
+	}
+	return extra;
+}
+
+static bool decode_attributes(unsigned char* destination, size_t count, size_t stride, const unsigned char* source, size_t size)
+{
+	if (stride == 0 || stride > 256 || stride % 4 != 0 || size < 1 + stride)
+		return false;
+	if ((source[0] & 0xF0) != MESHOPT_VERTEX_HEADER || (source[0] & 0x0F) != 0)
+		return false;
+	const unsigned char* data = source + 1;
+	const unsigned char* end = source + size;
+
+	// Every byte starts as a delta from the same byte of the first element in the tail
+	size_t tail = std::max(stride, MESHOPT_TAIL_MIN);
+	if (size < 1 + tail)
+		return false;
+	unsigned char last[256];
+	std::memcpy(last, end - stride, stride);
+	end -= tail;
+
+	size_t blockElements = std::min((MESHOPT_BLOCK_BYTES / stride) & ~(MESHOPT_BYTE_GROUP - 1), MESHOPT_MAX_BLOCK_ELEMENTS);
+	unsigned char bytes[MESHOPT_MAX_BLOCK_ELEMENTS];
+	for (size_t first = 0; first < count; first += blockElements)
+	{
+		size_t elements = std::min(blockElements, count - first);
+		size_t groups = (elements + MESHOPT_BYTE_GROUP - 1) / MESHOPT_BYTE_GROUP;
+
+		// Each byte of the elements is coded on its own, after a header with 2 bits per group:
+		// all zero, 2 bits, 4 bits, or 8 bits per byte
+		for (size_t k = 0; k < stride; k++)
+		{
+			size_t headerSize = (groups + 3) / 4;
+			if ((size_t)(end - data) < headerSize)
+				return false;
+			const unsigned char* header = data;
+			data += headerSize;
+			for (size_t g = 0; g < groups; g++)
+			{
+				unsigned int mode = (header[g / 4] >> (g % 4 * 2)) & 3;
+				data = decode_byte_group(data, end, bytes + g * MESHOPT_BYTE_GROUP, mode == 0 ? 0 : 1u << mode);
+				if (data == NULL)
+					return false;
+			}
+
+			unsigned char previous = last[k];
+			for (size_t i = 0; i < elements; i++)
+			{
+				previous = (unsigned char)(previous + unzigzag8(bytes[i]));
+				destination[(first + i) * stride + k] = previous;
+			}
+			last[k] = previous;
+		}
+	}
+	return data == end;
+}
+
+static void write_index(unsigned char* destination, size_t i, size_t stride, unsigned int index)
+{
+	if (stride == 2)
+	{
+		unsigned short shortIndex = (unsigned short)index;
+		std::memcpy(destination + i * 2, &shortIndex, 2);
+	}
+	else
+		std::memcpy(destination + i * 4, &index, 4);
+}
+
+static bool decode_triangles(unsigned char* destination, size_t count, size_t stride, const unsigned char* source, size_t size)
+{
+	if (count % 3 != 0 || (stride != 2 && stride != 4) || size < 1 + count / 3 + 16)
+		return false;
+	unsigned int version = source[0] & 0x0F;
+	if ((source[0] & 0xF0) != MESHOPT_TRIANGLE_HEADER || version > 1)
+		return false;
+
+	// Recent edges and recent new vertices, referred to by how long ago they were pushed
+	unsigned int edges[16][2];
+	unsigned int vertices[16];
+	std::memset(edges, 0xFF, sizeof(edges));
+	std::memset(vertices, 0xFF, sizeof(vertices));
+	unsigned int edgeOffset = 0;
+	unsigned int vertexOffset = 0;
+	auto pushEdge = [&](unsigned int a, unsigned int b)
+	{
+		edges[edgeOffset][0] = a;
+		edges[edgeOffset][1] = b;
+		edgeOffset = (edgeOffset + 1) & 15;
+	};
+	auto pushVertex = [&](unsigned int v, bool push)
+	{
+		vertices[vertexOffset] = v;
+		vertexOffset = (vertexOffset + (push ? 1 : 0)) & 15;
+	};
+
+	// One code byte per triangle, then the bytes some codes take, then a table of 16 codes
+	// that the 0xF0 to 0xFD codes stand for
+	unsigned int next = 0;
+	unsigned int last = 0;
+	unsigned int fecMax = version >= 1 ? 13 : 15;
+	const unsigned char* code = source + 1;
+	const unsigned char* data = code + count / 3;
+	const unsigned char* end = source + size - 16;
+	const unsigned char* codeTable = end;
+	auto readIndex = [&](unsigned int& index)
+	{
+		unsigned int value;
+		if (!read_vbyte(data, end, value))
+			return false;
+		index = last = last + unzigzag32(value);
+		return true;
+	};
+
+	for (size_t i = 0; i < count; i += 3)
+	{
+		if (data > end)
+			return false;
+		unsigned int codeTri = *code++;
+		unsigned int a, b, c;
+		if (codeTri < 0xF0)
+		{
+			// An edge of a recent triangle, and a new vertex, a recent one, or one near the last
+			unsigned int fe = codeTri >> 4;
+			a = edges[(edgeOffset - 1 - fe) & 15][0];
+			b = edges[(edgeOffset - 1 - fe) & 15][1];
+			unsigned int fec = codeTri & 15;
+			if (fec < fecMax)
+			{
+				c = fec == 0 ? next++ : vertices[(vertexOffset - 1 - fec) & 15];
+				pushVertex(c, fec == 0);
+			}
+			else
+			{
+				if (fec == 15)
+				{
+					if (!readIndex(c))
+						return false;
+				}
+				else
+					c = last = last + (fec == 13 ? -1 : 1);
+				pushVertex(c, true);
+			}
+			pushEdge(c, b);
+			pushEdge(a, c);
+		}
+		else
+		{
+			// No shared edge: each vertex is new, recent, or given in full. The 0xF0 to 0xFD
+			// codes start with a new vertex and look the others up in the table.
+			unsigned int fea, feb, fec;
+			if (codeTri < 0xFE)
+			{
+				unsigned int codeAux = codeTable[codeTri & 15];
+				fea = 0;
+				feb = codeAux >> 4;
+				fec = codeAux & 15;
+				if (feb == 15 || fec == 15)
+					return false;
+			}
+			else
+			{
+				if (data >= end)
+					return false;
+				unsigned int codeAux = *data++;
+				fea = codeTri == 0xFE ? 0 : 15;
+				feb = codeAux >> 4;
+				fec = codeAux & 15;
+			}
+
+			a = fea == 0 ? next++ : 0;
+			b = feb == 0 ? next++ : vertices[(vertexOffset - feb) & 15];
+			c = fec == 0 ? next++ : vertices[(vertexOffset - fec) & 15];
+			if (fea == 15 && !readIndex(a))
+				return false;
+			if (feb == 15 && !readIndex(b))
+				return false;
+			if (fec == 15 && !readIndex(c))
+				return false;
+
+			pushVertex(a, true);
+			pushVertex(b, feb == 0 || feb == 15);
+			pushVertex(c, fec == 0 || fec == 15);
+			pushEdge(b, a);
+			pushEdge(c, b);
+			pushEdge(a, c);
+		}
+
+		write_index(destination, i, stride, a);
+		write_index(destination, i + 1, stride, b);
+		write_index(destination, i + 2, stride, c);
+	}
+	return data == end;
+}
+
+static bool decode_sequence(unsigned char* destination, size_t count, size_t stride, const unsigned char* source, size_t size)
+{
+	if ((stride != 2 && stride != 4) || size < 1 + count + 4)
+		return false;
+	if ((source[0] & 0xF0) != MESHOPT_SEQUENCE_HEADER || (source[0] & 0x0F) > 1)
+		return false;
+
+	// Every index is a delta from one of two earlier ones, the lowest bit picks which.
+	// The stream ends with 4 bytes of padding.
+	const unsigned char* data = source + 1;
+	const unsigned char* end = source + size - 4;
+	unsigned int last[2] = { 0, 0 };
+	for (size_t i = 0; i < count; i++)
+	{
+		unsigned int value;
+		if (!read_vbyte(data, end, value))
+			return false;
+		unsigned int baseline = value & 1;
+		last[baseline] += unzigzag32(value >> 1);
+		write_index(destination, i, stride, last[baseline]);
+	}
+	return data == end;
+}
+
+// Rounds to the nearest integer, halves away from zero.
+static int round_signed(float value)
+{
+	return (int)(value + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+template<typename T>
+static void undo_octahedral(T* data, size_t count)
+{
+	// The third component holds the length the vector is scaled back to, the fourth is kept
+	float maximum = (float)((1 << (sizeof(T) * 8 - 1)) - 1);
+	for (size_t i = 0; i < count; i++)
+	{
+		float x = data[i * 4 + 0];
+		float y = data[i * 4 + 1];
+		float z = data[i * 4 + 2] - std::fabs(x) - std::fabs(y);
+
+		// Fold the lower half back out of the corners of the octahedron
+		float t = std::min(z, 0.0f);
+		x += x >= 0.0f ? t : -t;
+		y += y >= 0.0f ? t : -t;
+
+		float scale = maximum / std::sqrt(x * x + y * y + z * z);
+		data[i * 4 + 0] = (T)round_signed(x * scale);
+		data[i * 4 + 1] = (T)round_signed(y * scale);
+		data[i * 4 + 2] = (T)round_signed(z * scale);
+	}
+}
+
+static void undo_quaternion(short* data, size_t count)
+{
+	// The fourth component holds the scale in its high bits and which component was left
+	// out, the largest one, in its low 2 bits
+	for (size_t i = 0; i < count; i++)
+	{
+		short* q = data + i * 4;
+		float scale = 1.0f / std::sqrt(2.0f) / (float)(q[3] | 3);
+		float x = q[0] * scale;
+		float y = q[1] * scale;
+		float z = q[2] * scale;
+		float w = std::sqrt(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+
+		unsigned int missing = q[3] & 3;
+		q[(missing + 1) & 3] = (short)round_signed(x * 32767.0f);
+		q[(missing + 2) & 3] = (short)round_signed(y * 32767.0f);
+		q[(missing + 3) & 3] = (short)round_signed(z * 32767.0f);
+		q[missing] = (short)round_signed(w * 32767.0f);
+	}
+}
+
+static void undo_exponential(unsigned int* data, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		// The mantissa is the low 24 bits sign extended, times 2 to the power in the high 8
+		int mantissa = (int)(data[i] << 8) >> 8;
+		int exponent = (int)data[i] >> 24;
+		float value = std::ldexp((float)mantissa, exponent);
+		std::memcpy(&data[i], &value, sizeof(float));
+	}
+}
+
+bool decode_meshopt(unsigned char* destination, size_t count, size_t stride, const unsigned char* source, size_t size, MeshoptMode mode, MeshoptFilter filter)
+{
+	if (size == 0)
+		return false;
+
+	bool decoded = false;
+	if (mode == MESHOPT_ATTRIBUTES)
+		decoded = decode_attributes(destination, count, stride, source, size);
+	else if (mode == MESHOPT_TRIANGLES)
+		decoded = decode_triangles(destination, count, stride, source, size);
+	else if (mode == MESHOPT_INDICES)
+		decoded = decode_sequence(destination, count, stride, source, size);
+	if (!decoded)
+		return false;
+
+	// Filters only apply to attributes, with the element sizes they were made for
+	if (filter == MESHOPT_FILTER_NONE)
+		return true;
+	if (mode != MESHOPT_ATTRIBUTES)
+		return false;
+	if (filter == MESHOPT_FILTER_OCTAHEDRAL && stride == 4)
+		undo_octahedral((signed char*)destination, count);
+	else if (filter == MESHOPT_FILTER_OCTAHEDRAL && stride == 8)
+		undo_octahedral((short*)destination, count);
+	else if (filter == MESHOPT_FILTER_QUATERNION && stride == 8)
+		undo_quaternion((short*)destination, count);
+	else if (filter == MESHOPT_FILTER_EXPONENTIAL && stride % 4 == 0)
+		undo_exponential((unsigned int*)destination, count * stride / 4);
+	else
+		return false;
+	return true;
+}
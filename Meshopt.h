@@ -0,0 +1,38 @@
+// If MESHOPT_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the functions during compilation.
+#ifndef MESHOPT_CLASS_H
+#define MESHOPT_CLASS_H
+
+#include<cstddef>
+
+
+// How the data of a bufferView compressed with EXT_meshopt_compression was encoded
+enum MeshoptMode
+{
+	// Vertex attributes, each byte of an element delta coded against the previous element
+	MESHOPT_ATTRIBUTES,
+	// Triangle lists, coded by the edges and vertices they share with recent triangles
+	MESHOPT_TRIANGLES,
+	// Any other indices, delta coded against one of the two previous ones
+	MESHOPT_INDICES,
+};
+
+// What the attributes were turned into before they were encoded, undone after decoding
+enum MeshoptFilter
+{
+	MESHOPT_FILTER_NONE,
+	// Unit vectors in octahedral coordinates, to 4 signed 8 or 16 bit components
+	MESHOPT_FILTER_OCTAHEDRAL,
+	// Rotations as their 3 smallest components, to 4 signed 16 bit components
+	MESHOPT_FILTER_QUATERNION,
+	// Floats as a 24 bit mantissa and an 8 bit exponent
+	MESHOPT_FILTER_EXPONENTIAL,
+};
+
+// Decodes the size bytes at source, which hold count elements of stride bytes encoded in
+// mode, into destination (count * stride bytes), then undoes filter on them. Indices are
+// 2 or 4 bytes wide. Returns false if the data is malformed or uses a newer version of
+// the format, destination then holds garbage.
+bool decode_meshopt(unsigned char* destination, size_t count, size_t stride, const unsigned char* source, size_t size, MeshoptMode mode, MeshoptFilter filter);
+
+#endif
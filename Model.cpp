@@ -1,26 +1,560 @@
 #include"Model.h"
+#include"Profiler.h"
 
-Model::Model(const char* file)
+#include<limits>
+#include<cstring>
+
+// Draco decoding needs the Draco library, define MODEL_DRACO when building with it
+#ifdef MODEL_DRACO
+#include<draco/compression/decode.h>
+#endif
+
+// SSE2 is always there on x64. Other targets decode base64 one character at a time.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include<emmintrin.h>
+#define MODEL_SSE2
+#endif
+
+// Chunk types and magic number of a .glb file, its bytes read as little endian integers
+const unsigned int GLB_MAGIC = 0x46546C67;
+const unsigned int GLB_CHUNK_JSON = 0x4E4F534A;
+const unsigned int GLB_CHUNK_BIN = 0x004E4942;
+
+#ifdef MODEL_SSE2
+// Sets the lanes of chars that lie between first and last to all ones. Characters above
+// 127 are negative as signed bytes and never in range.
+static __m128i in_range(__m128i chars, char first, char last)
+{
+	return _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8(first - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8(last + 1)));
+}
+#endif
+
+// Returns the 6 bits a base64 character stands for, or -1 if it isn't one.
+static int base64_value(char c)
+{
+	if (c >= 'A' && c <= 'Z') return c - 'A';
+	if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+	if (c >= '0' && c <= '9') return c - '0' + 52;
+	if (c == '+') return 62;
+	if (c == '/') return 63;
+	return -1;
+}
+
+// Decodes length characters of base64 into out. Returns false if they aren't valid base64.
+static bool decode_base64(const char* text, size_t length, std::vector<unsigned char>& out)
+{
+	// Padding only tells how many bytes the last group of 4 characters holds
+	while (length > 0 && text[length - 1] == '=')
+		length--;
+	if (length % 4 == 1)
+		return false;
+	out.resize(length / 4 * 3 + (length % 4 == 0 ? 0 : length % 4 - 1));
+	unsigned char* dst = out.data();
+	size_t i = 0;
+
+#ifdef MODEL_SSE2
+	// 16 characters become 12 bytes at a time. Each group of 4 is stored as 4 bytes and the
+	// next group overwrites the extra one, so the last group is left to the loop below.
+	while (i + 16 < length)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i*)(text + i));
+
+		// Move every range of the alphabet to its values, and stop at anything else
+		__m128i upper = in_range(chars, 'A', 'Z');
+		__m128i lower = in_range(chars, 'a', 'z');
+		__m128i digit = in_range(chars, '0', '9');
+		__m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+		__m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+		__m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(_mm_or_si128(digit, plus), slash));
+		if (_mm_movemask_epi8(valid) != 0xFFFF)
+			break;
+		__m128i offsets = _mm_or_si128(
+			_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+			_mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+				_mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(62 - '+')), _mm_and_si128(slash, _mm_set1_epi8(63 - '/')))));
+		__m128i values = _mm_add_epi8(chars, offsets);
+
+		// Every 32 bit lane holds the values a, b, c, d from its lowest byte up, they join to
+		// the 24 bits abcd, whose highest byte comes first in the output
+		__m128i mask = _mm_set1_epi32(0x3F);
+		__m128i joined = _mm_or_si128(
+			_mm_or_si128(_mm_slli_epi32(_mm_and_si128(values, mask), 18), _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(values, 8), mask), 12)),
+			_mm_or_si128(_mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(values, 16), mask), 6), _mm_srli_epi32(values, 24)));
+		__m128i ordered = _mm_or_si128(
+			_mm_or_si128(_mm_srli_epi32(joined, 16), _mm_and_si128(joined, _mm_set1_epi32(0xFF00))),
+			_mm_slli_epi32(_mm_and_si128(joined, _mm_set1_epi32(0xFF)), 16));
+
+		alignas(16) unsigned int groups[4];
+		_mm_store_si128((__m128i*)groups, ordered);
+		for (unsigned int g = 0; g < 4; g++)
+			std::memcpy(dst + g * 3, &groups[g], 4);
+		i += 16;
+		dst += 12;
+	}
+#endif
+
+	for (; i < length; i += 4)
+	{
+		// The last group may have only 2 or 3 characters
+		size_t groupLength = std::min(length - i, (size_t)4);
+		unsigned int joined = 0;
+		for (size_t j = 0; j < 4; j++)
+		{
+			int value = j < groupLength ? base64_value(text[i + j]) : 0;
+			if (value < 0)
+				return false;
+			joined = (joined << 6) | (unsigned int)value;
+		}
+		for (size_t j = 0; j + 1 < groupLength; j++)
+			*dst++ = (unsigned char)(joined >> (16 - 8 * j));
+	}
+	return true;
+}
+
+Model::Model(const char* file, TextureStreamer* streamer, JobSystem* jobs, MeshGeometry geometry, bool deferUpload)
 {
-	// Read the JSON file and parse it into a JSON object
-	std::string text = get_file_contents(file);
-	JSON = json::parse(text);
+	Model::streamer = streamer;
+	Model::jobs = jobs;
+	Model::geometry = geometry;
 
-	// Store the file path and load the associated binary data
+	// Map the file and parse its JSON where it lies, a .glb file holds it in its first chunk
 	Model::file = file;
-	data = getData();
+	MappedFile mapped;
+	if (!mapped.Open(file))
+		throw std::invalid_argument(std::string("Failed to open model: ") + file);
+	BufferData jsonChunk = { mapped.bytes, mapped.size };
+	BufferData binChunk = { NULL, 0 };
+	findGLBChunks(mapped.bytes, mapped.size, jsonChunk, binChunk);
+	JSON = json::parse(jsonChunk.bytes, jsonChunk.bytes + jsonChunk.size);
 
-	// Start traversing the scene graph from the first node
-	traverseNode(0);
+	// The binary chunk stays in the mapping, with the buffers it and other files hold
+	mappedFiles.push_back(std::move(mapped));
+	loadBuffers(binChunk);
+
+	// Compressed geometry is decoded up front, everything after reads it like any other
+	decompress();
+
+	// Read all images and materials before the meshes that reference them
+	loadMaterials();
+
+	// Flatten the node hierarchy into the scene graph and read the meshes it places
+	loadNodes();
+	loadSkins();
+	loadAnimations();
+	meshWeightChanges.assign(pending.meshes.size(), 0);
+	meshReweighted.assign(pending.meshes.size(), 0);
+
+	// Every accessor has been read, the meshes and animations hold what they need
+	std::vector<BufferData>().swap(buffers);
+	std::vector<MappedFile>().swap(mappedFiles);
+	std::vector<std::vector<unsigned char>>().swap(decodedBuffers);
+
+	if (!deferUpload)
+	{
+		GLsizeiptr unlimited = std::numeric_limits<GLsizeiptr>::max();
+		Upload(unlimited);
+	}
+}
+
+Model::~Model()
+{
+	// The streamer holds a copy of every streamed array, which keeps the texture alive
+	if (streamer != NULL)
+	{
+		for (unsigned int i = 0; i < textureArrays.size(); i++)
+			streamer->Unregister(textureArrays[i].ID);
+	}
+
+	// The handles of the meshes, skins, and materials release the rest as they go away.
+	// Texture names are reused once deleted, so the bind filter forgets them now.
+	textureArrays.clear();
+	TextureArray::ResetBindings();
+}
+
+bool Model::Upload(GLsizeiptr& budgetBytes)
+{
+	if (ready)
+		return true;
+
+	// The texture arrays and material tables go first, the meshes copy their materials
+	if (textureArrays.empty())
+	{
+		uploadMaterials();
+		budgetBytes -= (GLsizeiptr)(MAX_MATERIALS * (sizeof(MaterialData) + sizeof(PBRMaterialData)));
+		meshes.reserve(pending.meshes.size());
+	}
+
+	// Then the meshes, one at a time while there is budget left
+	while (pending.uploadedMeshes < pending.meshes.size() && budgetBytes > 0)
+	{
+		PendingMesh& mesh = pending.meshes[pending.uploadedMeshes++];
+		budgetBytes -= (GLsizeiptr)(mesh.vertices.size() * (sizeof(Vertex) + sizeof(glm::vec3)) + mesh.indices.size() * sizeof(GLuint) + mesh.skin.size() * sizeof(SkinVertex));
+		meshes.push_back(Mesh(std::move(mesh.vertices), std::move(mesh.indices), materials[mesh.material], std::move(mesh.skin), std::move(mesh.targets), geometry));
+		// Meshes that don't keep their geometry leave it here, free it before the next mesh
+		std::vector<Vertex>().swap(mesh.vertices);
+		std::vector<GLuint>().swap(mesh.indices);
+	}
+	if (pending.uploadedMeshes < pending.meshes.size())
+		return false;
+
+	// The skins are small, they finish the model in the same step as its last mesh
+	for (unsigned int i = 0; i < pending.skins.size(); i++)
+		skins.push_back(Skin(pending.skins[i].joints, pending.skins[i].inverseBindMatrices));
+	pending = PendingUpload();
+	ready = true;
+
+	// Work out every world matrix and skin once, after that only changes are recomputed
+	updateNodes();
+
+	// Sort the draw order by shader features and then texture arrays, so each shader
+	// variant is bound once and the texture bindings only change between groups
+	for (unsigned int i = 0; i < meshes.size(); i++)
+		drawOrder.push_back(i);
+	std::stable_sort(drawOrder.begin(), drawOrder.end(), [this](unsigned int a, unsigned int b)
+	{
+		const Material& matA = meshes[a].material;
+		const Material& matB = meshes[b].material;
+		if (meshFeatures(a) != meshFeatures(b))
+			return meshFeatures(a) < meshFeatures(b);
+		if (matA.diffuseArray != matB.diffuseArray)
+			return matA.diffuseArray < matB.diffuseArray;
+		return matA.specularArray < matB.specularArray;
+	});
+	return true;
+}
+
+bool Model::Ready()
+{
+	return ready;
 }
 
 void Model::Draw(Shader& shader, Camera& camera)
 {
+	if (!ready)
+		return;
+	updateNodes();
+	bindMaterials(shader);
+
+	// Let the streamer know which texture levels this frame needs
+	if (streamer != NULL)
+		requestTextureLevels(camera);
+
 	// Go over all meshes in the model and draw each one
+	for (unsigned int i = 0; i < drawOrder.size(); i++)
+	{
+		unsigned int ind = drawOrder[i];
+		meshes[ind].Mesh::Draw(shader, camera, meshMatrix(ind));
+	}
+}
+
+void Model::Draw(ShaderVariants& variants, unsigned int features, Camera& camera, DrawFilter filter)
+{
+	if (!ready)
+		return;
+	ProfileScope profile("Model::Draw");
+
+	// Bring the world matrices and skins up to date if any node was moved
+	updateNodes();
+
+	// Let the streamer know which texture levels this frame needs
+	if (streamer != NULL)
+		requestTextureLevels(camera);
+
+	// Draw every mesh with the variant matching the scene's features plus its material's.
+	// The draw order is sorted by material features, so each variant is set up only once.
+	Shader* current = NULL;
+	for (unsigned int i = 0; i < drawOrder.size(); i++)
+	{
+		unsigned int ind = drawOrder[i];
+		if (!passesFilter(ind, filter))
+			continue;
+		Shader& shader = variants.Get(features | meshFeatures(ind));
+		if (&shader != current)
+		{
+			bindMaterials(shader);
+			current = &shader;
+		}
+		if (gpuSkinned(ind))
+			skins[meshSkins[ind]].Bind();
+		if (gpuMorphed(ind))
+			meshes[ind].morphs.Bind(shader, nodes.weights[meshNodes[ind]]);
+		meshes[ind].Mesh::Draw(shader, camera, meshMatrix(ind));
+	}
+}
+
+// The planes bounding the view volume, taken straight from the matrix rows.
+// Each one points inwards, so a sphere is outside if it's fully behind any of them.
+static void frustum_planes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+	glm::mat4 rows = glm::transpose(viewProjection);
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[3] + rows[2];
+	planes[5] = rows[3] - rows[2];
+	for (unsigned int p = 0; p < 6; p++)
+		planes[p] /= glm::length(glm::vec3(planes[p]));
+}
+
+static bool sphere_in_frustum(const glm::vec4 planes[6], const glm::vec3& center, float radius)
+{
+	for (unsigned int p = 0; p < 6; p++)
+	{
+		if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -radius)
+			return false;
+	}
+	return true;
+}
+
+unsigned int Model::DrawDepth(ShaderVariants& variants, unsigned int features, const glm::mat4& viewProjection, DrawFilter filter)
+{
+	if (!ready)
+		return 0;
+	ProfileScope profile("Model::DrawDepth");
+	updateNodes();
+
+	glm::vec4 planes[6];
+	frustum_planes(viewProjection, planes);
+
+	depthOrder.clear();
+	for (unsigned int i = 0; i < drawOrder.size(); i++)
+	{
+		unsigned int ind = drawOrder[i];
+		if (!passesFilter(ind, filter))
+			continue;
+		glm::vec3 center;
+		float radius;
+		worldBounds(ind, center, radius);
+
+		if (!sphere_in_frustum(planes, center, radius))
+			continue;
+
+		// Clip space z grows with distance for both perspective and orthographic views
+		depthOrder.push_back(std::make_pair((viewProjection * glm::vec4(center, 1.0f)).z, ind));
+	}
+
+	// Draw front to back, so nearer meshes hide the ones behind them before they are rasterized
+	std::sort(depthOrder.begin(), depthOrder.end());
+	Shader* current = NULL;
+	for (unsigned int i = 0; i < depthOrder.size(); i++)
+	{
+		// Skinning, morphing and alpha testing are the only features that change how depth is drawn,
+		// and PBR only through the base color factor of the alpha test
+		unsigned int ind = depthOrder[i].second;
+		unsigned int depthFeatures = animationFeatures(ind) | (meshes[ind].material.features & SHADER_ALPHA_TEST);
+		if (depthFeatures & SHADER_ALPHA_TEST)
+			depthFeatures |= features & SHADER_PBR;
+		Shader& shader = variants.Get(depthFeatures);
+		if (&shader != current)
+		{
+			// Also points the ALPHA_TEST variants at the diffuse arrays and the material table
+			bindMaterials(shader);
+			glUniformMatrix4fv(shader.Uniform("camMatrix"), 1, GL_FALSE, glm::value_ptr(viewProjection));
+			current = &shader;
+		}
+		if (gpuSkinned(ind))
+			skins[meshSkins[ind]].Bind();
+		if (gpuMorphed(ind))
+			meshes[ind].morphs.Bind(shader, nodes.weights[meshNodes[ind]]);
+		meshes[ind].Mesh::DrawDepth(shader, meshMatrix(ind));
+	}
+	return (unsigned int)depthOrder.size();
+}
+
+void Model::Animate(unsigned int animation, float seconds)
+{
+	if (animation >= animations.size() || animations[animation].duration <= 0.0f)
+		return;
+	ProfileScope profile("Animation");
+	animations[animation].Sample(std::fmod(seconds, animations[animation].duration), nodes, jobs);
+}
+
+bool Model::passesFilter(unsigned int mesh, DrawFilter filter)
+{
+	bool alphaTested = (meshes[mesh].material.features & SHADER_ALPHA_TEST) != 0;
+	if (filter == DRAW_OPAQUE)
+		return !alphaTested;
+	if (filter == DRAW_ALPHA_TESTED)
+		return alphaTested;
+	return true;
+}
+
+bool Model::gpuSkinned(unsigned int mesh)
+{
+	return meshSkins[mesh] >= 0 && !cpuSkinning && skins[meshSkins[mesh]].GPU();
+}
+
+bool Model::gpuMorphed(unsigned int mesh)
+{
+	// The deltas are in the bind pose, so the shaders can only morph meshes they also skin
+	return meshes[mesh].morphs.GPU() && !cpuMorphing && (meshSkins[mesh] < 0 || gpuSkinned(mesh));
+}
+
+unsigned int Model::animationFeatures(unsigned int mesh)
+{
+	unsigned int features = 0;
+	if (gpuSkinned(mesh))
+		features |= SHADER_SKINNING;
+	if (gpuMorphed(mesh))
+		features |= SHADER_MORPHING;
+	return features;
+}
+
+unsigned int Model::meshFeatures(unsigned int mesh)
+{
+	return meshes[mesh].material.features | animationFeatures(mesh);
+}
+
+const glm::mat4& Model::meshMatrix(unsigned int mesh)
+{
+	static const glm::mat4 identity = glm::mat4(1.0f);
+	return meshSkins[mesh] >= 0 ? identity : nodes.worlds[meshNodes[mesh]];
+}
+
+void Model::updateNodes()
+{
+	// The skins only change when a node moved, the morphs when the weights of their node
+	// changed, and both when they move between the CPU and GPU
+	bool moved = nodes.Update(jobs) > 0;
+	bool switched = cpuSkinning != skinnedOnCPU || cpuMorphing != morphedOnCPU;
+	skinnedOnCPU = cpuSkinning;
+	morphedOnCPU = cpuMorphing;
+
+	bool reweighted = false;
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		unsigned int changes = nodes.weightChanges[meshNodes[i]];
+		meshReweighted[i] = !meshes[i].morphs.targets.empty() && (switched || changes != meshWeightChanges[i]);
+		meshWeightChanges[i] = changes;
+		reweighted = reweighted || meshReweighted[i];
+	}
+	bool posed = !skins.empty() && (moved || switched);
+	if (!posed && !reweighted)
+		return;
+
+	// Build the palettes, then morph and skin the meshes that need it on the CPU, both on
+	// the job system if there is one. Only the uploads have to happen on this thread.
+	ProfileScope profile("Skinning");
+	if (posed)
+	{
+		parallelFor((unsigned int)skins.size(), [this](unsigned int i)
+		{
+			skins[i].Update(nodes);
+		});
+		for (unsigned int i = 0; i < skins.size(); i++)
+			skins[i].Upload(stream);
+	}
+
+	parallelFor((unsigned int)meshes.size(), [this, posed](unsigned int i)
+	{
+		// Morph first, skinning starts from the morphed vertices
+		if (meshReweighted[i] && gpuMorphed(i))
+			meshes[i].ClearMorph();
+		else if (meshReweighted[i])
+			meshes[i].MorphCPU(nodes.weights[meshNodes[i]]);
+
+		if (meshSkins[i] < 0 || (!posed && !meshReweighted[i]))
+			return;
+		Skin& skin = skins[meshSkins[i]];
+		if (!gpuSkinned(i))
+			meshes[i].SkinCPU(skin.palette);
+
+		// A vertex ends up between where each of its joints would put it on its own,
+		// so the spheres the joints move the mesh's sphere to hold every vertex
+		glm::vec3 localCenter = (meshes[i].boundsMin + meshes[i].boundsMax) * 0.5f;
+		float localRadius = glm::length(meshes[i].boundsMax - meshes[i].boundsMin) * 0.5f;
+		glm::vec3 low = localCenter - localRadius;
+		glm::vec3 high = localCenter + localRadius;
+		for (unsigned int j = 0; j < skin.palette.size(); j++)
+		{
+			glm::mat4& matrix = skin.palette[j];
+			glm::vec3 center = glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+			float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+			low = j == 0 ? center - localRadius * scale : glm::min(low, center - localRadius * scale);
+			high = j == 0 ? center + localRadius * scale : glm::max(high, center + localRadius * scale);
+		}
+		skinnedBounds[i] = glm::vec4((low + high) * 0.5f, glm::length(high - low) * 0.5f);
+	});
+
 	for (unsigned int i = 0; i < meshes.size(); i++)
 	{
-		meshes[i].Mesh::Draw(shader, camera, matricesMeshes[i]);
+		bool skinned = meshSkins[i] >= 0;
+		if (skinned && !gpuSkinned(i))
+		{
+			if (posed || meshReweighted[i])
+				meshes[i].UploadSkin(stream);
+		}
+		else if (switched && (skinned || !meshes[i].morphs.targets.empty()))
+			meshes[i].RestoreBindPose(stream);
+		else if (meshReweighted[i] && !gpuMorphed(i))
+			meshes[i].UploadMorph(stream);
+	}
+}
+
+void Model::parallelFor(unsigned int count, const std::function<void(unsigned int)>& function)
+{
+	if (jobs == NULL || jobs->Size() < 2 || count < 2)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			function(i);
+		return;
+	}
+
+	JobCounter counter;
+	jobs->ParallelFor(count, 1, [&function](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+			function(i);
+	}, counter);
+	jobs->Wait(counter);
+}
+
+void Model::bindMaterials(Shader& shader)
+{
+	// Point the texture samplers at the units Mesh::Draw binds the arrays to
+	shader.Activate();
+	glUniform1i(shader.Uniform("diffuse0"), 0);
+	glUniform1i(shader.Uniform("specular0"), 1);
+	glUniform1i(shader.Uniform("normal0"), NORMAL_MAP_UNIT);
+	glUniform1i(shader.Uniform("occlusion0"), OCCLUSION_UNIT);
+	glUniform1i(shader.Uniform("emissive0"), EMISSIVE_UNIT);
+
+	// Bind this model's material table to the shader's Materials block
+	GLuint blockIndex = glGetUniformBlockIndex(shader.ID, "Materials");
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader.ID, blockIndex, MATERIAL_UBO_BINDING);
+	glBindBufferBase(GL_UNIFORM_BUFFER, MATERIAL_UBO_BINDING, materialUBO.ID);
+
+	// PBR variants also read the factors of the material table
+	blockIndex = glGetUniformBlockIndex(shader.ID, "PBRMaterials");
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader.ID, blockIndex, PBR_MATERIAL_UBO_BINDING);
+	glBindBufferBase(GL_UNIFORM_BUFFER, PBR_MATERIAL_UBO_BINDING, pbrMaterialUBO.ID);
+
+	// SKINNING variants read the joint palette of the mesh being drawn
+	blockIndex = glGetUniformBlockIndex(shader.ID, "Skin");
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader.ID, blockIndex, SKIN_UBO_BINDING);
+}
+
+void Model::worldBounds(unsigned int mesh, glm::vec3& center, float& radius)
+{
+	// default.vert multiplies by -rotation, which flips the whole vertex through the origin
+	if (meshSkins[mesh] >= 0)
+	{
+		center = -glm::vec3(skinnedBounds[mesh]);
+		radius = skinnedBounds[mesh].w;
+		return;
 	}
+
+	glm::vec3 localCenter = (meshes[mesh].boundsMin + meshes[mesh].boundsMax) * 0.5f;
+	float localRadius = glm::length(meshes[mesh].boundsMax - meshes[mesh].boundsMin) * 0.5f;
+
+	glm::mat4& matrix = nodes.worlds[meshNodes[mesh]];
+	center = -glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+	float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+	radius = localRadius * scale;
 }
 
 void Model::loadMesh(unsigned int indMesh)
@@ -42,123 +576,688 @@ void Model::loadMesh(unsigned int indMesh)
 	// Combine all vertex data, and get the indices and textures
 	std::vector<Vertex> vertices = assembleVertices(positions, normals, texUVs);
 	std::vector<GLuint> indices = getIndices(JSON["accessors"][indAccInd]);
-	std::vector<Texture> textures = getTextures();
 
-	// Create a new Mesh object from the vertex, index, and texture data
-	meshes.push_back(Mesh(vertices, indices, textures));
+	// Primitives without a material use the default material at the end of the list
+	int matInd = JSON["meshes"][indMesh]["primitives"][0].value("material", -1);
+	unsigned int materialIndex = (matInd >= 0 && matInd < (int)materials.size() - 1) ? (unsigned int)matInd : (unsigned int)materials.size() - 1;
+	const Material& material = materials[materialIndex];
+
+	// Only normal mapped materials need tangents. The file's own are used if it has them.
+	json attributes = JSON["meshes"][indMesh]["primitives"][0]["attributes"];
+	if (material.features & SHADER_NORMAL_MAP)
+	{
+		std::vector<glm::vec4> tangents;
+		if (attributes.find("TANGENT") != attributes.end())
+			tangents = groupFloatsVec4(getFloats(JSON["accessors"][(unsigned int)attributes["TANGENT"]]));
+		if (tangents.size() == vertices.size())
+		{
+			for (unsigned int i = 0; i < vertices.size(); i++)
+				vertices[i].tangent = gltf_tangent(vertices[i].normal, tangents[i]);
+		}
+		else
+			loadTangents(vertices, indices);
+	}
+
+	// Skinned primitives also list the joints that move each vertex and their weights
+	std::vector<SkinVertex> skin;
+	if (attributes.find("JOINTS_0") != attributes.end() && attributes.find("WEIGHTS_0") != attributes.end())
+	{
+		unsigned int jointsAccInd = attributes["JOINTS_0"];
+		unsigned int weightsAccInd = attributes["WEIGHTS_0"];
+		std::vector<glm::vec4> joints = groupFloatsVec4(getFloats(JSON["accessors"][jointsAccInd]));
+		std::vector<glm::vec4> weights = groupFloatsVec4(getFloats(JSON["accessors"][weightsAccInd]));
+		if (joints.size() == vertices.size() && weights.size() == vertices.size())
+		{
+			for (unsigned int i = 0; i < vertices.size(); i++)
+				skin.push_back(SkinVertex{ joints[i], weights[i] });
+		}
+	}
+
+	// Morph targets hold a position and normal delta for every vertex, possibly as sparse
+	// accessors. Only the vertices a target actually moves are kept.
+	std::vector<MorphTarget> targets;
+	json primitive = JSON["meshes"][indMesh]["primitives"][0];
+	unsigned int numTargets = primitive.find("targets") != primitive.end() ? (unsigned int)primitive["targets"].size() : 0;
+	for (unsigned int t = 0; t < numTargets; t++)
+	{
+		json targetJSON = primitive["targets"][t];
+		std::vector<glm::vec3> positionDeltas;
+		std::vector<glm::vec3> normalDeltas;
+		if (targetJSON.find("POSITION") != targetJSON.end())
+			positionDeltas = groupFloatsVec3(getFloats(JSON["accessors"][(unsigned int)targetJSON["POSITION"]]));
+		if (targetJSON.find("NORMAL") != targetJSON.end())
+			normalDeltas = groupFloatsVec3(getFloats(JSON["accessors"][(unsigned int)targetJSON["NORMAL"]]));
+		positionDeltas.resize(vertices.size(), glm::vec3(0.0f));
+		normalDeltas.resize(vertices.size(), glm::vec3(0.0f));
+
+		MorphTarget target;
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			if (positionDeltas[i] == glm::vec3(0.0f) && normalDeltas[i] == glm::vec3(0.0f))
+				continue;
+			target.vertices.push_back(i);
+			target.positions.push_back(glm::vec4(positionDeltas[i], 0.0f));
+			target.normals.push_back(glm::vec4(normalDeltas[i], 0.0f));
+		}
+		targets.push_back(std::move(target));
+	}
+
+	// Keep the vertex, index, and material data for Upload to create the Mesh from.
+	// The vectors move all the way into the mesh, so none of them is copied on the way.
+	PendingMesh mesh;
+	mesh.vertices = std::move(vertices);
+	mesh.indices = std::move(indices);
+	mesh.material = materialIndex;
+	mesh.skin = std::move(skin);
+	mesh.targets = std::move(targets);
+	pending.meshes.push_back(std::move(mesh));
+}
+
+void Model::loadTangents(std::vector<Vertex>& vertices, std::vector<GLuint>& indices)
+{
+	// Keyed by everything tangents are made from, which is all of the vertex data and the triangles
+	std::string key = assetCache.Key("tangents",
+	{
+		std::make_pair((const void*)vertices.data(), vertices.size() * sizeof(Vertex)),
+		std::make_pair((const void*)indices.data(), indices.size() * sizeof(GLuint)),
+	});
+
+	std::vector<char> baked;
+	if (assetCache.Load(key, baked) && baked.size() == vertices.size() * sizeof(glm::vec4))
+	{
+		const glm::vec4* tangents = (const glm::vec4*)baked.data();
+		for (unsigned int i = 0; i < vertices.size(); i++)
+			vertices[i].tangent = tangents[i];
+		return;
+	}
+
+	generate_tangents(indices, vertices, jobs);
+	std::vector<glm::vec4> tangents(vertices.size());
+	for (unsigned int i = 0; i < vertices.size(); i++)
+		tangents[i] = vertices[i].tangent;
+	assetCache.Store(key, tangents.data(), tangents.size() * sizeof(glm::vec4));
+}
+
+void Model::loadNodes()
+{
+	// Start from the root nodes of the default scene, or from node 0 if the file has no scenes
+	std::vector<unsigned int> roots;
+	if (JSON.find("scenes") != JSON.end() && !JSON["scenes"].empty())
+	{
+		json scene = JSON["scenes"][JSON.value("scene", 0)];
+		for (unsigned int i = 0; i < scene["nodes"].size(); i++)
+			roots.push_back(scene["nodes"][i]);
+	}
+	else
+		roots.push_back(0);
+
+	// Visit the nodes depth first with a stack of (glTF node, parent in the graph) pairs.
+	// Every node is added after its parent, which is the order SceneGraph::Update needs.
+	graphNodes.assign(JSON["nodes"].size(), -1);
+	std::vector<std::pair<unsigned int, int>> stack;
+	for (unsigned int i = (unsigned int)roots.size(); i > 0; i--)
+		stack.push_back(std::make_pair(roots[i - 1], -1));
+	while (!stack.empty())
+	{
+		unsigned int nodeIndex = stack.back().first;
+		int parent = stack.back().second;
+		stack.pop_back();
+
+		// Get the current node from the JSON structure
+		json node = JSON["nodes"][nodeIndex];
+
+		// Initialize translation, rotation, and scale with default values
+		glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f);
+		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
+		glm::mat4 matNode = glm::mat4(1.0f);
+
+		// If the node has translation data, read it
+		if (node.find("translation") != node.end())
+		{
+			float transValues[3];
+			for (unsigned int i = 0; i < node["translation"].size(); i++)
+				transValues[i] = (node["translation"][i]);
+			translation = glm::make_vec3(transValues);
+		}
+
+		// If the node has rotation data, read it and convert to a quaternion.
+		// glTF stores x, y, z, w, while glm's constructor takes w first.
+		if (node.find("rotation") != node.end())
+		{
+			float rotValues[4];
+			for (unsigned int i = 0; i < 4; i++)
+				rotValues[i] = (node["rotation"][i]);
+			rotation = glm::quat(rotValues[3], rotValues[0], rotValues[1], rotValues[2]);
+		}
+
+		// If the node has scale data, read it
+		if (node.find("scale") != node.end())
+		{
+			float scaleValues[3];
+			for (unsigned int i = 0; i < node["scale"].size(); i++)
+				scaleValues[i] = (node["scale"][i]);
+			scale = glm::make_vec3(scaleValues);
+		}
+
+		// If the node has a transformation matrix, read it
+		if (node.find("matrix") != node.end())
+		{
+			float matValues[16];
+			for (unsigned int i = 0; i < node["matrix"].size(); i++)
+				matValues[i] = (node["matrix"][i]);
+			matNode = glm::make_mat4(matValues);
+		}
+
+		unsigned int graphIndex = nodes.Add(parent, matNode, translation, rotation, scale);
+		graphNodes[nodeIndex] = (int)graphIndex;
+
+		// If this node contains a mesh, load it and remember which node places it
+		if (node.find("mesh") != node.end())
+		{
+			meshNodes.push_back(graphIndex);
+			meshSkins.push_back(node.value("skin", -1));
+			loadMesh(node["mesh"]);
+
+			// The node's morph target weights, the mesh's default weights, or all 0.
+			// Setting them counts as a change, so the first update morphs the mesh.
+			json mesh = JSON["meshes"][(unsigned int)node["mesh"]];
+			json weightsJSON = node.find("weights") != node.end() ? node["weights"] : mesh.value("weights", json::array());
+			std::vector<float> weights(pending.meshes.back().targets.size(), 0.0f);
+			for (unsigned int i = 0; i < weightsJSON.size() && i < weights.size(); i++)
+				weights[i] = weightsJSON[i];
+			nodes.weights[graphIndex] = weights;
+			nodes.SetWeights(graphIndex, weights.data(), (unsigned int)weights.size());
+		}
+
+		// Visit the children next, in the order they are listed
+		if (node.find("children") != node.end())
+		{
+			for (unsigned int i = (unsigned int)node["children"].size(); i > 0; i--)
+				stack.push_back(std::make_pair((unsigned int)node["children"][i - 1], (int)graphIndex));
+		}
+	}
 }
 
-void Model::traverseNode(unsigned int nextNode, glm::mat4 matrix)
+void Model::loadSkins()
 {
-	// Get the current node from the JSON structure
-	json node = JSON["nodes"][nextNode];
+	unsigned int numSkins = JSON.find("skins") != JSON.end() ? (unsigned int)JSON["skins"].size() : 0;
+	for (unsigned int i = 0; i < numSkins; i++)
+	{
+		json skin = JSON["skins"][i];
 
-	// Initialize translation, rotation, and scale with default values
-	glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f);
-	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
-	glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
-	glm::mat4 matNode = glm::mat4(1.0f);
+		// Find the joints in the scene graph
+		std::vector<unsigned int> joints;
+		for (unsigned int j = 0; j < skin["joints"].size(); j++)
+		{
+			int graphIndex = graphNodes[(unsigned int)skin["joints"][j]];
+			if (graphIndex < 0)
+			{
+				std::cout << "SKIN_JOINT_ERROR: joint " << skin["joints"][j] << " of skin " << i << " is not in the scene" << std::endl;
+				graphIndex = 0;
+			}
+			joints.push_back((unsigned int)graphIndex);
+		}
+
+		// Without inverse bind matrices the mesh is already in the joints' space
+		std::vector<glm::mat4> inverseBindMatrices(joints.size(), glm::mat4(1.0f));
+		if (skin.find("inverseBindMatrices") != skin.end())
+		{
+			unsigned int ibmAccInd = skin["inverseBindMatrices"];
+			std::vector<float> ibmVec = getFloats(JSON["accessors"][ibmAccInd]);
+			for (unsigned int j = 0; j < joints.size() && (j + 1) * 16 <= ibmVec.size(); j++)
+				inverseBindMatrices[j] = glm::make_mat4(&ibmVec[j * 16]);
+		}
+
+		pending.skins.push_back(PendingSkin{ joints, inverseBindMatrices });
+	}
 
-	// If the node has translation data, read it
-	if (node.find("translation") != node.end())
+	// Meshes without joints and weights, or pointing at a missing skin, are drawn unskinned
+	skinnedBounds.assign(pending.meshes.size(), glm::vec4(0.0f));
+	for (unsigned int i = 0; i < pending.meshes.size(); i++)
 	{
-		float transValues[3];
-		for (unsigned int i = 0; i < node["translation"].size(); i++)
-			transValues[i] = (node["translation"][i]);
-		translation = glm::make_vec3(transValues);
+		if (meshSkins[i] >= (int)pending.skins.size() || pending.meshes[i].skin.empty())
+			meshSkins[i] = -1;
 	}
+}
 
-	// If the node has rotation data, read it and convert to a quaternion
-	if (node.find("rotation") != node.end())
+void Model::loadAnimations()
+{
+	unsigned int numAnimations = JSON.find("animations") != JSON.end() ? (unsigned int)JSON["animations"].size() : 0;
+	for (unsigned int i = 0; i < numAnimations; i++)
 	{
-		float rotValues[4] =
+		json source = JSON["animations"][i];
+		Animation animation;
+		animation.name = source.value("name", std::string(""));
+
+		for (unsigned int j = 0; j < source["samplers"].size(); j++)
 		{
-			node["rotation"][3],
-			node["rotation"][0],
-			node["rotation"][1],
-			node["rotation"][2]
-		};
-		rotation = glm::make_quat(rotValues);
+			json samplerJSON = source["samplers"][j];
+			unsigned int inputAccInd = samplerJSON["input"];
+			unsigned int outputAccInd = samplerJSON["output"];
+
+			AnimationSampler sampler;
+			sampler.times = getFloats(JSON["accessors"][inputAccInd]);
+			std::string interpolation = samplerJSON.value("interpolation", std::string("LINEAR"));
+			if (interpolation == "STEP") sampler.interpolation = INTERPOLATION_STEP;
+			else if (interpolation == "CUBICSPLINE") sampler.interpolation = INTERPOLATION_CUBIC_SPLINE;
+			else sampler.interpolation = INTERPOLATION_LINEAR;
+
+			// Translations and scales are padded to vec4s, rotations already are
+			json output = JSON["accessors"][outputAccInd];
+			std::string type = output["type"];
+			unsigned int valuesPerKey = sampler.interpolation == INTERPOLATION_CUBIC_SPLINE ? 3 : 1;
+			if (type == "VEC3")
+			{
+				std::vector<glm::vec3> values = groupFloatsVec3(getFloats(output));
+				for (unsigned int k = 0; k < values.size(); k++)
+					sampler.values.push_back(glm::vec4(values[k], 0.0f));
+			}
+			else if (type == "VEC4")
+				sampler.values = groupFloatsVec4(getFloats(output));
+			else if (type == "SCALAR" && !sampler.times.empty())
+			{
+				// Morph target weights, one per target in every value, packed four to a vec4
+				std::vector<float> weights = getFloats(output);
+				unsigned int numValues = (unsigned int)sampler.times.size() * valuesPerKey;
+				unsigned int perValue = (unsigned int)weights.size() / numValues;
+				sampler.width = std::max((perValue + 3) / 4, 1u);
+				if (perValue > 0)
+					sampler.values.assign(numValues * sampler.width, glm::vec4(0.0f));
+				for (unsigned int v = 0; v < numValues && perValue > 0; v++)
+				{
+					for (unsigned int w = 0; w < perValue; w++)
+						sampler.values[v * sampler.width + w / 4][w % 4] = weights[v * perValue + w];
+				}
+			}
+
+			// Samplers without a value for every keyframe are left empty and never sampled
+			if (sampler.values.size() < sampler.times.size() * valuesPerKey * sampler.width)
+				sampler.times.clear();
+			if (!sampler.times.empty())
+				animation.duration = std::max(animation.duration, sampler.times.back());
+			animation.samplers.push_back(sampler);
+		}
+
+		for (unsigned int j = 0; j < source["channels"].size(); j++)
+		{
+			json channelJSON = source["channels"][j];
+			json target = channelJSON["target"];
+			if (target.find("node") == target.end())
+				continue;
+
+			// Nodes outside the scene have nothing to move
+			int node = graphNodes[(unsigned int)target["node"]];
+			unsigned int sampler = channelJSON["sampler"];
+			if (node < 0 || sampler >= animation.samplers.size())
+				continue;
+
+			std::string path = target.value("path", std::string(""));
+			AnimationChannel channel;
+			channel.sampler = sampler;
+			channel.node = (unsigned int)node;
+			if (path == "translation") channel.path = ANIMATION_TRANSLATION;
+			else if (path == "rotation") channel.path = ANIMATION_ROTATION;
+			else if (path == "scale") channel.path = ANIMATION_SCALE;
+			else if (path == "weights") channel.path = ANIMATION_WEIGHTS;
+			else continue;
+			animation.channels.push_back(channel);
+		}
+
+		animations.push_back(animation);
 	}
+}
+
+bool Model::findGLBChunks(const unsigned char* bytes, size_t size, BufferData& jsonChunk, BufferData& binChunk)
+{
+	// The header is the magic number, the version, and the length of the whole file
+	unsigned int header[3];
+	if (size < sizeof(header))
+		return false;
+	std::memcpy(header, bytes, sizeof(header));
+	if (header[0] != GLB_MAGIC)
+		return false;
+	if (header[1] != 2 || header[2] > size)
+		throw std::invalid_argument("Unsupported or truncated .glb file");
 
-	// If the node has scale data, read it
-	if (node.find("scale") != node.end())
+	// Chunks follow as their length, their type, and their data, the JSON one first
+	jsonChunk = { NULL, 0 };
+	size_t offset = sizeof(header);
+	while (offset + 8 <= header[2])
 	{
-		float scaleValues[3];
-		for (unsigned int i = 0; i < node["scale"].size(); i++)
-			scaleValues[i] = (node["scale"][i]);
-		scale = glm::make_vec3(scaleValues);
+		unsigned int chunk[2];
+		std::memcpy(chunk, bytes + offset, sizeof(chunk));
+		offset += sizeof(chunk);
+		if (chunk[0] > header[2] - offset)
+			throw std::invalid_argument("Truncated .glb chunk");
+		if (chunk[1] == GLB_CHUNK_JSON && jsonChunk.bytes == NULL)
+			jsonChunk = { bytes + offset, chunk[0] };
+		else if (chunk[1] == GLB_CHUNK_BIN && binChunk.bytes == NULL)
+			binChunk = { bytes + offset, chunk[0] };
+		offset += chunk[0];
 	}
+	if (jsonChunk.bytes == NULL)
+		throw std::invalid_argument(".glb file has no JSON chunk");
+	return true;
+}
+
+void Model::loadBuffers(BufferData binChunk)
+{
+	std::string fileStr = std::string(file);
+	std::string fileDirectory = fileStr.substr(0, fileStr.find_last_of('/') + 1);
 
-	// If the node has a transformation matrix, read it
-	if (node.find("matrix") != node.end())
+	if (JSON.find("buffers") == JSON.end())
+		return;
+	json& buffersJSON = JSON["buffers"];
+	for (unsigned int i = 0; i < buffersJSON.size(); i++)
 	{
-		float matValues[16];
-		for (unsigned int i = 0; i < node["matrix"].size(); i++)
-			matValues[i] = (node["matrix"][i]);
-		matNode = glm::make_mat4(matValues);
+		json& buffer = buffersJSON[i];
+		BufferData data = { NULL, 0 };
+		bool fallback = buffer.find("extensions") != buffer.end() && buffer["extensions"].find("EXT_meshopt_compression") != buffer["extensions"].end()
+			&& buffer["extensions"]["EXT_meshopt_compression"].value("fallback", false);
+		if (buffer.find("uri") == buffer.end() && fallback)
+		{
+			// Holds the decompressed bufferViews in files that don't ship them uncompressed,
+			// decompress gives those bufferViews their bytes
+			buffers.push_back(data);
+			continue;
+		}
+		else if (buffer.find("uri") == buffer.end())
+		{
+			// Only the first buffer of a .glb file can be its binary chunk, which has no URI
+			if (binChunk.bytes == NULL || i != 0)
+				throw std::invalid_argument("Buffer without a URI outside a .glb binary chunk");
+			data = binChunk;
+		}
+		else
+		{
+			std::string uri = buffer["uri"];
+			if (uri.compare(0, 5, "data:") == 0)
+			{
+				// Embedded as base64 after the media type
+				size_t start = uri.find(";base64,");
+				decodedBuffers.push_back(std::vector<unsigned char>());
+				if (start == std::string::npos || !decode_base64(uri.c_str() + start + 8, uri.size() - start - 8, decodedBuffers.back()))
+					throw std::invalid_argument("Failed to decode the data URI of buffer " + std::to_string(i));
+				data = { decodedBuffers.back().data(), decodedBuffers.back().size() };
+			}
+			else
+			{
+				MappedFile mapped;
+				if (!mapped.Open((fileDirectory + uri).c_str()))
+					throw std::invalid_argument("Failed to open buffer: " + fileDirectory + uri);
+				data = { mapped.bytes, mapped.size };
+				mappedFiles.push_back(std::move(mapped));
+			}
+		}
+
+		// The binary chunk may be padded, but never shorter than the buffer
+		if (data.size < buffer.value("byteLength", (size_t)0))
+			throw std::invalid_argument("Buffer " + std::to_string(i) + " is shorter than its byteLength");
+		buffers.push_back(data);
 	}
+}
+
+void Model::decompress()
+{
+	if (JSON.find("bufferViews") == JSON.end())
+		return;
+	json& bufferViews = JSON["bufferViews"];
+	decodedViews.assign(bufferViews.size(), BufferData{ NULL, 0 });
 
-	// Create transformation matrices for translation, rotation, and scale
-	glm::mat4 trans = glm::mat4(1.0f);
-	glm::mat4 rot = glm::mat4(1.0f);
-	glm::mat4 sca = glm::mat4(1.0f);
+	// Everything the jobs need is read from the JSON here, the jobs only touch their own data
+	struct MeshoptView
+	{
+		unsigned int view;
+		const unsigned char* source;
+		size_t size;
+		size_t count;
+		size_t stride;
+		MeshoptMode mode;
+		MeshoptFilter filter;
+	};
+	std::vector<MeshoptView> meshoptViews;
+	for (unsigned int i = 0; i < bufferViews.size(); i++)
+	{
+		json& bufferView = bufferViews[i];
+		if (bufferView.find("extensions") == bufferView.end() || bufferView["extensions"].find("EXT_meshopt_compression") == bufferView["extensions"].end())
+			continue;
+		json& compression = bufferView["extensions"]["EXT_meshopt_compression"];
 
-	trans = glm::translate(trans, translation);
-	rot = glm::mat4_cast(rotation);
-	sca = glm::scale(sca, scale);
+		MeshoptView meshopt;
+		meshopt.view = i;
+		meshopt.count = compression["count"];
+		meshopt.stride = compression["byteStride"];
+		unsigned int buffer = compression["buffer"];
+		size_t offset = compression.value("byteOffset", (size_t)0);
+		meshopt.size = compression["byteLength"];
+		if (buffer >= buffers.size() || offset + meshopt.size > buffers[buffer].size)
+			throw std::invalid_argument("Compressed bufferView " + std::to_string(i) + " lies past the end of buffer " + std::to_string(buffer));
+		meshopt.source = buffers[buffer].bytes + offset;
 
-	// Multiply all transformations together to get the final matrix for this node
-	glm::mat4 matNextNode = matrix * matNode * trans * rot * sca;
+		std::string mode = compression["mode"];
+		std::string filter = compression.value("filter", "NONE");
+		if (mode == "ATTRIBUTES") meshopt.mode = MESHOPT_ATTRIBUTES;
+		else if (mode == "TRIANGLES") meshopt.mode = MESHOPT_TRIANGLES;
+		else if (mode == "INDICES") meshopt.mode = MESHOPT_INDICES;
+		else throw std::invalid_argument("Unknown EXT_meshopt_compression mode: " + mode);
+		if (filter == "NONE") meshopt.filter = MESHOPT_FILTER_NONE;
+		else if (filter == "OCTAHEDRAL") meshopt.filter = MESHOPT_FILTER_OCTAHEDRAL;
+		else if (filter == "QUATERNION") meshopt.filter = MESHOPT_FILTER_QUATERNION;
+		else if (filter == "EXPONENTIAL") meshopt.filter = MESHOPT_FILTER_EXPONENTIAL;
+		else throw std::invalid_argument("Unknown EXT_meshopt_compression filter: " + filter);
+		meshoptViews.push_back(meshopt);
+	}
 
-	// If this node contains a mesh, load it and store its transformations
-	if (node.find("mesh") != node.end())
+	// A Draco primitive's attributes name the Draco attribute each accessor is decoded from
+	struct DracoPrimitive
 	{
-		translationsMeshes.push_back(translation);
-		rotationsMeshes.push_back(rotation);
-		scalesMeshes.push_back(scale);
-		matricesMeshes.push_back(matNextNode);
+		const unsigned char* source;
+		size_t size;
+		int indicesAccessor;
+		// The accessor of every attribute, its Draco attribute, and its component count
+		std::vector<unsigned int> accessors;
+		std::vector<int> attributeIDs;
+		std::vector<unsigned int> components;
+		// Decoded by the job, as floats per accessor and 32 bit indices
+		std::vector<std::vector<unsigned char>> attributes;
+		std::vector<unsigned char> indices;
+	};
+	std::vector<DracoPrimitive> dracoPrimitives;
+	json meshesJSON = JSON.value("meshes", json::array());
+	for (unsigned int m = 0; m < meshesJSON.size(); m++)
+	{
+		json primitives = meshesJSON[m].value("primitives", json::array());
+		for (unsigned int p = 0; p < primitives.size(); p++)
+		{
+			json& primitive = primitives[p];
+			if (primitive.find("extensions") == primitive.end() || primitive["extensions"].find("KHR_draco_mesh_compression") == primitive["extensions"].end())
+				continue;
+			json& compression = primitive["extensions"]["KHR_draco_mesh_compression"];
 
-		loadMesh(node["mesh"]);
+#ifdef MODEL_DRACO
+			DracoPrimitive draco;
+			json& bufferView = bufferViews[(unsigned int)compression["bufferView"]];
+			draco.size = bufferView["byteLength"];
+			draco.source = getBytes(compression["bufferView"], 0, draco.size);
+			draco.indicesAccessor = primitive.value("indices", -1);
+			for (auto& attribute : compression["attributes"].items())
+			{
+				unsigned int accessor = primitive["attributes"][attribute.key()];
+				std::string type = JSON["accessors"][accessor]["type"];
+				draco.accessors.push_back(accessor);
+				draco.attributeIDs.push_back(attribute.value());
+				draco.components.push_back(type == "SCALAR" ? 1 : type == "VEC2" ? 2 : type == "VEC3" ? 3 : 4);
+			}
+			dracoPrimitives.push_back(draco);
+#else
+			// Without the decoder only a file that also ships the primitive uncompressed loads
+			bool fallback = primitive.find("indices") == primitive.end() || JSON["accessors"][(unsigned int)primitive["indices"]].find("bufferView") != JSON["accessors"][(unsigned int)primitive["indices"]].end();
+			for (auto& attribute : compression["attributes"].items())
+			{
+				json& accessor = JSON["accessors"][(unsigned int)primitive["attributes"][attribute.key()]];
+				fallback = fallback && accessor.find("bufferView") != accessor.end();
+			}
+			if (!fallback)
+				throw std::invalid_argument("KHR_draco_mesh_compression needs a build with MODEL_DRACO and the Draco library: " + std::string(file));
+#endif
+		}
 	}
+	if (meshoptViews.empty() && dracoPrimitives.empty())
+		return;
 
-	// If the node has children, recursively traverse them
-	if (node.find("children") != node.end())
+	// Allocate the meshopt outputs before the jobs write to them
+	std::vector<unsigned char*> meshoptOutputs;
+	for (unsigned int i = 0; i < meshoptViews.size(); i++)
 	{
-		for (unsigned int i = 0; i < node["children"].size(); i++)
-			traverseNode(node["children"][i], matNextNode);
+		decodedBuffers.push_back(std::vector<unsigned char>(meshoptViews[i].count * meshoptViews[i].stride));
+		meshoptOutputs.push_back(decodedBuffers.back().data());
+		decodedViews[meshoptViews[i].view] = { decodedBuffers.back().data(), decodedBuffers.back().size() };
+	}
+
+	// One job per bufferView and per Draco primitive. Exceptions can't leave a job, so
+	// each one leaves its error for this thread to throw.
+	std::vector<std::string> errors(meshoptViews.size() + dracoPrimitives.size());
+	parallelFor((unsigned int)errors.size(), [&](unsigned int i)
+	{
+		if (i < meshoptViews.size())
+		{
+			MeshoptView& meshopt = meshoptViews[i];
+			if (!decode_meshopt(meshoptOutputs[i], meshopt.count, meshopt.stride, meshopt.source, meshopt.size, meshopt.mode, meshopt.filter))
+				errors[i] = "Failed to decode EXT_meshopt_compression bufferView " + std::to_string(meshopt.view);
+			return;
+		}
+
+#ifdef MODEL_DRACO
+		DracoPrimitive& draco = dracoPrimitives[i - meshoptViews.size()];
+		draco::DecoderBuffer buffer;
+		buffer.Init((const char*)draco.source, draco.size);
+		draco::Decoder decoder;
+		auto decoded = decoder.DecodeMeshFromBuffer(&buffer);
+		if (!decoded.ok())
+		{
+			errors[i] = "Failed to decode KHR_draco_mesh_compression: " + decoded.status().error_msg_string();
+			return;
+		}
+		std::unique_ptr<draco::Mesh> mesh = std::move(decoded).value();
+
+		// Attributes are dequantized to floats for every point, in point order
+		for (unsigned int a = 0; a < draco.attributeIDs.size(); a++)
+		{
+			const draco::PointAttribute* attribute = mesh->GetAttributeByUniqueId(draco.attributeIDs[a]);
+			if (attribute == NULL)
+			{
+				errors[i] = "KHR_draco_mesh_compression attribute " + std::to_string(draco.attributeIDs[a]) + " is missing";
+				return;
+			}
+			unsigned int components = draco.components[a];
+			std::vector<unsigned char> floats(mesh->num_points() * components * sizeof(float));
+			float* out = (float*)floats.data();
+			for (draco::PointIndex point(0); point < mesh->num_points(); ++point)
+				attribute->ConvertValue<float>(attribute->mapped_index(point), (int8_t)components, out + point.value() * components);
+			draco.attributes.push_back(std::move(floats));
+		}
+
+		draco.indices.resize(mesh->num_faces() * 3 * sizeof(GLuint));
+		GLuint* indices = (GLuint*)draco.indices.data();
+		for (draco::FaceIndex face(0); face < mesh->num_faces(); ++face)
+		{
+			for (unsigned int corner = 0; corner < 3; corner++)
+				indices[face.value() * 3 + corner] = mesh->face(face)[corner].value();
+		}
+#endif
+	});
+	for (unsigned int i = 0; i < errors.size(); i++)
+	{
+		if (!errors[i].empty())
+			throw std::invalid_argument(errors[i] + " in " + std::string(file));
+	}
+
+	// Point the Draco accessors at bufferViews of their decoded data
+	auto addView = [&](std::vector<unsigned char>& bytes, unsigned int accessor, unsigned int componentType)
+	{
+		decodedBuffers.push_back(std::move(bytes));
+		decodedViews.push_back({ decodedBuffers.back().data(), decodedBuffers.back().size() });
+		bufferViews.push_back({ { "buffer", 0 }, { "byteLength", decodedBuffers.back().size() } });
+		json& accessorJSON = JSON["accessors"][accessor];
+		accessorJSON["bufferView"] = bufferViews.size() - 1;
+		accessorJSON["byteOffset"] = 0;
+		accessorJSON["componentType"] = componentType;
+		accessorJSON["normalized"] = false;
+	};
+	for (unsigned int i = 0; i < dracoPrimitives.size(); i++)
+	{
+		DracoPrimitive& draco = dracoPrimitives[i];
+		for (unsigned int a = 0; a < draco.attributes.size(); a++)
+			addView(draco.attributes[a], draco.accessors[a], 5126);
+		if (draco.indicesAccessor >= 0)
+			addView(draco.indices, (unsigned int)draco.indicesAccessor, 5125);
 	}
 }
 
-std::vector<unsigned char> Model::getData()
+const unsigned char* Model::getBytes(unsigned int bufferViewIndex, size_t offset, size_t length)
 {
-	// Get the URI of the binary file associated with the model
-	std::string bytesText;
-	std::string uri = JSON["buffers"][0]["uri"];
+	// Decompressed bufferViews start at their own first byte
+	if (bufferViewIndex < decodedViews.size() && decodedViews[bufferViewIndex].bytes != NULL)
+	{
+		if (offset + length > decodedViews[bufferViewIndex].size)
+			throw std::invalid_argument("Accessor reads past the end of bufferView " + std::to_string(bufferViewIndex));
+		return decodedViews[bufferViewIndex].bytes + offset;
+	}
+
+	json& bufferView = JSON["bufferViews"][bufferViewIndex];
+	unsigned int buffer = bufferView.value("buffer", 0);
+	size_t start = bufferView.value("byteOffset", (size_t)0) + offset;
+	if (buffer >= buffers.size() || start + length > buffers[buffer].size)
+		throw std::invalid_argument("Accessor reads past the end of buffer " + std::to_string(buffer));
+	return buffers[buffer].bytes + start;
+}
 
-	// Build the full file path to the binary file
+LayerImage Model::getImage(json& image)
+{
 	std::string fileStr = std::string(file);
 	std::string fileDirectory = fileStr.substr(0, fileStr.find_last_of('/') + 1);
-	bytesText = get_file_contents((fileDirectory + uri).c_str());
 
-	// Convert the raw text data into a vector of bytes
-	std::vector<unsigned char> data(bytesText.begin(), bytesText.end());
-	return data;
+	// Embedded images get a name to report errors with, and keep their bytes once the
+	// buffers are gone
+	LayerImage layerImage;
+	if (image.find("bufferView") != image.end())
+	{
+		unsigned int bufferView = image["bufferView"];
+		size_t length = JSON["bufferViews"][bufferView]["byteLength"];
+		const unsigned char* bytes = getBytes(bufferView, 0, length);
+		layerImage.file = fileStr + "#bufferView" + std::to_string((unsigned int)image["bufferView"]);
+		layerImage.encoded = std::make_shared<const std::vector<unsigned char>>(bytes, bytes + length);
+		return layerImage;
+	}
+
+	std::string uri = image["uri"];
+	if (uri.compare(0, 5, "data:") == 0)
+	{
+		size_t start = uri.find(";base64,");
+		std::shared_ptr<std::vector<unsigned char>> encoded = std::make_shared<std::vector<unsigned char>>();
+		if (start == std::string::npos || !decode_base64(uri.c_str() + start + 8, uri.size() - start - 8, *encoded))
+			throw std::invalid_argument("Failed to decode the data URI of an image in " + fileStr);
+		layerImage.file = fileStr + "#" + uri.substr(0, std::min(start, (size_t)32));
+		layerImage.encoded = encoded;
+		return layerImage;
+	}
+	layerImage.file = fileDirectory + uri;
+	return layerImage;
 }
 
 std::vector<float> Model::getFloats(json accessor)
 {
-	std::vector<float> floatVec;
-
 	// Get the bufferView index and properties from the accessor
 	unsigned int buffViewInd = accessor.value("bufferView", 1);
 	unsigned int count = accessor["count"];
 	unsigned int accByteOffset = accessor.value("byteOffset", 0);
 	std::string type = accessor["type"];
 
-	// Get the bufferView object and its byte offset
-	json bufferView = JSON["bufferViews"][buffViewInd];
-	unsigned int byteOffset = bufferView["byteOffset"];
+	// Most accessors hold floats, but skin joints are integers and weights may be
+	// normalized integers, which map 0 to 0 and the type's maximum to 1
+	unsigned int componentType = accessor.value("componentType", 5126);
+	bool normalized = accessor.value("normalized", false);
 
 	// Determine how many floats per vertex based on type
 	unsigned int numPerVert;
@@ -166,19 +1265,101 @@ std::vector<float> Model::getFloats(json accessor)
 	else if (type == "VEC2") numPerVert = 2;
 	else if (type == "VEC3") numPerVert = 3;
 	else if (type == "VEC4") numPerVert = 4;
-	else throw std::invalid_argument("Type is invalid (not SCALAR, VEC2, VEC3, or VEC4)");
+	else if (type == "MAT4") numPerVert = 16;
+	else throw std::invalid_argument("Type is invalid (not SCALAR, VEC2, VEC3, VEC4, or MAT4)");
+
+	// Sparse accessors without a bufferView start out as zeros, morph targets often do
+	bool sparse = accessor.find("sparse") != accessor.end();
+	std::vector<float> floatVec;
+	if (sparse && accessor.find("bufferView") == accessor.end())
+		floatVec.assign(count * numPerVert, 0.0f);
+	else
+		floatVec = readFloats(buffViewInd, accByteOffset, count, numPerVert, componentType, normalized);
+	if (!sparse)
+		return floatVec;
+
+	// Then the sparse elements replace the ones at their indices.
+	// The indices and values are tightly packed in bufferViews of their own.
+	json sparseJSON = accessor["sparse"];
+	json indicesJSON = sparseJSON["indices"];
+	json valuesJSON = sparseJSON["values"];
+	unsigned int sparseCount = sparseJSON["count"];
+	json indexAccessor =
+	{
+		{ "bufferView", indicesJSON["bufferView"] },
+		{ "byteOffset", indicesJSON.value("byteOffset", 0) },
+		{ "componentType", indicesJSON["componentType"] },
+		{ "count", sparseCount },
+	};
+	std::vector<GLuint> sparseIndices = getIndices(indexAccessor);
+	std::vector<float> sparseValues = readFloats(valuesJSON["bufferView"], valuesJSON.value("byteOffset", 0), sparseCount, numPerVert, componentType, normalized);
+	for (unsigned int i = 0; i < sparseIndices.size() && i < sparseCount; i++)
+	{
+		if (sparseIndices[i] >= count)
+			continue;
+		for (unsigned int j = 0; j < numPerVert; j++)
+			floatVec[sparseIndices[i] * numPerVert + j] = sparseValues[i * numPerVert + j];
+	}
+
+	return floatVec;
+}
+
+std::vector<float> Model::readFloats
+(
+	unsigned int buffViewInd,
+	unsigned int accByteOffset,
+	unsigned int count,
+	unsigned int numPerVert,
+	unsigned int componentType,
+	bool normalized
+)
+{
+	std::vector<float> floatVec;
+
+	// Get the bufferView object
+	json& bufferView = JSON["bufferViews"][buffViewInd];
 
-	// Calculate where in the binary data the float values start and end
-	unsigned int beginningOfData = byteOffset + accByteOffset;
-	unsigned int lengthOfData = count * 4 * numPerVert;
+	// Bytes per component, and per element unless the bufferView interleaves them with other data
+	unsigned int componentSize = 4;
+	if (componentType == 5120 || componentType == 5121) componentSize = 1;
+	else if (componentType == 5122 || componentType == 5123) componentSize = 2;
+	unsigned int stride = bufferView.value("byteStride", componentSize * numPerVert);
 
-	// Convert bytes into floats and store them in floatVec
-	for (unsigned int i = beginningOfData; i < beginningOfData + lengthOfData; i += 4)
+	// Convert every component into a float and store it in floatVec
+	size_t length = count > 0 ? (size_t)(count - 1) * stride + numPerVert * componentSize : 0;
+	const unsigned char* data = getBytes(buffViewInd, accByteOffset, length);
+	for (unsigned int i = 0; i < count; i++)
 	{
-		unsigned char bytes[] = { data[i], data[i + 1], data[i + 2], data[i + 3] };
-		float value;
-		std::memcpy(&value, bytes, sizeof(float));
-		floatVec.push_back(value);
+		for (unsigned int j = 0; j < numPerVert; j++)
+		{
+			const unsigned char* bytes = &data[i * stride + j * componentSize];
+			float value;
+			if (componentType == 5121)
+				value = normalized ? bytes[0] / 255.0f : (float)bytes[0];
+			else if (componentType == 5120)
+				value = normalized ? std::max((signed char)bytes[0] / 127.0f, -1.0f) : (float)(signed char)bytes[0];
+			else if (componentType == 5123)
+			{
+				unsigned short component;
+				std::memcpy(&component, bytes, sizeof(unsigned short));
+				value = normalized ? component / 65535.0f : (float)component;
+			}
+			else if (componentType == 5122)
+			{
+				short component;
+				std::memcpy(&component, bytes, sizeof(short));
+				value = normalized ? std::max(component / 32767.0f, -1.0f) : (float)component;
+			}
+			else if (componentType == 5125)
+			{
+				unsigned int component;
+				std::memcpy(&component, bytes, sizeof(unsigned int));
+				value = (float)component;
+			}
+			else
+				std::memcpy(&value, bytes, sizeof(float));
+			floatVec.push_back(value);
+		}
 	}
 
 	return floatVec;
@@ -194,14 +1375,12 @@ std::vector<GLuint> Model::getIndices(json accessor)
 	unsigned int accByteOffset = accessor.value("byteOffset", 0);
 	unsigned int componentType = accessor["componentType"];
 
-	json bufferView = JSON["bufferViews"][buffViewInd];
-	unsigned int byteOffset = bufferView["byteOffset"];
-
 	// Extract index data depending on component type
-	unsigned int beginningOfData = byteOffset + accByteOffset;
+	unsigned int componentSize = componentType == 5125 ? 4 : (componentType == 5121 ? 1 : 2);
+	const unsigned char* data = getBytes(buffViewInd, accByteOffset, (size_t)count * componentSize);
 	if (componentType == 5125)
 	{
-		for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 4; i += 4)
+		for (unsigned int i = 0; i < count * 4; i += 4)
 		{
 			unsigned char bytes[] = { data[i], data[i + 1], data[i + 2], data[i + 3] };
 			unsigned int value;
@@ -211,7 +1390,7 @@ std::vector<GLuint> Model::getIndices(json accessor)
 	}
 	else if (componentType == 5123)
 	{
-		for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 2; i += 2)
+		for (unsigned int i = 0; i < count * 2; i += 2)
 		{
 			unsigned char bytes[] = { data[i], data[i + 1] };
 			unsigned short value;
@@ -221,7 +1400,7 @@ std::vector<GLuint> Model::getIndices(json accessor)
 	}
 	else if (componentType == 5122)
 	{
-		for (unsigned int i = beginningOfData; i < byteOffset + accByteOffset + count * 2; i += 2)
+		for (unsigned int i = 0; i < count * 2; i += 2)
 		{
 			unsigned char bytes[] = { data[i], data[i + 1] };
 			short value;
@@ -229,57 +1408,231 @@ std::vector<GLuint> Model::getIndices(json accessor)
 			indices.push_back((GLuint)value);
 		}
 	}
+	else if (componentType == 5121)
+	{
+		for (unsigned int i = 0; i < count; i++)
+			indices.push_back((GLuint)data[i]);
+	}
 
 	return indices;
 }
 
-std::vector<Texture> Model::getTextures()
+void Model::loadMaterials()
 {
-	std::vector<Texture> textures;
+	unsigned int numImages = JSON.find("images") != JSON.end() ? (unsigned int)JSON["images"].size() : 0;
 
-	// Determine the directory path for texture files
-	std::string fileStr = std::string(file);
-	std::string fileDirectory = fileStr.substr(0, fileStr.find_last_of('/') + 1);
+	// Which texture array and layer each image ends up in
+	std::vector<unsigned int> imageArray(numImages);
+	std::vector<GLint> imageLayer(numImages);
+
+	// Size and layer count of every texture array, array 0 is the 1x1 white fallback
+	std::vector<glm::ivec2> arraySizes = { glm::ivec2(1, 1) };
+	std::vector<GLuint> arrayLayers = { 1 };
 
-	// Loop through all images listed in the JSON
-	for (unsigned int i = 0; i < JSON["images"].size(); i++)
+	// Read the size of every image without decoding it and group the images by size
+	std::vector<LayerImage> images;
+	for (unsigned int i = 0; i < numImages; i++)
 	{
-		// Get the texture file path
-		std::string texPath = JSON["images"][i]["uri"];
+		images.push_back(getImage(JSON["images"][i]));
+		int widthImg, heightImg, numColCh;
+		if (!images[i].Info(widthImg, heightImg, numColCh))
+			throw std::invalid_argument("Failed to read image: " + images[i].file);
 
-		// Check if this texture has already been loaded
-		bool skip = false;
-		for (unsigned int j = 0; j < loadedTexName.size(); j++)
+		unsigned int arr = 0;
+		while (arr < arraySizes.size() && arraySizes[arr] != glm::ivec2(widthImg, heightImg))
+			arr++;
+		if (arr == arraySizes.size())
 		{
-			if (loadedTexName[j] == texPath)
+			arraySizes.push_back(glm::ivec2(widthImg, heightImg));
+			arrayLayers.push_back(0);
+		}
+
+		imageArray[i] = arr;
+		imageLayer[i] = arrayLayers[arr]++;
+	}
+
+	// The image of every layer, uploadMaterials fills or streams the arrays from them
+	pending.arraySizes = arraySizes;
+	pending.layerImages.resize(arraySizes.size());
+	for (unsigned int i = 0; i < arraySizes.size(); i++)
+		pending.layerImages[i].resize(arrayLayers[i]);
+	for (unsigned int i = 0; i < numImages; i++)
+		pending.layerImages[imageArray[i]][imageLayer[i]] = std::move(images[i]);
+
+	// Looks up the texture array and layer a glTF texture reference points to
+	auto findLayer = [&](json& textureInfo, GLuint& arrayID, GLint& layer)
+	{
+		unsigned int texInd = textureInfo["index"];
+		unsigned int imgInd = JSON["textures"][texInd]["source"];
+		arrayID = imageArray[imgInd];
+		layer = imageLayer[imgInd];
+	};
+
+	// Build one material per glTF material, plus the default material at the end
+	unsigned int numMaterials = JSON.find("materials") != JSON.end() ? (unsigned int)JSON["materials"].size() : 0;
+	if (numMaterials + 1 > MAX_MATERIALS)
+		throw std::invalid_argument("Model has more materials than the material table can hold");
+
+	for (unsigned int i = 0; i <= numMaterials; i++)
+	{
+		// Every texture starts out as array 0, the white fallback
+		Material material = { i, 0, 0, 0, 0, 0, 0 };
+		MaterialData row = { 0, 0, 0.5f, 0, 1.0f, { 0.0f, 0.0f, 0.0f } };
+		PBRMaterialData pbrRow = { { 1.0f, 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f, 1.0f, 1.0f, -1, -1 };
+
+		// Diffuse comes from the base color texture and specular from the metallic roughness texture.
+		// The PBR variants also read the factors, which default to 1 like glTF says.
+		if (i < numMaterials && JSON["materials"][i].find("pbrMetallicRoughness") != JSON["materials"][i].end())
+		{
+			json& pbr = JSON["materials"][i]["pbrMetallicRoughness"];
+			if (pbr.find("baseColorTexture") != pbr.end())
+				findLayer(pbr["baseColorTexture"], material.diffuseArray, row.diffuseLayer);
+			if (pbr.find("metallicRoughnessTexture") != pbr.end())
+				findLayer(pbr["metallicRoughnessTexture"], material.specularArray, row.specularLayer);
+			if (pbr.find("baseColorFactor") != pbr.end())
 			{
-				textures.push_back(loadedTex[j]);
-				skip = true;
-				break;
+				for (unsigned int c = 0; c < 4; c++)
+					pbrRow.baseColorFactor[c] = pbr["baseColorFactor"][c];
 			}
+			pbrRow.metallicFactor = pbr.value("metallicFactor", 1.0f);
+			pbrRow.roughnessFactor = pbr.value("roughnessFactor", 1.0f);
 		}
 
-		// If not already loaded, load it now
-		if (!skip)
+		// Occlusion only darkens the light from the environment, emission is added on top of all light
+		if (i < numMaterials)
 		{
-			if (texPath.find("baseColor") != std::string::npos)
+			json& materialJSON = JSON["materials"][i];
+			if (materialJSON.find("occlusionTexture") != materialJSON.end())
+			{
+				findLayer(materialJSON["occlusionTexture"], material.occlusionArray, pbrRow.occlusionLayer);
+				pbrRow.occlusionStrength = materialJSON["occlusionTexture"].value("strength", 1.0f);
+			}
+			if (materialJSON.find("emissiveTexture") != materialJSON.end())
+				findLayer(materialJSON["emissiveTexture"], material.emissiveArray, pbrRow.emissiveLayer);
+			float emissiveStrength = 1.0f;
+			if (materialJSON.find("extensions") != materialJSON.end() && materialJSON["extensions"].find("KHR_materials_emissive_strength") != materialJSON["extensions"].end())
+				emissiveStrength = materialJSON["extensions"]["KHR_materials_emissive_strength"].value("emissiveStrength", 1.0f);
+			if (materialJSON.find("emissiveFactor") != materialJSON.end())
 			{
-				Texture diffuse = Texture((fileDirectory + texPath).c_str(), "diffuse", loadedTex.size());
-				textures.push_back(diffuse);
-				loadedTex.push_back(diffuse);
-				loadedTexName.push_back(texPath);
+				for (unsigned int c = 0; c < 3; c++)
+					pbrRow.emissiveFactor[c] = (float)materialJSON["emissiveFactor"][c] * emissiveStrength;
 			}
-			else if (texPath.find("metallicRoughness") != std::string::npos)
+		}
+
+		// Normal mapped materials get the variant that reads tangents and bends the normal
+		if (i < numMaterials && JSON["materials"][i].find("normalTexture") != JSON["materials"][i].end())
+		{
+			json& normalTexture = JSON["materials"][i]["normalTexture"];
+			findLayer(normalTexture, material.normalArray, row.normalLayer);
+			row.normalScale = normalTexture.value("scale", 1.0f);
+			material.features |= SHADER_NORMAL_MAP;
+		}
+
+		// Masked materials get the alpha test variant, everything else skips the test
+		if (i < numMaterials && JSON["materials"][i].value("alphaMode", std::string("OPAQUE")) == "MASK")
+		{
+			material.features |= SHADER_ALPHA_TEST;
+			row.alphaCutoff = JSON["materials"][i].value("alphaCutoff", 0.5f);
+		}
+
+		materials.push_back(material);
+		pending.materialRows.push_back(row);
+		pending.pbrMaterialRows.push_back(pbrRow);
+	}
+}
+
+void Model::uploadMaterials()
+{
+	// Allocate one texture array per image size, streamed arrays start out without any levels
+	std::vector<glm::ivec2>& arraySizes = pending.arraySizes;
+	std::vector<std::vector<LayerImage>>& layerImages = pending.layerImages;
+	for (unsigned int i = 0; i < arraySizes.size(); i++)
+		textureArrays.push_back(TextureArray(arraySizes[i].x, arraySizes[i].y, (GLuint)layerImages[i].size(), streamer != NULL && i > 0));
+
+	// Fill the fallback layer with white so untextured materials keep their lighting
+	unsigned char white[] = { 255, 255, 255, 255 };
+	textureArrays[0].SetLayer(0, white, 4);
+	textureArrays[0].GenerateMipmaps();
+
+	if (streamer != NULL)
+	{
+		// Hand the image arrays to the streamer, which decodes them on its worker threads
+		for (unsigned int i = 1; i < textureArrays.size(); i++)
+			streamer->Register(textureArrays[i], layerImages[i]);
+	}
+	else
+	{
+		// Decode every image and copy it into its layer
+		stbi_set_flip_vertically_on_load(true);
+		for (unsigned int i = 1; i < textureArrays.size(); i++)
+		{
+			for (unsigned int layer = 0; layer < layerImages[i].size(); layer++)
 			{
-				Texture specular = Texture((fileDirectory + texPath).c_str(), "specular", loadedTex.size());
-				textures.push_back(specular);
-				loadedTex.push_back(specular);
-				loadedTexName.push_back(texPath);
+				int widthImg, heightImg, numColCh;
+				unsigned char* bytes = layerImages[i][layer].Load(widthImg, heightImg, numColCh, 0);
+				if (bytes == NULL)
+					throw std::invalid_argument("Failed to load image: " + layerImages[i][layer].file);
+				textureArrays[i].SetLayer(layer, bytes, numColCh);
+				stbi_image_free(bytes);
 			}
+			textureArrays[i].GenerateMipmaps();
 		}
 	}
 
-	return textures;
+	// The materials point at their arrays by index until now
+	for (unsigned int i = 0; i < materials.size(); i++)
+	{
+		Material& material = materials[i];
+		material.diffuseArray = textureArrays[material.diffuseArray].ID;
+		material.specularArray = textureArrays[material.specularArray].ID;
+		material.normalArray = textureArrays[material.normalArray].ID;
+		material.occlusionArray = textureArrays[material.occlusionArray].ID;
+		material.emissiveArray = textureArrays[material.emissiveArray].ID;
+	}
+
+	// Upload the material rows, the buffer is sized for the whole uniform block
+	std::vector<MaterialData>& rows = pending.materialRows;
+	std::vector<PBRMaterialData>& pbrRows = pending.pbrMaterialRows;
+	materialUBO = GPUHandle::Create(GPU_BUFFER, VRAM_UNIFORMS, MAX_MATERIALS * sizeof(MaterialData));
+	glBindBuffer(GL_UNIFORM_BUFFER, materialUBO.ID);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(MaterialData), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, rows.size() * sizeof(MaterialData), rows.data());
+	pbrMaterialUBO = GPUHandle::Create(GPU_BUFFER, VRAM_UNIFORMS, MAX_MATERIALS * sizeof(PBRMaterialData));
+	glBindBuffer(GL_UNIFORM_BUFFER, pbrMaterialUBO.ID);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_MATERIALS * sizeof(PBRMaterialData), NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, pbrRows.size() * sizeof(PBRMaterialData), pbrRows.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Model::requestTextureLevels(Camera& camera)
+{
+	float tanHalfFOV = std::tan(glm::radians(camera.FOVdeg) * 0.5f);
+	glm::vec4 planes[6];
+	frustum_planes(camera.cameraMatrix, planes);
+
+	for (unsigned int i = 0; i < meshes.size(); i++)
+	{
+		// Place the mesh's bounding sphere in the world. Meshes out of view request nothing,
+		// so their arrays keep what they have until the streamer lets them fall back to the tail.
+		glm::vec3 worldCenter;
+		float worldRadius;
+		worldBounds(i, worldCenter, worldRadius);
+		if (!sphere_in_frustum(planes, worldCenter, worldRadius))
+			continue;
+
+		// Diameter of the sphere on screen in pixels, the whole screen if the camera is inside it
+		float distance = glm::length(worldCenter - camera.Position);
+		float pixels = (float)camera.height;
+		if (distance > worldRadius)
+			pixels = std::min(pixels, worldRadius / (distance * tanHalfFOV) * camera.height);
+
+		streamer->Request(meshes[i].material.diffuseArray, pixels);
+		streamer->Request(meshes[i].material.specularArray, pixels);
+		if (meshes[i].material.features & SHADER_NORMAL_MAP)
+			streamer->Request(meshes[i].material.normalArray, pixels);
+		streamer->Request(meshes[i].material.occlusionArray, pixels);
+		streamer->Request(meshes[i].material.emissiveArray, pixels);
+	}
 }
 
 std::vector<Vertex> Model::assembleVertices
@@ -299,7 +1652,8 @@ std::vector<Vertex> Model::assembleVertices
 				positions[i],
 				normals[i],
 				glm::vec3(1.0f, 1.0f, 1.0f),
-				texUVs[i]
+				texUVs[i],
+				glm::vec4(0.0f)
 			}
 		);
 	}
@@ -5,27 +5,112 @@
 
 // Includes required libraries for model loading and data parsing.
 #include<json/json.h>
+#include<algorithm>
 #include"Mesh.h"
+#include"TextureStreamer.h"
+#include"ShaderVariants.h"
+#include"SceneGraph.h"
+#include"Animation.h"
+#include"Skin.h"
+#include"Tangents.h"
+#include"AssetCache.h"
+#include"MappedFile.h"
+#include"Meshopt.h"
 
 // Create a shorthand alias so we can write "json" instead of "nlohmann::json".
 using json = nlohmann::json;
 
 
+// Which meshes a draw includes. Alpha tested meshes can't be drawn by depth only
+// passes that don't read textures, so passes such as the depth pre-pass leave them out.
+enum DrawFilter
+{
+	DRAW_ALL,
+	DRAW_OPAQUE,
+	DRAW_ALPHA_TESTED,
+};
+
+
 // The Model class is responsible for loading and managing 3D models.
 // It stores all meshes, textures, and transformation data, and handles
 // the process of traversing model nodes and preparing them for rendering.
 class Model
 {
 public:
-	// Constructor that loads a model from a file.
-	// The model data is stored in 'data', 'JSON', and 'file',
-	// and is then processed into meshes and transformations.
-	Model(const char* file);
+	// Constructor that loads a model from a .gltf or .glb file.
+	// The file is mapped into memory, and the JSON and the buffers are read in place
+	// ('JSON', 'buffers', and 'file') and then processed into meshes and transformations.
+	// Buffers may also be separate files, which are mapped too, or base64 data URIs.
+	// Geometry compressed with EXT_meshopt_compression is decoded on jobs, and so is
+	// KHR_draco_mesh_compression when built with MODEL_DRACO and the Draco library.
+	// Without it, Draco files load from their uncompressed fallback if they have one.
+	// With a streamer the textures start out at a low resolution and are refined
+	// in the background, otherwise every image is decoded before the constructor returns.
+	// jobs is kept as the model's job system, and used right away to generate tangents.
+	// geometry is what the meshes keep on the CPU once their buffers are uploaded.
+	// With deferUpload the constructor only reads the file and builds the meshes' vertices,
+	// without touching OpenGL, so it can run on a worker thread. Upload then puts the
+	// model on the GPU, and nothing is drawn until it has finished.
+	Model(const char* file, TextureStreamer* streamer = NULL, JobSystem* jobs = NULL, MeshGeometry geometry = MESH_GEOMETRY_RELEASE, bool deferUpload = false);
+
+	// Every buffer, vertex array, and texture of the model is deleted with it, once the
+	// GPU is done with the frames that drew it. Its arrays leave the streamer too.
+	~Model();
+
+	// Creates the texture arrays, material tables, meshes, and skins a deferred constructor
+	// prepared, spending budgetBytes of uploads and taking what was used off it. At least
+	// one mesh is uploaded per call while there is budget left, so every model finishes.
+	// Returns true once the model is ready to draw. Must run on the thread with the context.
+	bool Upload(GLsizeiptr& budgetBytes);
+
+	// Returns true once everything is uploaded.
+	bool Ready();
 
 	// Draws the entire model to the screen using a given shader and camera.
 	// Internally calls the Draw() function of each mesh in the model.
 	void Draw(Shader& shader, Camera& camera);
 
+	// Draws the model picking a shader variant per mesh. Every mesh uses the variant
+	// compiled with the given scene features (such as the light types) plus the
+	// features its own material needs (such as alpha testing).
+	// filter can limit the draw to opaque or to alpha tested meshes.
+	void Draw(ShaderVariants& variants, unsigned int features, Camera& camera, DrawFilter filter = DRAW_ALL);
+
+	// Draws only the depth of the meshes whose bounds reach into the volume seen by
+	// viewProjection, such as a shadow cascade, nearest first. The meshes are drawn with
+	// their position only VAOs, and the variants are built from the depth shaders.
+	// Of features only SHADER_PBR is used, so masked meshes cut out what Draw does.
+	// Returns how many meshes were drawn.
+	unsigned int DrawDepth(ShaderVariants& variants, unsigned int features, const glm::mat4& viewProjection, DrawFilter filter = DRAW_ALL);
+
+	// Moves the nodes to where an animation has them after 'seconds', looping it.
+	// The draws pick the new pose up, including the skins it moves.
+	void Animate(unsigned int animation, float seconds);
+
+	// The model's node hierarchy. Moving a node with its Set functions moves every mesh
+	// below it, the draws pick the change up on their own.
+	SceneGraph nodes;
+
+	// The glTF animations of the model, in file order.
+	std::vector<Animation> animations;
+
+	// Job system the animations, transforms, and skins are updated on, NULL to update
+	// them on the calling thread.
+	JobSystem* jobs = NULL;
+
+	// Skins every skinned mesh on the CPU instead of in the vertex shader, for example
+	// on a headless software renderer where vertex work is slow. Skins with more joints
+	// than MAX_SKIN_JOINTS are always skinned on the CPU.
+	bool cpuSkinning = false;
+
+	// Ring the skin palettes and the vertices skinned or morphed on the CPU are streamed
+	// through every frame, NULL to write them over their buffers directly.
+	StreamBuffer* stream = NULL;
+
+	// Blends morph targets on the CPU instead of in the vertex shader. Meshes with more
+	// targets than MAX_MORPH_TARGETS, or skinned on the CPU, are always morphed on the CPU.
+	bool cpuMorphing = false;
+
 private:
 	// -------------------------------
 	// Model Data Storage
@@ -34,8 +119,61 @@ private:
 	// Stores the file path of the model.
 	const char* file;
 
-	// Stores the raw binary data read from the model file.
-	std::vector<unsigned char> data;
+	// The bytes of one glTF buffer, inside a mapped file or a decoded data URI
+	struct BufferData
+	{
+		const unsigned char* bytes;
+		size_t size;
+	};
+
+	// Every buffer of the model, and the mapped files and decoded data URIs they point into.
+	// Only needed while loading, they are freed once the constructor is done with them.
+	std::vector<BufferData> buffers;
+	std::vector<MappedFile> mappedFiles;
+	std::vector<std::vector<unsigned char>> decodedBuffers;
+
+	// The decompressed bytes of every bufferView, in decodedBuffers. NULL for bufferViews
+	// that are read from their buffer in place.
+	std::vector<BufferData> decodedViews;
+
+	// What the meshes keep of their geometry after uploading it
+	MeshGeometry geometry;
+
+	// A mesh read by the constructor, waiting for Upload
+	struct PendingMesh
+	{
+		std::vector<Vertex> vertices;
+		std::vector<GLuint> indices;
+		unsigned int material;
+		std::vector<SkinVertex> skin;
+		std::vector<MorphTarget> targets;
+	};
+
+	// The joints and inverse bind matrices of a skin, waiting for Upload
+	struct PendingSkin
+	{
+		std::vector<unsigned int> joints;
+		std::vector<glm::mat4> inverseBindMatrices;
+	};
+
+	// Everything the constructor read for Upload to put on the GPU, freed once it's there
+	struct PendingUpload
+	{
+		// Size of every texture array and the image of each of its layers
+		std::vector<glm::ivec2> arraySizes;
+		std::vector<std::vector<LayerImage>> layerImages;
+		// Rows of the material tables
+		std::vector<MaterialData> materialRows;
+		std::vector<PBRMaterialData> pbrMaterialRows;
+		std::vector<PendingMesh> meshes;
+		std::vector<PendingSkin> skins;
+		// How many of the meshes are uploaded so far
+		unsigned int uploadedMeshes = 0;
+	};
+	PendingUpload pending;
+
+	// Whether Upload has finished
+	bool ready = false;
 
 	// Stores the parsed JSON structure that describes the model layout.
 	json JSON;
@@ -47,43 +185,167 @@ private:
 	// A list of all meshes that make up the model.
 	std::vector<Mesh> meshes;
 
-	// Lists that store transformation data for each mesh.
-	// These define where and how each mesh is positioned, rotated, and scaled.
-	std::vector<glm::vec3> translationsMeshes;
-	std::vector<glm::quat> rotationsMeshes;
-	std::vector<glm::vec3> scalesMeshes;
-	std::vector<glm::mat4> matricesMeshes;
+	// The scene graph node that places each mesh in the world.
+	std::vector<unsigned int> meshNodes;
+
+	// The scene graph index of each glTF node, -1 for nodes outside the scene.
+	std::vector<int> graphNodes;
+
+	// Skins of the model, and the skin of every mesh, -1 if it has none.
+	std::vector<Skin> skins;
+	std::vector<int> meshSkins;
+
+	// Bounding sphere (center and radius) of every skinned mesh in its current pose,
+	// in the space the joints place it in.
+	std::vector<glm::vec4> skinnedBounds;
+
+	// Whether the skinned meshes were skinned on the CPU the last time the skins were updated.
+	bool skinnedOnCPU = false;
+
+	// Whether the morphed meshes were morphed on the CPU the last time they were updated.
+	bool morphedOnCPU = false;
+
+	// How many times the weights of each mesh's node had been set when the mesh was last
+	// morphed, and whether the current update morphs it again
+	std::vector<unsigned int> meshWeightChanges;
+	std::vector<unsigned char> meshReweighted;
+
+	// The order meshes are drawn in, sorted so meshes sharing texture arrays are drawn back to back.
+	std::vector<unsigned int> drawOrder;
 
 	// -------------------------------
-	// Texture Management
+	// Material Management
 	// -------------------------------
 
-	// Used to prevent the same texture from being loaded more than once.
-	std::vector<std::string> loadedTexName;
-	std::vector<Texture> loadedTex;
+	// Texture arrays holding every image of the model, one array per image size.
+	// Array 0 always holds a single 1x1 white layer used when a material has no texture.
+	std::vector<TextureArray> textureArrays;
+
+	// One material per glTF material, plus a default material at the end
+	// for primitives that don't reference one.
+	std::vector<Material> materials;
+
+	// Uniform buffer holding the layer indices and alpha cutoff of every material.
+	GPUHandle materialUBO;
+	// Uniform buffer holding the PBR factors and the occlusion and emissive layers of every material.
+	GPUHandle pbrMaterialUBO;
+
+	// Streamer the texture arrays are registered with, NULL if they were loaded in full.
+	TextureStreamer* streamer;
+
+	// Where generated tangents are baked, so they are only generated the first time a model loads.
+	AssetCache assetCache;
 
 	// -------------------------------
 	// Model Loading Functions
 	// -------------------------------
 
-	// Loads a single mesh from the model based on its index in the file.
+	// Reads a single mesh from the model based on its index in the file, for Upload.
 	void loadMesh(unsigned int indMesh);
 
-	// Traverses a node recursively, visiting all connected nodes in the scene graph.
+	// Fills in the tangents of a normal mapped mesh without a TANGENT attribute,
+	// from the asset cache or by generating and baking them.
+	void loadTangents(std::vector<Vertex>& vertices, std::vector<GLuint>& indices);
+
+	// Groups every image into texture arrays by size and builds the materials and the
+	// rows of the material tables. Until the arrays exist the materials hold the index
+	// of their arrays in textureArrays, uploadMaterials swaps in the IDs.
+	void loadMaterials();
+
+	// Creates the texture arrays, fills or registers them, and uploads the material tables.
+	void uploadMaterials();
+
+	// Tells the streamer how large every mesh appears on screen,
+	// so the texture arrays it uses get refined in order of visibility.
+	void requestTextureLevels(Camera& camera);
+
+	// Activates a shader and points its samplers and Materials block at this model's materials.
+	void bindMaterials(Shader& shader);
+
+	// Finds the sphere around a mesh where default.vert places it in the world.
+	void worldBounds(unsigned int mesh, glm::vec3& center, float& radius);
+
+	// Returns true if filter includes the mesh.
+	bool passesFilter(unsigned int mesh, DrawFilter filter);
+
+	// Returns true if the mesh is skinned by the SKINNING shader variants.
+	bool gpuSkinned(unsigned int mesh);
+
+	// Returns true if the mesh's morph targets are blended by the MORPHING shader variants.
+	bool gpuMorphed(unsigned int mesh);
+
+	// Returns SHADER_SKINNING and SHADER_MORPHING for the mesh if the shaders animate it.
+	unsigned int animationFeatures(unsigned int mesh);
+
+	// Returns the ShaderFeature bits the mesh needs on top of the scene's.
+	unsigned int meshFeatures(unsigned int mesh);
+
+	// Returns the model matrix a mesh is drawn with, identity for skinned meshes
+	// since their joints already place them.
+	const glm::mat4& meshMatrix(unsigned int mesh);
+
+	// Brings the world matrices up to date and, if any node moved, the skins with them.
+	// Meshes whose node's morph weights changed are morphed again.
+	void updateNodes();
+
+	// Calls function for every index below count, spread over the job system if there is one.
+	void parallelFor(unsigned int count, const std::function<void(unsigned int)>& function);
+
+	// Depth and index of every mesh the last DrawDepth drew, kept to avoid reallocating
+	std::vector<std::pair<float, unsigned int>> depthOrder;
+
+	// Flattens the nodes of the default scene into the scene graph, parents first,
+	// and loads the mesh of every node that has one.
 	// This allows complex models made of multiple linked parts to be fully loaded.
-	void traverseNode(unsigned int nextNode, glm::mat4 matrix = glm::mat4(1.0f));
+	void loadNodes();
+
+	// Reads the skins and animations, after the nodes they refer to are in the scene graph.
+	void loadSkins();
+	void loadAnimations();
 
 	// -------------------------------
 	// Data Extraction Helpers
 	// -------------------------------
 
-	// Reads the binary model data from the file and returns it as a byte array.
-	std::vector<unsigned char> getData();
+	// Finds the JSON and binary chunks of a .glb file inside its bytes. Returns false if the
+	// bytes aren't a .glb file, they are then the JSON of a .gltf file.
+	static bool findGLBChunks(const unsigned char* bytes, size_t size, BufferData& jsonChunk, BufferData& binChunk);
 
-	// Converts JSON accessors into arrays of floats, indices, or textures.
+	// Finds the bytes of every buffer the JSON lists: the binary chunk of a .glb file,
+	// a file next to the model, or a base64 data URI.
+	void loadBuffers(BufferData binChunk);
+
+	// Decodes every bufferView compressed with EXT_meshopt_compression, and the accessors of
+	// every primitive compressed with KHR_draco_mesh_compression, in parallel on the jobs.
+	// Draco accessors are pointed at new bufferViews that hold their decoded data as floats
+	// and 32 bit indices, so getFloats and getIndices read every accessor the same way.
+	void decompress();
+
+	// Returns the bytes at offset in a bufferView, after checking that length bytes from
+	// there lie inside the bufferView's buffer, or inside its decompressed bytes.
+	const unsigned char* getBytes(unsigned int bufferView, size_t offset, size_t length);
+
+	// Returns the image of a glTF image: its file, its data URI decoded, or a copy of its
+	// bufferView, which doesn't outlive the constructor.
+	LayerImage getImage(json& image);
+
+	// Converts JSON accessors into arrays of floats or indices.
+	// getFloats also reads normalized and integer components, such as skin joints and weights,
+	// and applies sparse accessors, which only store the elements that differ from their
+	// bufferView, or from zero if they have none.
 	std::vector<float> getFloats(json accessor);
 	std::vector<GLuint> getIndices(json accessor);
-	std::vector<Texture> getTextures();
+
+	// Reads count elements of numPerVert components from a bufferView and converts them to floats.
+	std::vector<float> readFloats
+	(
+		unsigned int buffViewInd,
+		unsigned int accByteOffset,
+		unsigned int count,
+		unsigned int numPerVert,
+		unsigned int componentType,
+		bool normalized
+	);
 
 	// -------------------------------
 	// Vertex Assembly
@@ -0,0 +1,185 @@
+#include"Morph.h"
+
+#include<iostream>
+#include<algorithm>
+
+// SSE is always there on x86 and x64. Other targets blend with glm.
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+#include<xmmintrin.h>
+#define MORPH_SSE
+#endif
+
+MorphTargets::MorphTargets()
+{
+}
+
+MorphTargets::MorphTargets(std::vector<MorphTarget>&& loaded, unsigned int vertexCount)
+{
+	targets = std::move(loaded);
+	if (targets.empty())
+		return;
+	if (targets.size() > MAX_MORPH_TARGETS)
+	{
+		std::cout << "MORPH_TARGETS_ERROR: " << targets.size() << " targets don't fit in morphWeights (" << MAX_MORPH_TARGETS << "), morphing on the CPU" << std::endl;
+		return;
+	}
+
+	// Count the deltas of every vertex, then give each vertex its own run of them
+	std::vector<GLuint> ranges(vertexCount * 2, 0);
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		for (unsigned int k = 0; k < targets[t].vertices.size(); k++)
+			ranges[targets[t].vertices[k] * 2 + 1]++;
+	}
+	GLuint total = 0;
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		ranges[i * 2] = total;
+		total += ranges[i * 2 + 1];
+	}
+
+	std::vector<glm::vec4> deltas(std::max(total, (GLuint)1) * 2, glm::vec4(0.0f));
+	std::vector<GLuint> filled(vertexCount, 0);
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		for (unsigned int k = 0; k < targets[t].vertices.size(); k++)
+		{
+			unsigned int vertex = targets[t].vertices[k];
+			GLuint slot = ranges[vertex * 2] + filled[vertex]++;
+			deltas[slot * 2] = glm::vec4(glm::vec3(targets[t].positions[k]), (float)t);
+			deltas[slot * 2 + 1] = targets[t].normals[k];
+		}
+	}
+
+	// Buffer textures set up like the light cluster lists
+	GLsizeiptr rangesSize = std::max(ranges.size() * sizeof(GLuint), (size_t)16);
+	rangesBuffer = GPUHandle::Create(GPU_BUFFER, VRAM_VERTICES, rangesSize);
+	glBindBuffer(GL_TEXTURE_BUFFER, rangesBuffer.ID);
+	glBufferData(GL_TEXTURE_BUFFER, rangesSize, ranges.empty() ? NULL : ranges.data(), GL_STATIC_DRAW);
+	deltasBuffer = GPUHandle::Create(GPU_BUFFER, VRAM_VERTICES, deltas.size() * sizeof(glm::vec4));
+	glBindBuffer(GL_TEXTURE_BUFFER, deltasBuffer.ID);
+	glBufferData(GL_TEXTURE_BUFFER, deltas.size() * sizeof(glm::vec4), deltas.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	// The textures only view the buffers, so they add no memory of their own
+	rangesTexture = GPUHandle::Create(GPU_TEXTURE, VRAM_VERTICES);
+	glBindTexture(GL_TEXTURE_BUFFER, rangesTexture.ID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, rangesBuffer.ID);
+	deltasTexture = GPUHandle::Create(GPU_TEXTURE, VRAM_VERTICES);
+	glBindTexture(GL_TEXTURE_BUFFER, deltasTexture.ID);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, deltasBuffer.ID);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+bool MorphTargets::GPU()
+{
+	return deltasTexture.ID != 0;
+}
+
+void MorphTargets::Bind(Shader& shader, const std::vector<float>& weights)
+{
+	glActiveTexture(GL_TEXTURE0 + MORPH_RANGES_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, rangesTexture.ID);
+	glActiveTexture(GL_TEXTURE0 + MORPH_DELTAS_UNIT);
+	glBindTexture(GL_TEXTURE_BUFFER, deltasTexture.ID);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(shader.Uniform("morphRanges"), MORPH_RANGES_UNIT);
+	glUniform1i(shader.Uniform("morphDeltas"), MORPH_DELTAS_UNIT);
+	GLsizei count = (GLsizei)std::min(weights.size(), targets.size());
+	if (count > 0)
+		glUniform1fv(shader.Uniform("morphWeights"), count, weights.data());
+}
+
+void MorphTargets::Apply
+(
+	const std::vector<float>& weights,
+	const std::vector<Vertex>& base,
+	std::vector<Vertex>& out,
+	unsigned int& first,
+	unsigned int& end
+)
+{
+	first = end = 0;
+	if (appliedWeights.size() != targets.size())
+		appliedWeights.assign(targets.size(), 0.0f);
+	if (touched.size() != base.size())
+	{
+		touched.assign(base.size(), 0);
+		positionSums.resize(base.size());
+		normalSums.resize(base.size());
+	}
+
+	// Missing weights count as 0, like targets the node has no weight for
+	std::vector<float> current(targets.size(), 0.0f);
+	for (unsigned int t = 0; t < targets.size() && t < weights.size(); t++)
+		current[t] = weights[t];
+
+	// Only the vertices of targets whose weight changed can end up somewhere else
+	touchedVertices.clear();
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		if (current[t] == appliedWeights[t])
+			continue;
+		const std::vector<unsigned int>& vertices = targets[t].vertices;
+		for (unsigned int k = 0; k < vertices.size(); k++)
+		{
+			if (!touched[vertices[k]])
+			{
+				touched[vertices[k]] = 1;
+				touchedVertices.push_back(vertices[k]);
+			}
+		}
+	}
+	appliedWeights = current;
+	if (touchedVertices.empty())
+		return;
+
+	// Blend the touched vertices again from the base, so the sums never drift
+	for (unsigned int i = 0; i < touchedVertices.size(); i++)
+	{
+		unsigned int vertex = touchedVertices[i];
+		positionSums[vertex] = glm::vec4(base[vertex].position, 0.0f);
+		normalSums[vertex] = glm::vec4(base[vertex].normal, 0.0f);
+	}
+	for (unsigned int t = 0; t < targets.size(); t++)
+	{
+		if (current[t] == 0.0f)
+			continue;
+		const MorphTarget& target = targets[t];
+#ifdef MORPH_SSE
+		__m128 weight = _mm_set1_ps(current[t]);
+#endif
+		for (unsigned int k = 0; k < target.vertices.size(); k++)
+		{
+			unsigned int vertex = target.vertices[k];
+			if (!touched[vertex])
+				continue;
+#ifdef MORPH_SSE
+			float* position = &positionSums[vertex].x;
+			float* normal = &normalSums[vertex].x;
+			_mm_storeu_ps(position, _mm_add_ps(_mm_loadu_ps(position), _mm_mul_ps(weight, _mm_loadu_ps(&target.positions[k].x))));
+			_mm_storeu_ps(normal, _mm_add_ps(_mm_loadu_ps(normal), _mm_mul_ps(weight, _mm_loadu_ps(&target.normals[k].x))));
+#else
+			positionSums[vertex] += current[t] * target.positions[k];
+			normalSums[vertex] += current[t] * target.normals[k];
+#endif
+		}
+	}
+
+	first = (unsigned int)out.size();
+	for (unsigned int i = 0; i < touchedVertices.size(); i++)
+	{
+		unsigned int vertex = touchedVertices[i];
+		out[vertex].position = glm::vec3(positionSums[vertex]);
+		out[vertex].normal = glm::vec3(normalSums[vertex]);
+		touched[vertex] = 0;
+		first = std::min(first, vertex);
+		end = std::max(end, vertex + 1);
+	}
+}
+
+void MorphTargets::Reset()
+{
+	appliedWeights.clear();
+}
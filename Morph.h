@@ -0,0 +1,92 @@
+// If MORPH_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef MORPH_CLASS_H
+#define MORPH_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+
+#include"VBO.h"
+#include"shaderClass.h"
+#include"GPUResources.h"
+
+
+// The most targets a mesh can have and still be morphed by the vertex shader.
+// Must match MAX_MORPH_TARGETS in default.vert and depth.vert.
+const unsigned int MAX_MORPH_TARGETS = 64;
+
+// Texture units of the two buffer textures the MORPHING shaders read the deltas from
+const GLuint MORPH_RANGES_UNIT = 10;
+const GLuint MORPH_DELTAS_UNIT = 11;
+
+
+// One glTF morph target (blend shape), holding only the vertices it actually moves.
+// Most targets move a small part of the mesh, a face's mouth or eyelids, so the deltas
+// of every other vertex, all zero, are dropped when the target is loaded.
+struct MorphTarget
+{
+	// Index of every vertex the target moves, in increasing order
+	std::vector<unsigned int> vertices;
+	// How far the target moves each of those vertices at weight 1, padded with a 0 for SSE
+	std::vector<glm::vec4> positions;
+	std::vector<glm::vec4> normals;
+};
+
+// MorphTargets holds the morph targets of a mesh and blends them by their weights,
+// either in the vertex shader or on the CPU.
+// For the shaders the deltas are grouped by vertex into two buffer textures: one with
+// where each vertex's deltas start and how many it has, and one with the deltas, so a
+// vertex only loops over the targets that move it. Only the weights change per frame.
+// On the CPU, Apply only touches the vertices moved by targets whose weight changed.
+class MorphTargets
+{
+public:
+	std::vector<MorphTarget> targets;
+
+	// A mesh without morph targets
+	MorphTargets();
+
+	// Takes the targets over, then groups the deltas by vertex and uploads them for the
+	// vertex shader if the targets fit.
+	MorphTargets(std::vector<MorphTarget>&& targets, unsigned int vertexCount);
+
+	// Returns true if the vertex shader can blend these targets.
+	bool GPU();
+
+	// Binds the delta textures to their units and sends the weights for the next draws.
+	void Bind(Shader& shader, const std::vector<float>& weights);
+
+	// Blends the targets into out on the CPU, starting from the unmorphed base vertices.
+	// out must start as a copy of base. Only vertices moved by a target whose weight
+	// changed since the last Apply are written, first and end are set to the range
+	// of them (equal if nothing changed). Doesn't touch OpenGL.
+	void Apply
+	(
+		const std::vector<float>& weights,
+		const std::vector<Vertex>& base,
+		std::vector<Vertex>& out,
+		unsigned int& first,
+		unsigned int& end
+	);
+
+	// Forgets the weights of the last Apply, so the next one starts from scratch.
+	void Reset();
+
+private:
+	// Deleted with the mesh
+	GPUHandle rangesBuffer;
+	GPUHandle rangesTexture;
+	GPUHandle deltasBuffer;
+	GPUHandle deltasTexture;
+
+	// Weights the CPU vertices were last blended with
+	std::vector<float> appliedWeights;
+	// Sums of the weighted deltas, and which vertices the current Apply recomputes
+	std::vector<glm::vec4> positionSums;
+	std::vector<glm::vec4> normalSums;
+	std::vector<unsigned char> touched;
+	std::vector<unsigned int> touchedVertices;
+};
+
+#endif
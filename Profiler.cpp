@@ -0,0 +1,258 @@
+#include"Profiler.h"
+
+#include<fstream>
+#include<sstream>
+#include<iomanip>
+#include<json/json.h>
+
+Profiler* Profiler::active = NULL;
+
+Profiler::Profiler()
+{
+	// Sample both clocks together so GPU times can be placed on the CPU timeline
+	glGetInteger64v(GL_TIMESTAMP, &gpuEpoch);
+	cpuEpoch = std::chrono::high_resolution_clock::now();
+}
+
+void Profiler::BeginFrame()
+{
+	// This set was last used PROFILER_FRAMES frames ago, so its results are almost surely ready
+	current = (unsigned int)(frameCount % PROFILER_FRAMES);
+	FrameSet& set = sets[current];
+	if (set.pending)
+		resolve(set);
+
+	set.records.clear();
+	set.queriesUsed = 0;
+	set.frame = frameCount;
+	open.clear();
+	inFrame = true;
+	Begin("Frame");
+}
+
+void Profiler::EndFrame()
+{
+	if (!inFrame)
+		return;
+	// Close anything left open, including the frame itself
+	while (!open.empty())
+		End();
+	inFrame = false;
+	sets[current].pending = true;
+	frameCount++;
+}
+
+void Profiler::Begin(const char* name)
+{
+	if (!inFrame)
+		return;
+	FrameSet& set = sets[current];
+	Record record;
+	record.name = name;
+	record.depth = (unsigned int)open.size();
+	record.startQuery = nextQuery();
+	record.endQuery = nextQuery();
+	glQueryCounter(record.startQuery, GL_TIMESTAMP);
+	record.cpuStart = cpuNow();
+	record.cpuEnd = record.cpuStart;
+	open.push_back((unsigned int)set.records.size());
+	set.records.push_back(record);
+}
+
+void Profiler::End()
+{
+	if (!inFrame || open.empty())
+		return;
+	Record& record = sets[current].records[open.back()];
+	open.pop_back();
+	record.cpuEnd = cpuNow();
+	glQueryCounter(record.endQuery, GL_TIMESTAMP);
+}
+
+std::string Profiler::TreeText()
+{
+	// Build the tree, merging repeated scopes under one parent into a single node
+	struct Node
+	{
+		const char* name;
+		unsigned int calls;
+		double cpuMs;
+		double gpuMs;
+		std::vector<unsigned int> children;
+	};
+	std::vector<Node> nodes(1);
+	nodes[0].name = "";
+	// The node of each depth along the path to the current scope, the root at the front
+	std::vector<unsigned int> path(1, 0);
+	for (unsigned int i = 0; i < latest.size(); i++)
+	{
+		const ProfileResult& result = latest[i];
+		path.resize(result.depth + 1);
+		unsigned int parent = path.back();
+
+		unsigned int found = 0;
+		for (unsigned int j = 0; j < nodes[parent].children.size() && found == 0; j++)
+		{
+			if (std::string(nodes[nodes[parent].children[j]].name) == result.name)
+				found = nodes[parent].children[j];
+		}
+		if (found == 0)
+		{
+			found = (unsigned int)nodes.size();
+			nodes[parent].children.push_back(found);
+			Node node{};
+			node.name = result.name;
+			nodes.push_back(node);
+		}
+		nodes[found].calls++;
+		nodes[found].cpuMs += result.cpuMs;
+		nodes[found].gpuMs += result.gpuMs;
+		path.push_back(found);
+	}
+
+	std::ostringstream text;
+	text << std::fixed << std::setprecision(2);
+	text << std::left << std::setw(32) << "Scope" << std::right << std::setw(10) << "CPU ms" << std::setw(10) << "GPU ms" << "\n";
+
+	// Walk the tree depth first, children in the order they first ran
+	std::vector<std::pair<unsigned int, unsigned int>> stack;
+	for (unsigned int i = (unsigned int)nodes[0].children.size(); i > 0; i--)
+		stack.push_back(std::make_pair(nodes[0].children[i - 1], 0u));
+	while (!stack.empty())
+	{
+		unsigned int index = stack.back().first;
+		unsigned int depth = stack.back().second;
+		stack.pop_back();
+		const Node& node = nodes[index];
+
+		std::string label = std::string(depth * 2, ' ') + node.name;
+		if (node.calls > 1)
+			label += " x" + std::to_string(node.calls);
+		text << std::left << std::setw(32) << label << std::right << std::setw(10) << node.cpuMs << std::setw(10) << node.gpuMs << "\n";
+
+		for (unsigned int i = (unsigned int)node.children.size(); i > 0; i--)
+			stack.push_back(std::make_pair(node.children[i - 1], depth + 1));
+	}
+	return text.str();
+}
+
+bool Profiler::WriteTrace(const char* file)
+{
+	// Pick up the frames still in flight
+	for (unsigned int i = 1; i <= PROFILER_FRAMES; i++)
+	{
+		FrameSet& set = sets[(current + i) % PROFILER_FRAMES];
+		if (set.pending)
+			resolve(set);
+	}
+
+	// Complete events ("X") with times in microseconds, one thread for the CPU and one for the GPU
+	nlohmann::json events = nlohmann::json::array();
+	const char* threads[2] = { "CPU", "GPU" };
+	for (unsigned int t = 0; t < 2; t++)
+	{
+		nlohmann::json name;
+		name["ph"] = "M";
+		name["name"] = "thread_name";
+		name["pid"] = 1;
+		name["tid"] = t + 1;
+		name["args"]["name"] = threads[t];
+		events.push_back(name);
+	}
+	for (unsigned int i = 0; i < traced.size(); i++)
+	{
+		const ProfileResult& result = traced[i];
+		for (unsigned int t = 0; t < 2; t++)
+		{
+			nlohmann::json event;
+			event["ph"] = "X";
+			event["name"] = result.name;
+			event["pid"] = 1;
+			event["tid"] = t + 1;
+			event["ts"] = (t == 0 ? result.cpuStart : result.gpuStart) * 1000.0;
+			event["dur"] = (t == 0 ? result.cpuMs : result.gpuMs) * 1000.0;
+			event["args"]["frame"] = result.frame;
+			events.push_back(event);
+		}
+	}
+
+	std::ofstream out(file);
+	if (!out)
+		return false;
+	nlohmann::json trace;
+	trace["traceEvents"] = events;
+	trace["displayTimeUnit"] = "ms";
+	out << trace.dump() << std::endl;
+	return true;
+}
+
+void Profiler::Delete()
+{
+	if (active == this)
+		active = NULL;
+	for (unsigned int i = 0; i < PROFILER_FRAMES; i++)
+	{
+		if (!sets[i].queries.empty())
+			glDeleteQueries((GLsizei)sets[i].queries.size(), sets[i].queries.data());
+		sets[i].queries.clear();
+		sets[i].pending = false;
+	}
+}
+
+double Profiler::cpuNow()
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cpuEpoch).count();
+}
+
+GLuint Profiler::nextQuery()
+{
+	FrameSet& set = sets[current];
+	if (set.queriesUsed == set.queries.size())
+	{
+		// Grow in batches so detailed frames don't create queries one at a time
+		size_t previous = set.queries.size();
+		set.queries.resize(previous + 64);
+		glGenQueries(64, set.queries.data() + previous);
+	}
+	return set.queries[set.queriesUsed++];
+}
+
+void Profiler::resolve(FrameSet& set)
+{
+	latest.clear();
+	for (unsigned int i = 0; i < set.records.size(); i++)
+	{
+		const Record& record = set.records[i];
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(record.startQuery, GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(record.endQuery, GL_QUERY_RESULT, &end);
+
+		ProfileResult result;
+		result.name = record.name;
+		result.depth = record.depth;
+		result.frame = set.frame;
+		result.cpuStart = record.cpuStart;
+		result.cpuMs = record.cpuEnd - record.cpuStart;
+		result.gpuStart = ((GLint64)start - gpuEpoch) / 1000000.0;
+		result.gpuMs = (end - start) / 1000000.0;
+		latest.push_back(result);
+	}
+	if (tracing)
+		traced.insert(traced.end(), latest.begin(), latest.end());
+	set.pending = false;
+}
+
+ProfileScope::ProfileScope(const char* name, bool detail)
+{
+	profiler = Profiler::active;
+	if (profiler != NULL && detail && !profiler->detailed)
+		profiler = NULL;
+	if (profiler != NULL)
+		profiler->Begin(name);
+}
+
+ProfileScope::~ProfileScope()
+{
+	if (profiler != NULL)
+		profiler->End();
+}
@@ -0,0 +1,127 @@
+// If PROFILER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef PROFILER_CLASS_H
+#define PROFILER_CLASS_H
+
+#include<glad/glad.h>
+#include<chrono>
+#include<string>
+#include<vector>
+
+
+// How many frames of queries are in flight. A frame's results are read when its
+// query set comes around again, by which time the GPU has long finished it.
+const unsigned int PROFILER_FRAMES = 3;
+
+
+// One timed scope of a finished frame. Times are in milliseconds since the profiler was created.
+struct ProfileResult
+{
+	const char* name;
+	unsigned int depth;
+	unsigned long long frame;
+	double cpuStart;
+	double cpuMs;
+	double gpuStart;
+	double gpuMs;
+};
+
+
+// The Profiler times named, nested scopes on both the CPU and the GPU.
+// Every scope records a GL_TIMESTAMP query when it opens and when it closes, so scopes
+// can nest freely, which GL_TIME_ELAPSED queries can't. Each frame uses its own set of
+// queries and is read back PROFILER_FRAMES frames later, so timing never stalls the GPU.
+// Scopes are opened with ProfileScope objects placed in the code, which cost nothing
+// while no profiler is active.
+class Profiler
+{
+public:
+	// The profiler ProfileScopes record into, or NULL to turn profiling off.
+	static Profiler* active;
+
+	// Whether per mesh scopes are recorded as well. They show which meshes are expensive,
+	// but add two queries per draw.
+	bool detailed = false;
+
+	// Whether every finished frame is kept for WriteTrace, not just the latest one.
+	bool tracing = false;
+
+	// Creates the first query sets and syncs the CPU and GPU clocks.
+	Profiler();
+
+	// Starts and ends a frame. Scopes only record between the two.
+	void BeginFrame();
+	void EndFrame();
+
+	// Opens and closes a scope, ProfileScope calls these.
+	void Begin(const char* name);
+	void End();
+
+	// Returns the newest finished frame as an indented tree with the CPU and GPU time of
+	// each scope. Scopes with the same name under the same parent are added together.
+	std::string TreeText();
+
+	// Writes every traced frame in the Chrome trace event format, for chrome://tracing or
+	// Perfetto. CPU and GPU scopes are shown as two threads on the same timeline.
+	// Returns false if the file can't be written.
+	bool WriteTrace(const char* file);
+
+	// Deletes the queries.
+	void Delete();
+
+private:
+	// A scope of a frame whose queries haven't been read yet
+	struct Record
+	{
+		const char* name;
+		unsigned int depth;
+		double cpuStart;
+		double cpuEnd;
+		GLuint startQuery;
+		GLuint endQuery;
+	};
+	struct FrameSet
+	{
+		std::vector<Record> records;
+		std::vector<GLuint> queries;
+		unsigned int queriesUsed = 0;
+		unsigned long long frame = 0;
+		bool pending = false;
+	};
+	FrameSet sets[PROFILER_FRAMES];
+	unsigned int current = 0;
+	bool inFrame = false;
+	unsigned long long frameCount = 0;
+	// Records of the current frame that are still open, innermost last
+	std::vector<unsigned int> open;
+
+	// Where the CPU and GPU clocks were when the profiler was created
+	std::chrono::high_resolution_clock::time_point cpuEpoch;
+	GLint64 gpuEpoch = 0;
+
+	std::vector<ProfileResult> latest;
+	std::vector<ProfileResult> traced;
+
+	// Milliseconds since cpuEpoch
+	double cpuNow();
+	// Takes an unused query from the current set, making more if needed
+	GLuint nextQuery();
+	// Reads the queries of a set into results, waiting for them if needed
+	void resolve(FrameSet& set);
+};
+
+
+// Times the code from its construction to the end of the enclosing block.
+//   ProfileScope scope("Shadows");
+// Scopes marked detailed are only recorded when the active profiler is detailed.
+class ProfileScope
+{
+public:
+	ProfileScope(const char* name, bool detail = false);
+	~ProfileScope();
+
+private:
+	Profiler* profiler;
+};
+
+#endif
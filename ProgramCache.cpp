@@ -0,0 +1,163 @@
+#include"ProgramCache.h"
+
+#include"GLProc.h"
+#include<filesystem>
+#include<fstream>
+#include<sstream>
+#include<chrono>
+#include<vector>
+#include<algorithm>
+#include<cstring>
+#include<cstdio>
+
+// Header written in front of every cached program binary.
+struct ProgramCacheHeader
+{
+	char magic[4];
+	GLenum format;
+	GLsizei length;
+	double compileMs;
+};
+
+ProgramCache::ProgramCache(const char* directory)
+{
+	ProgramCache::directory = directory;
+
+	// Binaries only load on the exact driver that wrote them, so the driver is part of every key
+	driver = std::string((const char*)glGetString(GL_VENDOR)) + "|" + (const char*)glGetString(GL_RENDERER) + "|" + (const char*)glGetString(GL_VERSION);
+
+	// Program binaries are core in OpenGL 4.1 and otherwise come from ARB_get_program_binary
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool available = major > 4 || (major == 4 && minor >= 1);
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions && !available; i++)
+		available = std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_get_program_binary") == 0;
+
+	if (available)
+	{
+		getProgramBinary = (PFNPROGRAMGETBINARYPROC)gl_proc_address("glGetProgramBinary");
+		programBinary = (PFNPROGRAMBINARYPROC)gl_proc_address("glProgramBinary");
+		programParameteri = (PFNPROGRAMPARAMETERIPROC)gl_proc_address("glProgramParameteri");
+	}
+
+	// Some drivers expose the functions but no binary formats, which makes the cache useless
+	GLint numFormats = 0;
+	if (getProgramBinary != NULL && programBinary != NULL && programParameteri != NULL)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numFormats);
+	supported = numFormats > 0;
+
+	if (supported)
+		std::filesystem::create_directories(ProgramCache::directory);
+}
+
+std::string ProgramCache::Key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines)
+{
+	// 64 bit FNV-1a hash over everything that changes the compiled program
+	unsigned long long hash = 14695981039346656037ULL;
+	const std::string* parts[] = { &vertexCode, &fragmentCode, &defines, &driver };
+	for (unsigned int i = 0; i < 4; i++)
+	{
+		for (unsigned int j = 0; j < parts[i]->size(); j++)
+		{
+			hash ^= (unsigned char)(*parts[i])[j];
+			hash *= 1099511628211ULL;
+		}
+		// Separate the parts so moving text from one into the next changes the hash
+		hash ^= 0xFF;
+		hash *= 1099511628211ULL;
+	}
+
+	char key[17];
+	std::snprintf(key, sizeof(key), "%016llx", hash);
+	return std::string(key);
+}
+
+GLuint ProgramCache::Load(const std::string& key)
+{
+	if (!supported)
+		return 0;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// No file means this program was never built on this driver
+	std::ifstream in(path(key), std::ios::binary);
+	ProgramCacheHeader header;
+	if (!in || !in.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, "GLPB", 4) != 0 || header.length <= 0)
+	{
+		misses++;
+		return 0;
+	}
+	std::vector<char> binary(header.length);
+	if (!in.read(binary.data(), header.length))
+	{
+		misses++;
+		return 0;
+	}
+	in.close();
+
+	// The driver may still reject the binary, for example after an update that kept the version string
+	GLuint program = glCreateProgram();
+	programBinary(program, header.format, binary.data(), header.length);
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked == GL_FALSE)
+	{
+		glDeleteProgram(program);
+		std::remove(path(key).c_str());
+		misses++;
+		return 0;
+	}
+
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	hits++;
+	msSaved += std::max(header.compileMs - loadMs, 0.0);
+	return program;
+}
+
+void ProgramCache::Store(const std::string& key, GLuint program, double compileMs)
+{
+	if (!supported)
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramCacheHeader header = { { 'G', 'L', 'P', 'B' }, 0, 0, compileMs };
+	std::vector<char> binary(length);
+	getProgramBinary(program, length, &header.length, &header.format, binary.data());
+
+	std::ofstream out(path(key), std::ios::binary);
+	out.write((char*)&header, sizeof(header));
+	out.write(binary.data(), header.length);
+}
+
+bool ProgramCache::Supported()
+{
+	return supported;
+}
+
+void ProgramCache::MarkRetrievable(GLuint program)
+{
+	if (supported)
+		programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+std::string ProgramCache::StatsLine()
+{
+	std::ostringstream line;
+	line.precision(1);
+	line << std::fixed << "Shader cache: " << hits << " hits, " << misses << " misses, " << msSaved << " ms saved";
+	if (!supported)
+		line << " (program binaries not supported by this driver)";
+	return line.str();
+}
+
+std::string ProgramCache::path(const std::string& key)
+{
+	return directory + "/" + key + ".bin";
+}
@@ -0,0 +1,72 @@
+// If PROGRAM_CACHE_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef PROGRAM_CACHE_CLASS_H
+#define PROGRAM_CACHE_CLASS_H
+
+#include<glad/glad.h>
+#include<string>
+
+
+// glad is generated for OpenGL 3.3, which doesn't include program binaries,
+// so the constants and function types of ARB_get_program_binary are declared here.
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+typedef void (APIENTRYP PFNPROGRAMGETBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+
+// The ProgramCache stores linked shader programs on disk with glGetProgramBinary
+// and loads them back with glProgramBinary, so shaders are only compiled the first
+// time the program runs. Entries are keyed by a hash of the shader sources, the
+// defines they were built with, and the driver's vendor, renderer, and version
+// strings. If the driver rejects a binary the entry is dropped and the caller
+// compiles from source as usual.
+class ProgramCache
+{
+public:
+	// Creates a cache that keeps its files in 'directory'.
+	// Must be constructed after the OpenGL context is current.
+	ProgramCache(const char* directory = "shader_cache");
+
+	// Builds the key identifying a program made from these sources and defines on this driver.
+	std::string Key(const std::string& vertexCode, const std::string& fragmentCode, const std::string& defines);
+
+	// Returns a linked program loaded from the cache, or 0 if there is no usable entry.
+	GLuint Load(const std::string& key);
+
+	// Saves a linked program under key. compileMs is how long building it from source took,
+	// so later hits can report how much time they saved.
+	void Store(const std::string& key, GLuint program, double compileMs);
+
+	// Returns true if the driver supports program binaries at all.
+	bool Supported();
+
+	// Asks the driver to keep the binary of a program around, must be called before linking it.
+	void MarkRetrievable(GLuint program);
+
+	// Returns a one line summary such as "Shader cache: 2 hits, 1 misses, 85.4 ms saved".
+	std::string StatsLine();
+
+	// Counters behind the stats line.
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	double msSaved = 0.0;
+
+private:
+	std::string directory;
+	std::string driver;
+	bool supported = false;
+
+	PFNPROGRAMGETBINARYPROC getProgramBinary = NULL;
+	PFNPROGRAMBINARYPROC programBinary = NULL;
+	PFNPROGRAMPARAMETERIPROC programParameteri = NULL;
+
+	// Returns the file an entry is stored in.
+	std::string path(const std::string& key);
+};
+
+#endif
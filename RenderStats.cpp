@@ -0,0 +1,21 @@
+#include"RenderStats.h"
+
+unsigned int RenderStats::drawCalls = 0;
+unsigned long long RenderStats::triangles = 0;
+unsigned int RenderStats::programBinds = 0;
+unsigned int RenderStats::vertexArrayBinds = 0;
+unsigned int RenderStats::textureBinds = 0;
+
+void RenderStats::Reset()
+{
+	drawCalls = 0;
+	triangles = 0;
+	programBinds = 0;
+	vertexArrayBinds = 0;
+	textureBinds = 0;
+}
+
+unsigned int RenderStats::StateChanges()
+{
+	return programBinds + vertexArrayBinds + textureBinds;
+}
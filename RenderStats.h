@@ -0,0 +1,31 @@
+// If RENDER_STATS_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef RENDER_STATS_CLASS_H
+#define RENDER_STATS_CLASS_H
+
+
+// RenderStats counts the work the renderer hands to OpenGL each frame.
+// The counters are bumped by the classes that make the calls (Mesh, Shader, VAO,
+// TextureArray), so they always match what was actually submitted.
+// Reset them at the start of a frame and read them at the end.
+class RenderStats
+{
+public:
+	// glDrawElements and glDrawArrays calls
+	static unsigned int drawCalls;
+	// Triangles passed to those calls, before any culling
+	static unsigned long long triangles;
+	// Bound shader programs, vertex arrays, and textures. Binds the texture array
+	// filter skipped aren't counted, since no call reached the driver.
+	static unsigned int programBinds;
+	static unsigned int vertexArrayBinds;
+	static unsigned int textureBinds;
+
+	// Sets every counter back to zero.
+	static void Reset();
+
+	// Returns the sum of all the bind counters.
+	static unsigned int StateChanges();
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include"Renderer.h"
+#include"RenderStats.h"
+#include"Profiler.h"
+
+// Feature bits that change lighting, the geometry pass ignores them
+const unsigned int LIGHTING_FEATURES = SHADER_DIRECTIONAL_LIGHT | SHADER_POINT_LIGHT | SHADER_SPOT_LIGHT | SHADER_CLUSTERED_LIGHTS | SHADER_SHADOWS;
+// Feature bits that change what a surface stores in the G-buffer, both passes need them
+const unsigned int SURFACE_FEATURES = SHADER_PBR;
+
+Renderer::Renderer(int width, int height, ShaderVariants& forwardVariants, ProgramCache* cache) :
+	geometryVariants("default.vert", "gbuffer.frag", cache),
+	lightingVariants("deferred.vert", "deferred.frag", cache, "lighting.glsl"),
+	forwardVariants(forwardVariants),
+	gbuffer(width, height),
+	depthVariants("depth.vert", "depth.frag", cache)
+{
+	glGenQueries(4, &queries[0][0]);
+}
+
+void Renderer::Draw(Model& model, Camera& camera, unsigned int features)
+{
+	Draw(std::vector<Model*>{ &model }, camera, features);
+}
+
+void Renderer::Draw(const std::vector<Model*>& models, Camera& camera, unsigned int features)
+{
+	if (mode == RENDER_FORWARD)
+	{
+		drawSurfaces(models, camera, forwardVariants, features);
+		return;
+	}
+
+	// Remember where the frame is supposed to end up
+	GLint target = 0;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// Geometry pass: write every visible surface into the G-buffer
+	// The targets are cleared one by one so the frame's clear color is left alone
+	{
+		ProfileScope profile("Geometry pass");
+		bool emissive = (features & SHADER_PBR) != 0;
+		gbuffer.Bind(emissive);
+		GLfloat clear[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (GLint i = 0; i < (emissive ? 4 : 3); i++)
+			glClearBufferfv(GL_COLOR, i, clear);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		drawSurfaces(models, camera, geometryVariants, features & ~LIGHTING_FEATURES);
+	}
+	ProfileScope profile("Lighting pass");
+
+	// Lighting pass: light each covered pixel once, on top of what the target was cleared to
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	gbuffer.BindTextures();
+
+	Shader& lighting = lightingVariants.Get(features & (LIGHTING_FEATURES | SURFACE_FEATURES));
+	lighting.Activate();
+	glUniform1i(lighting.Uniform("gAlbedo"), GBUFFER_FIRST_UNIT + 0);
+	glUniform1i(lighting.Uniform("gNormal"), GBUFFER_FIRST_UNIT + 1);
+	glUniform1i(lighting.Uniform("gMaterial"), GBUFFER_FIRST_UNIT + 2);
+	glUniform1i(lighting.Uniform("gDepth"), GBUFFER_FIRST_UNIT + 3);
+	glUniform1i(lighting.Uniform("gEmissive"), GBUFFER_EMISSIVE_UNIT);
+	glUniformMatrix4fv(lighting.Uniform("invCamMatrix"), 1, GL_FALSE, glm::value_ptr(glm::inverse(camera.cameraMatrix)));
+	glUniform3f(lighting.Uniform("camPos"), camera.Position.x, camera.Position.y, camera.Position.z);
+
+	// The triangle covers the screen at a single depth, so it must not be depth tested
+	glDisable(GL_DEPTH_TEST);
+	screenVAO.Bind();
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	RenderStats::drawCalls++;
+	RenderStats::triangles++;
+	screenVAO.Unbind();
+	glEnable(GL_DEPTH_TEST);
+}
+
+const char* Renderer::ModeName()
+{
+	return mode == RENDER_FORWARD ? "forward" : "deferred";
+}
+
+std::string Renderer::OverdrawLine()
+{
+	std::ostringstream line;
+	line.precision(2);
+	line << std::fixed << "Overdraw: " << (coveredPixels > 0 ? (double)shadedFragments / coveredPixels : 0.0) << "x ("
+		<< shadedFragments << " fragments shaded for " << coveredPixels << " pixels), depth pre-pass " << (depthPrepass ? "on" : "off");
+	return line.str();
+}
+
+void Renderer::drawSurfaces(const std::vector<Model*>& models, Camera& camera, ShaderVariants& variants, unsigned int features)
+{
+	// Pick up the counts from two frames ago and reuse their queries
+	unsigned int slot = queryFrame % 2;
+	if (queriesIssued[slot])
+	{
+		GLuint available = GL_FALSE;
+		glGetQueryObjectuiv(queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_TRUE)
+		{
+			glGetQueryObjectuiv(queries[slot][0], GL_QUERY_RESULT, &shadedFragments);
+			glGetQueryObjectuiv(queries[slot][1], GL_QUERY_RESULT, &coveredPixels);
+		}
+		queriesIssued[slot] = false;
+	}
+
+	// Lay down the depth of the opaque meshes without touching the color targets
+	if (depthPrepass)
+	{
+		ProfileScope profile("Depth pre-pass");
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		for (unsigned int i = 0; i < models.size(); i++)
+			models[i]->DrawDepth(depthVariants, features, camera.cameraMatrix, DRAW_OPAQUE);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+
+	if (countOverdraw)
+		glBeginQuery(GL_SAMPLES_PASSED, queries[slot][0]);
+	if (depthPrepass)
+	{
+		// Only the fragment matching the depth already stored for its pixel gets shaded.
+		// Alpha tested meshes weren't in the pre-pass, so they test and write depth as usual.
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+		for (unsigned int i = 0; i < models.size(); i++)
+			models[i]->Draw(variants, features, camera, DRAW_OPAQUE);
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+		for (unsigned int i = 0; i < models.size(); i++)
+			models[i]->Draw(variants, features, camera, DRAW_ALPHA_TESTED);
+	}
+	else
+	{
+		for (unsigned int i = 0; i < models.size(); i++)
+			models[i]->Draw(variants, features, camera);
+	}
+
+	if (countOverdraw)
+	{
+		glEndQuery(GL_SAMPLES_PASSED);
+
+		// Count the covered pixels by drawing the depth again, passing only where it
+		// matches the final depth, so each pixel's visible surface passes once
+		ProfileScope profile("Overdraw count");
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_FALSE);
+		glDepthFunc(GL_EQUAL);
+		glBeginQuery(GL_SAMPLES_PASSED, queries[slot][1]);
+		for (unsigned int i = 0; i < models.size(); i++)
+			models[i]->DrawDepth(depthVariants, features, camera.cameraMatrix);
+		glEndQuery(GL_SAMPLES_PASSED);
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+		queriesIssued[slot] = true;
+	}
+	queryFrame++;
+}
+
+void Renderer::Reload()
+{
+	geometryVariants.Reload();
+	lightingVariants.Reload();
+	depthVariants.Reload();
+}
+
+void Renderer::Update()
+{
+	geometryVariants.Update();
+	lightingVariants.Update();
+	depthVariants.Update();
+}
+
+void Renderer::Delete()
+{
+	geometryVariants.Delete();
+	lightingVariants.Delete();
+	gbuffer.Delete();
+	screenVAO.Delete();
+	depthVariants.Delete();
+	glDeleteQueries(4, &queries[0][0]);
+}
@@ -0,0 +1,92 @@
+// If RENDERER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef RENDERER_CLASS_H
+#define RENDERER_CLASS_H
+
+#include"Model.h"
+#include"GBuffer.h"
+#include"VAO.h"
+
+
+// The ways the Renderer can draw a frame.
+enum RenderMode
+{
+	// Every mesh is lit while it is drawn, with the forward shader variants.
+	RENDER_FORWARD = 0,
+	// Meshes only write their surfaces to a G-buffer, then one full screen pass
+	// lights every pixel once, no matter how many meshes overlap it.
+	RENDER_DEFERRED = 1,
+};
+
+// The Renderer draws a model with either the forward or the deferred path.
+// The mode can be changed between any two frames, so both can be compared on the same scene.
+// Both paths use the same lights: the feature bits passed to Draw pick the light types,
+// and the deferred lighting pass reads the same light clusters as the forward shaders.
+class Renderer
+{
+public:
+	// How the next frame is drawn
+	RenderMode mode = RENDER_FORWARD;
+
+	// Draws the depth of the opaque meshes first, nearest first, with the position only
+	// buffers. The shading pass then runs with GL_EQUAL and no depth writes, so every
+	// pixel is shaded once, by the surface that ends up visible.
+	bool depthPrepass = false;
+
+	// Counts the fragments the shading pass runs and the pixels the scene covers, to report
+	// overdraw. Costs one more depth only pass per frame, so it is off unless asked for.
+	bool countOverdraw = false;
+	// Counts from the latest frame whose results are back from the GPU
+	GLuint shadedFragments = 0;
+	GLuint coveredPixels = 0;
+
+	// Shader variants of the deferred geometry pass (default.vert and gbuffer.frag)
+	// and of its lighting pass (deferred.vert and deferred.frag).
+	// Set lightingVariants.onCreate to the same function as the forward variants,
+	// so the lighting pass gets the same light uniforms.
+	ShaderVariants geometryVariants;
+	ShaderVariants lightingVariants;
+
+	// Creates the G-buffer at the window's size. forwardVariants are the shaders the
+	// forward path draws with, and cache is where the new shaders are cached.
+	Renderer(int width, int height, ShaderVariants& forwardVariants, ProgramCache* cache = NULL);
+
+	// Draws the model into the framebuffer that is bound, lit with the given feature bits.
+	void Draw(Model& model, Camera& camera, unsigned int features);
+	// Draws several models into one frame, such as the regions a SceneStreamer has loaded.
+	// Every pass goes over all of them, so they share the depth pre-pass and the G-buffer.
+	void Draw(const std::vector<Model*>& models, Camera& camera, unsigned int features);
+
+	// Returns "forward" or "deferred".
+	const char* ModeName();
+
+	// Returns a line such as "Overdraw: 1.84x (117964 fragments shaded for 64000 pixels)".
+	std::string OverdrawLine();
+
+	// Reloads and advances the reloads of the deferred shaders, like ShaderVariants does.
+	void Reload();
+	void Update();
+
+	// Deletes the G-buffer and the deferred shaders.
+	void Delete();
+
+private:
+	ShaderVariants& forwardVariants;
+	GBuffer gbuffer;
+	// Empty vertex array for the full screen triangle, core profile can't draw without one
+	VAO screenVAO;
+	// Depth only shaders (depth.vert and depth.frag) for the pre-pass and overdraw count
+	ShaderVariants depthVariants;
+
+	// GL_SAMPLES_PASSED queries for the shaded fragments and covered pixels of two frames.
+	// A frame reads back the pair issued two frames earlier, which is done by then, so
+	// counting never makes the CPU wait on the GPU.
+	GLuint queries[2][2];
+	bool queriesIssued[2] = { false, false };
+	unsigned int queryFrame = 0;
+
+	// Draws the models' surfaces into the bound framebuffer, with the pre-pass if it is on
+	void drawSurfaces(const std::vector<Model*>& models, Camera& camera, ShaderVariants& variants, unsigned int features);
+};
+
+#endif
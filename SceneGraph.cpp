@@ -0,0 +1,158 @@
+#include"SceneGraph.h"
+
+#include<algorithm>
+
+// Graphs smaller than this are updated on the calling thread, splitting them up costs more than it saves
+const unsigned int SCENE_GRAPH_PARALLEL_NODES = 512;
+// Nodes per job when a level is updated in parallel
+const unsigned int SCENE_GRAPH_BATCH_NODES = 128;
+
+// SSE is always there on x86 and x64. Other targets use glm's multiplication.
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+#include<xmmintrin.h>
+#define SCENE_GRAPH_SSE
+#endif
+
+// out = a * b for column major matrices: each column of out mixes the columns of a
+// weighted by one column of b, four floats at a time
+void SceneGraph::Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out)
+{
+#ifdef SCENE_GRAPH_SSE
+	__m128 a0 = _mm_loadu_ps(&a[0][0]);
+	__m128 a1 = _mm_loadu_ps(&a[1][0]);
+	__m128 a2 = _mm_loadu_ps(&a[2][0]);
+	__m128 a3 = _mm_loadu_ps(&a[3][0]);
+	for (int j = 0; j < 4; j++)
+	{
+		__m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[j][0]));
+		column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[j][1])));
+		column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[j][2])));
+		column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[j][3])));
+		_mm_storeu_ps(&out[j][0], column);
+	}
+#else
+	out = a * b;
+#endif
+}
+
+unsigned int SceneGraph::Add(int parent, const glm::mat4& matrix, glm::vec3 translation, glm::quat rotation, glm::vec3 scale)
+{
+	parents.push_back(parent);
+	translations.push_back(translation);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	matrices.push_back(matrix);
+	hasMatrix.push_back(matrix != glm::mat4(1.0f));
+	worlds.push_back(glm::mat4(1.0f));
+	weights.push_back(std::vector<float>());
+	weightChanges.push_back(0);
+	dirty.push_back(1);
+	anyDirty = true;
+
+	unsigned int depth = parent >= 0 ? depths[parent] + 1 : 0;
+	depths.push_back(depth);
+	if (levels.size() <= depth)
+		levels.resize(depth + 1);
+	levels[depth].push_back((unsigned int)parents.size() - 1);
+	return (unsigned int)parents.size() - 1;
+}
+
+unsigned int SceneGraph::Size()
+{
+	return (unsigned int)parents.size();
+}
+
+void SceneGraph::SetTranslation(unsigned int node, glm::vec3 translation)
+{
+	translations[node] = translation;
+	markDirty(node);
+}
+
+void SceneGraph::SetRotation(unsigned int node, glm::quat rotation)
+{
+	rotations[node] = rotation;
+	markDirty(node);
+}
+
+void SceneGraph::SetScale(unsigned int node, glm::vec3 scale)
+{
+	scales[node] = scale;
+	markDirty(node);
+}
+
+void SceneGraph::SetWeights(unsigned int node, const float* values, unsigned int count)
+{
+	std::vector<float>& target = weights[node];
+	for (unsigned int i = 0; i < count && i < target.size(); i++)
+		target[i] = values[i];
+	weightChanges[node]++;
+}
+
+unsigned int SceneGraph::Update(JobSystem* jobs)
+{
+	if (!anyDirty)
+		return 0;
+
+	unsigned int updated = 0;
+	unsigned int count = Size();
+	if (jobs == NULL || jobs->Size() < 2 || count < SCENE_GRAPH_PARALLEL_NODES)
+	{
+		// Parents come first, so a parent that was recomputed already passed its flag down
+		for (unsigned int i = 0; i < count; i++)
+			updated += updateNode(i);
+	}
+	else
+	{
+		// A level only depends on the one above it, so its nodes are independent of each other
+		std::atomic<unsigned int> levelUpdated{ 0 };
+		for (unsigned int l = 0; l < levels.size(); l++)
+		{
+			std::vector<unsigned int>& level = levels[l];
+			JobCounter counter;
+			jobs->ParallelFor((unsigned int)level.size(), SCENE_GRAPH_BATCH_NODES, [&](unsigned int begin, unsigned int end)
+			{
+				unsigned int batchUpdated = 0;
+				for (unsigned int i = begin; i < end; i++)
+					batchUpdated += updateNode(level[i]);
+				levelUpdated.fetch_add(batchUpdated);
+			}, counter);
+			jobs->Wait(counter);
+		}
+		updated = levelUpdated.load();
+	}
+
+	std::fill(dirty.begin(), dirty.end(), 0);
+	anyDirty = false;
+	return updated;
+}
+
+bool SceneGraph::updateNode(unsigned int i)
+{
+	int parent = parents[i];
+	if (!dirty[i] && (parent < 0 || !dirty[parent]))
+		return false;
+	dirty[i] = 1;
+
+	// Translation times rotation times scale, built directly: the rotation's
+	// columns scaled by the scale, with the translation in the last column
+	glm::mat3 rotation = glm::mat3_cast(rotations[i]);
+	glm::mat4 local;
+	local[0] = glm::vec4(rotation[0] * scales[i].x, 0.0f);
+	local[1] = glm::vec4(rotation[1] * scales[i].y, 0.0f);
+	local[2] = glm::vec4(rotation[2] * scales[i].z, 0.0f);
+	local[3] = glm::vec4(translations[i], 1.0f);
+	if (hasMatrix[i])
+		Multiply(matrices[i], local, local);
+
+	if (parent >= 0)
+		Multiply(worlds[parent], local, worlds[i]);
+	else
+		worlds[i] = local;
+	return true;
+}
+
+void SceneGraph::markDirty(unsigned int node)
+{
+	dirty[node] = 1;
+	anyDirty = true;
+}
@@ -0,0 +1,80 @@
+// If SCENE_GRAPH_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef SCENE_GRAPH_CLASS_H
+#define SCENE_GRAPH_CLASS_H
+
+#include<glm/glm.hpp>
+#include<glm/gtc/quaternion.hpp>
+#include<vector>
+
+#include"JobSystem.h"
+
+
+// The SceneGraph holds a model's node hierarchy as flat arrays, one entry per node,
+// with every parent stored before its children. Each property lives in its own array
+// (structure of arrays), so updating the world matrices is a single pass from front to
+// back that only touches the data it needs, with no recursion.
+// Changing a node's translation, rotation, or scale marks it dirty. Update recomputes
+// the dirty nodes and everything below them, and nothing at all if no node changed.
+class SceneGraph
+{
+public:
+	// Parent of each node, -1 for roots. Always lower than the node's own index.
+	std::vector<int> parents;
+	// Local transformation of each node, as glTF splits it up
+	std::vector<glm::vec3> translations;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	// The node's "matrix" property, applied before its translation, rotation, and scale
+	std::vector<glm::mat4> matrices;
+	// Parent's world matrix times the node's local matrix, valid after Update
+	std::vector<glm::mat4> worlds;
+	// Morph target weights of each node's mesh, empty for nodes without morph targets
+	std::vector<std::vector<float>> weights;
+	// How many times each node's weights were set, so users can tell when they changed
+	std::vector<unsigned int> weightChanges;
+
+	// Appends a node and returns its index. The parent must already be in the graph.
+	unsigned int Add(int parent, const glm::mat4& matrix, glm::vec3 translation, glm::quat rotation, glm::vec3 scale);
+
+	// Returns the number of nodes.
+	unsigned int Size();
+
+	// Change a node's local transformation. The world matrices are updated by the next Update.
+	void SetTranslation(unsigned int node, glm::vec3 translation);
+	void SetRotation(unsigned int node, glm::quat rotation);
+	void SetScale(unsigned int node, glm::vec3 scale);
+
+	// Copies up to count values over a node's morph target weights. Weights don't
+	// affect the world matrices, so they don't mark the node dirty.
+	void SetWeights(unsigned int node, const float* values, unsigned int count);
+
+	// Recomputes the world matrix of every dirty node and of all nodes below them.
+	// Returns how many nodes were recomputed.
+	// With a job system large graphs are updated one depth level at a time, the nodes of a
+	// level in parallel batches, each level starting once the level of their parents is done.
+	unsigned int Update(JobSystem* jobs = NULL);
+
+	// out = a * b for column major matrices, with SSE where it is available.
+	// out may be a or b.
+	static void Multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+
+private:
+	// Non zero for nodes whose own transformation changed since the last Update
+	std::vector<unsigned char> dirty;
+	// Whether any node is dirty, lets Update return right away
+	bool anyDirty = false;
+	// Whether each node has a matrix property, so identity ones skip a multiplication
+	std::vector<unsigned char> hasMatrix;
+	// Nodes grouped by how many parents they have above them, roots first
+	std::vector<std::vector<unsigned int>> levels;
+	std::vector<unsigned int> depths;
+
+	void markDirty(unsigned int node);
+
+	// Recomputes a node's world matrix if it or its parent is dirty, and marks it dirty
+	// for its children. Returns true if it was recomputed.
+	bool updateNode(unsigned int node);
+};
+
+#endif
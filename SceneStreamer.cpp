@@ -0,0 +1,288 @@
+#include"SceneStreamer.h"
+
+#include<iostream>
+#include<sstream>
+#include<iomanip>
+#include<algorithm>
+
+// Bytes of the ledger categories a region is charged for: its meshes and material tables.
+// Its texture arrays are left out, streamed levels and tails alike.
+static GLsizeiptr region_ledger_bytes()
+{
+	return GPUResources::bytes[VRAM_VERTICES] + GPUResources::bytes[VRAM_INDICES] + GPUResources::bytes[VRAM_UNIFORMS];
+}
+
+SceneStreamer::SceneStreamer(TextureStreamer* textures, JobSystem* jobs, GLsizeiptr budgetBytes, GLsizeiptr uploadBytesPerFrame)
+	: workers(SCENE_STREAMER_THREADS)
+{
+	SceneStreamer::textures = textures;
+	SceneStreamer::jobs = jobs;
+	SceneStreamer::budgetBytes = budgetBytes;
+	SceneStreamer::uploadBytesPerFrame = uploadBytesPerFrame;
+}
+
+bool SceneStreamer::Load(const char* file)
+{
+	json scene;
+	try
+	{
+		scene = json::parse(get_file_contents(file));
+	}
+	catch (...)
+	{
+		return false;
+	}
+
+	std::string fileStr = std::string(file);
+	std::string fileDirectory = fileStr.substr(0, fileStr.find_last_of('/') + 1);
+	loadDistance = scene.value("loadDistance", loadDistance);
+	unloadDistance = std::max(scene.value("unloadDistance", unloadDistance), loadDistance);
+
+	json regionsJSON = scene.value("regions", json::array());
+	for (unsigned int i = 0; i < regionsJSON.size(); i++)
+	{
+		json& region = regionsJSON[i];
+		glm::vec3 center(0.0f);
+		if (region.find("center") != region.end())
+		{
+			for (unsigned int c = 0; c < 3; c++)
+				center[c] = region["center"][c];
+		}
+		Add(fileDirectory + std::string(region["model"]), center, region.value("radius", 0.0f));
+	}
+	return true;
+}
+
+unsigned int SceneStreamer::Add(const std::string& file, const glm::vec3& center, float radius)
+{
+	SceneRegion region;
+	region.file = file;
+	region.center = center;
+	region.radius = radius;
+	region.state = REGION_UNLOADED;
+	region.bytes = 0;
+	region.expectedBytes = 0;
+	region.distance = 0.0f;
+	region.load = 0;
+	regions.push_back(std::move(region));
+	return (unsigned int)regions.size() - 1;
+}
+
+void SceneStreamer::Update(const glm::vec3& cameraPosition)
+{
+	// Pick up the regions the workers finished reading. Models of regions that were
+	// unloaded meanwhile are deleted along with done, here on the render thread.
+	std::vector<FinishedLoad> done;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		done.swap(finished);
+	}
+	for (unsigned int i = 0; i < done.size(); i++)
+	{
+		loadsPending--;
+		SceneRegion& region = regions[done[i].region];
+		if (region.state != REGION_LOADING || region.load != done[i].load)
+			continue;
+		if (done[i].model == NULL)
+		{
+			region.state = REGION_FAILED;
+			continue;
+		}
+		region.model = std::move(done[i].model);
+		region.model->jobs = jobs;
+		region.model->stream = stream;
+		region.state = REGION_UPLOADING;
+	}
+
+	// Unload the regions the camera left behind, including ones still being read
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		SceneRegion& region = regions[i];
+		region.distance = std::max(glm::length(cameraPosition - region.center) - region.radius, 0.0f);
+		if (region.distance > unloadDistance && region.state != REGION_UNLOADED && region.state != REGION_FAILED)
+			unload(region);
+	}
+
+	// Start loading the regions in reach, nearest first, as long as a worker is free
+	std::vector<unsigned int> wanted;
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].state == REGION_UNLOADED && regions[i].distance < loadDistance)
+			wanted.push_back(i);
+	}
+	std::sort(wanted.begin(), wanted.end(), [this](unsigned int a, unsigned int b)
+	{
+		return regions[a].distance < regions[b].distance;
+	});
+	loadsWaiting = 0;
+	for (unsigned int i = 0; i < wanted.size(); i++)
+	{
+		if (loadsPending >= workers.Size())
+		{
+			loadsWaiting = (unsigned int)(wanted.size() - i);
+			break;
+		}
+
+		// Make room by unloading regions further away than this one. If there still isn't
+		// enough, nothing further away fits either.
+		SceneRegion& region = regions[wanted[i]];
+		int furthest;
+		while (ResidentBytes() + region.expectedBytes > budgetBytes && (furthest = furthestResident(region.distance)) >= 0)
+			unload(regions[furthest]);
+		if (ResidentBytes() > 0 && ResidentBytes() + region.expectedBytes > budgetBytes)
+			break;
+		startLoad(wanted[i]);
+	}
+
+	// Spend this frame's uploads on the nearest regions first, and count what they take
+	std::vector<unsigned int> uploading;
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].state == REGION_UPLOADING)
+			uploading.push_back(i);
+	}
+	std::sort(uploading.begin(), uploading.end(), [this](unsigned int a, unsigned int b)
+	{
+		return regions[a].distance < regions[b].distance;
+	});
+	GLsizeiptr uploadBudget = uploadBytesPerFrame;
+	for (unsigned int i = 0; i < uploading.size() && uploadBudget > 0; i++)
+	{
+		SceneRegion& region = regions[uploading[i]];
+		GLsizeiptr before = region_ledger_bytes();
+		bool ready = region.model->Upload(uploadBudget);
+		region.bytes += region_ledger_bytes() - before;
+		if (ready)
+		{
+			region.state = REGION_READY;
+			region.expectedBytes = region.bytes;
+		}
+	}
+
+	// A region read for the first time can turn out larger than there was room for,
+	// the furthest ones go until the rest fits. The nearest one always stays.
+	float nearest = -1.0f;
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		RegionState state = regions[i].state;
+		if ((state == REGION_LOADING || state == REGION_UPLOADING || state == REGION_READY) && (nearest < 0.0f || regions[i].distance < nearest))
+			nearest = regions[i].distance;
+	}
+	int furthest;
+	while (ResidentBytes() > budgetBytes && (furthest = furthestResident(nearest)) >= 0)
+		unload(regions[furthest]);
+}
+
+void SceneStreamer::Models(std::vector<Model*>& models)
+{
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].state == REGION_READY)
+			models.push_back(regions[i].model.get());
+	}
+}
+
+GLsizeiptr SceneStreamer::ResidentBytes()
+{
+	// Regions on their way in count with what they took last time
+	GLsizeiptr total = 0;
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		RegionState state = regions[i].state;
+		if (state == REGION_LOADING || state == REGION_UPLOADING || state == REGION_READY)
+			total += std::max(regions[i].bytes, regions[i].expectedBytes);
+	}
+	return total;
+}
+
+bool SceneStreamer::Idle()
+{
+	if (loadsWaiting > 0)
+		return false;
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].state == REGION_LOADING || regions[i].state == REGION_UPLOADING)
+			return false;
+	}
+	return true;
+}
+
+std::string SceneStreamer::StatsLine()
+{
+	unsigned int counts[REGION_FAILED + 1] = { 0 };
+	GLsizeiptr readyBytes = 0;
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		counts[regions[i].state]++;
+		if (regions[i].state == REGION_READY)
+			readyBytes += regions[i].bytes;
+	}
+
+	std::ostringstream line;
+	line << std::fixed << std::setprecision(1);
+	line << "Regions: " << counts[REGION_READY] << " ready (" << readyBytes / 1048576.0 << " MB), "
+		<< counts[REGION_LOADING] << " loading, " << counts[REGION_UPLOADING] << " uploading, "
+		<< counts[REGION_UNLOADED] << " unloaded";
+	if (counts[REGION_FAILED] > 0)
+		line << ", " << counts[REGION_FAILED] << " failed";
+	return line.str();
+}
+
+void SceneStreamer::Delete()
+{
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		if (regions[i].state != REGION_FAILED)
+			unload(regions[i]);
+	}
+}
+
+void SceneStreamer::startLoad(unsigned int index)
+{
+	SceneRegion& region = regions[index];
+	region.state = REGION_LOADING;
+	region.load++;
+	loadsPending++;
+
+	// The worker gets copies of everything, the regions may be added to while it reads
+	std::string file = region.file;
+	unsigned int load = region.load;
+	TextureStreamer* textures = SceneStreamer::textures;
+	workers.Submit([this, index, load, file, textures]()
+	{
+		// Read without a job system, the render thread would end up running the jobs
+		std::unique_ptr<Model> model;
+		try
+		{
+			model.reset(new Model(file.c_str(), textures, NULL, MESH_GEOMETRY_RELEASE, true));
+		}
+		catch (...)
+		{
+			std::cout << "SCENE_STREAMING_ERROR for: " << file << std::endl;
+		}
+
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		finished.push_back(FinishedLoad{ index, load, std::move(model) });
+	});
+}
+
+void SceneStreamer::unload(SceneRegion& region)
+{
+	region.model.reset();
+	region.bytes = 0;
+	region.state = REGION_UNLOADED;
+}
+
+int SceneStreamer::furthestResident(float beyond)
+{
+	int furthest = -1;
+	for (unsigned int i = 0; i < regions.size(); i++)
+	{
+		RegionState state = regions[i].state;
+		if (state != REGION_LOADING && state != REGION_UPLOADING && state != REGION_READY)
+			continue;
+		if (regions[i].distance > beyond && (furthest < 0 || regions[i].distance > regions[furthest].distance))
+			furthest = (int)i;
+	}
+	return furthest;
+}
@@ -0,0 +1,150 @@
+// If SCENE_STREAMER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef SCENE_STREAMER_CLASS_H
+#define SCENE_STREAMER_CLASS_H
+
+#include<string>
+#include<vector>
+#include<memory>
+#include<mutex>
+#include<glm/glm.hpp>
+
+#include"Model.h"
+#include"ThreadPool.h"
+
+
+// Number of worker threads that read region files. Reading is mostly waiting on the disk
+// and building vertices, two keep a load going while the other one parses.
+const unsigned int SCENE_STREAMER_THREADS = 2;
+
+
+// Where a region of a streamed scene is in its life.
+enum RegionState
+{
+	REGION_UNLOADED,
+	// A worker is reading its file and building its meshes
+	REGION_LOADING,
+	// Its model is read and is being uploaded a slice per frame
+	REGION_UPLOADING,
+	// Its model is drawn
+	REGION_READY,
+	// Its file couldn't be read, it isn't tried again
+	REGION_FAILED,
+};
+
+// One part of a streamed scene, a model file and the sphere around it in world space.
+struct SceneRegion
+{
+	std::string file;
+	glm::vec3 center;
+	float radius;
+	RegionState state;
+	// The model, from the moment a worker has read it until the region is unloaded
+	std::unique_ptr<Model> model;
+	// Bytes of vertex, index and uniform buffers the model holds, and what it took when it
+	// was last fully uploaded, which is what loading it again is expected to take (0 before the first time)
+	GLsizeiptr bytes;
+	GLsizeiptr expectedBytes;
+	// Distance from the camera to the sphere at the last Update, 0 inside it
+	float distance;
+	// Tells this load apart from an earlier one that was cancelled while a worker read it
+	unsigned int load;
+};
+
+
+// The SceneStreamer loads the regions of a scene that is too large to keep resident all
+// at once, so it can be explored without a loading screen.
+// Regions that come within loadDistance of the camera are read on worker threads, which
+// parse the file and build the meshes' vertices without touching OpenGL. Update then
+// uploads them on the render thread, uploadBytesPerFrame at a time, nearest first.
+// Regions are unloaded once they are further than unloadDistance, and the gap between
+// the two keeps a region at the edge from loading and unloading every other frame.
+// When the loaded regions would take more than budgetBytes the furthest ones make room
+// for nearer ones. Only the meshes and material tables are counted, the regions' textures
+// aren't, the TextureStreamer has its own budget for them.
+class SceneStreamer
+{
+public:
+	// Distances to a region's sphere at which it is loaded and unloaded
+	float loadDistance = 50.0f;
+	float unloadDistance = 75.0f;
+
+	// Mesh and material table memory the loaded regions may take together, can be changed at runtime
+	GLsizeiptr budgetBytes;
+	// How many bytes of meshes may be uploaded per Update
+	GLsizeiptr uploadBytesPerFrame;
+
+	// Ring the loaded models stream their skins and CPU vertices through
+	StreamBuffer* stream = NULL;
+
+	// The regions' textures are registered with textures, and the loaded models update
+	// their animations and skins on jobs.
+	SceneStreamer(TextureStreamer* textures = NULL, JobSystem* jobs = NULL, GLsizeiptr budgetBytes = 256 << 20, GLsizeiptr uploadBytesPerFrame = 4 << 20);
+
+	// Adds the regions listed in a JSON file:
+	//   { "loadDistance": 50, "unloadDistance": 75,
+	//     "regions": [ { "model": "town/scene.gltf", "center": [0, 0, 0], "radius": 20 }, ... ] }
+	// The distances are optional, and model files are relative to the scene file.
+	// Returns false if the file couldn't be read.
+	bool Load(const char* file);
+
+	// Adds a region whose model is inside the sphere at center. Returns its index.
+	unsigned int Add(const std::string& file, const glm::vec3& center, float radius);
+
+	// Picks up the regions the workers finished reading, unloads the ones that are too far
+	// or over the budget, starts loading the nearest ones in reach, and spends this
+	// frame's uploads. Must be called once per frame on the thread that owns the GL context.
+	void Update(const glm::vec3& cameraPosition);
+
+	// Adds the model of every region that is ready to be drawn to models.
+	void Models(std::vector<Model*>& models);
+
+	// Returns the bytes held by the regions that are loaded, counting the ones still being
+	// read or uploaded with what they took the last time they were loaded.
+	GLsizeiptr ResidentBytes();
+
+	// Returns true if no region is being read or uploaded, or waits for a free worker.
+	bool Idle();
+
+	// Returns a line such as "Regions: 3 ready (12.5 MB), 1 loading, 0 uploading, 8 unloaded".
+	std::string StatsLine();
+
+	// Unloads every region, regions still being read are thrown away when they finish.
+	void Delete();
+
+private:
+	TextureStreamer* textures;
+	JobSystem* jobs;
+	std::vector<SceneRegion> regions;
+
+	// A region a worker finished reading, with a NULL model if it failed
+	struct FinishedLoad
+	{
+		unsigned int region;
+		unsigned int load;
+		std::unique_ptr<Model> model;
+	};
+
+	std::mutex finishedMutex;
+	std::vector<FinishedLoad> finished;
+
+	// Loads handed to the workers that haven't come back yet, and regions in reach
+	// the last Update left for later because every worker was busy
+	unsigned int loadsPending = 0;
+	unsigned int loadsWaiting = 0;
+
+	// Declared last so the workers are joined before the members they write to go away.
+	ThreadPool workers;
+
+	// Queues the reading of a region on a worker.
+	void startLoad(unsigned int region);
+
+	// Deletes a region's model, or forgets the load a worker is still busy with.
+	void unload(SceneRegion& region);
+
+	// Returns the region furthest from the camera that is loaded or on its way in, if it
+	// is further than beyond, otherwise -1.
+	int furthestResident(float beyond);
+};
+
+#endif
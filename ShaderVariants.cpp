@@ -0,0 +1,52 @@
+#include"ShaderVariants.h"
+
+ShaderVariants::ShaderVariants(const char* vertexFile, const char* fragmentFile, ProgramCache* cache, const char* fragmentLibrary)
+{
+	ShaderVariants::vertexFile = vertexFile;
+	ShaderVariants::fragmentFile = fragmentFile;
+	if (fragmentLibrary != NULL)
+		ShaderVariants::fragmentLibrary = fragmentLibrary;
+	ShaderVariants::cache = cache;
+}
+
+Shader& ShaderVariants::Get(unsigned int features)
+{
+	// Reuse the variant if it was built before
+	auto found = variants.find(features);
+	if (found != variants.end())
+		return found->second;
+
+	// Otherwise compile it with the matching defines and let the caller set it up
+	auto inserted = variants.emplace(features, Shader(vertexFile.c_str(), fragmentFile.c_str(), shader_defines(features), cache, fragmentLibrary.empty() ? NULL : fragmentLibrary.c_str()));
+	Shader& shader = inserted.first->second;
+	if (onCreate)
+		onCreate(shader);
+	return shader;
+}
+
+void ShaderVariants::Reload()
+{
+	for (auto& pair : variants)
+		pair.second.BeginReload();
+}
+
+void ShaderVariants::Update()
+{
+	// Only one variant moves forward per frame, so reloading many of them never causes a hitch
+	for (auto& pair : variants)
+	{
+		Shader& shader = pair.second;
+		if (!shader.Reloading())
+			continue;
+		if (shader.UpdateReload() && onCreate)
+			onCreate(shader);
+		return;
+	}
+}
+
+void ShaderVariants::Delete()
+{
+	for (auto& pair : variants)
+		pair.second.Delete();
+	variants.clear();
+}
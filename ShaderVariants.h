@@ -0,0 +1,50 @@
+// If SHADER_VARIANTS_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef SHADER_VARIANTS_CLASS_H
+#define SHADER_VARIANTS_CLASS_H
+
+#include<unordered_map>
+#include<functional>
+
+#include"shaderClass.h"
+
+
+// ShaderVariants builds one shader program per combination of ShaderFeature bits
+// from the same pair of source files. A variant is compiled the first time it is
+// asked for and then reused, so every material only pays for the features it uses
+// instead of branching on them in every fragment.
+class ShaderVariants
+{
+public:
+	// Stores the source files and the cache variants are loaded from and saved to.
+	// fragmentLibrary is placed in front of the fragment shader of every variant, see Shader.
+	ShaderVariants(const char* vertexFile, const char* fragmentFile, ProgramCache* cache = NULL, const char* fragmentLibrary = NULL);
+
+	// Returns the program compiled with exactly these feature bits, building it if needed.
+	Shader& Get(unsigned int features);
+
+	// Called once for every newly built variant, used to set uniforms that never change
+	// (for example the light color) without knowing in advance which variants will exist.
+	std::function<void(Shader&)> onCreate;
+
+	// Rebuilds every variant from the source files, for example after a ShaderWatcher saw them change.
+	// The variants keep drawing with their current programs until Update has rebuilt them.
+	void Reload();
+
+	// Advances the pending reloads by a single step, call once per frame.
+	// onCreate runs again for each variant that was swapped, since a new program starts
+	// out with all its uniforms at zero.
+	void Update();
+
+	// Deletes every variant that was built.
+	void Delete();
+
+private:
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::string fragmentLibrary;
+	ProgramCache* cache;
+	std::unordered_map<unsigned int, Shader> variants;
+};
+
+#endif
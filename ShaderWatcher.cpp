@@ -0,0 +1,95 @@
+#include"ShaderWatcher.h"
+
+#ifdef __linux__
+#include<sys/inotify.h>
+#include<unistd.h>
+#endif
+
+// How often the last write times are compared when inotify isn't available
+const std::chrono::milliseconds SHADER_WATCHER_INTERVAL(250);
+
+ShaderWatcher::ShaderWatcher()
+{
+	lastCheck = std::chrono::steady_clock::now();
+#ifdef __linux__
+	inotifyFD = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+	if (inotifyFD >= 0)
+		close(inotifyFD);
+#endif
+}
+
+void ShaderWatcher::Watch(const std::string& file)
+{
+	// Files are compared by their absolute path, so "default.frag" and "./default.frag" are the same
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::absolute(file, error).lexically_normal();
+	files[path.string()] = std::filesystem::last_write_time(path, error);
+
+#ifdef __linux__
+	if (inotifyFD < 0)
+		return;
+	std::string directory = path.parent_path().string();
+	for (auto& watched : directories)
+		if (watched.second == directory)
+			return;
+	int wd = inotify_add_watch(inotifyFD, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+	if (wd >= 0)
+		directories[wd] = directory;
+#endif
+}
+
+bool ShaderWatcher::Poll()
+{
+	bool changed = false;
+
+#ifdef __linux__
+	if (inotifyFD >= 0)
+	{
+		// Drain every pending event and check whether any of them names a watched file
+		alignas(inotify_event) char buffer[4096];
+		while (true)
+		{
+			ssize_t length = read(inotifyFD, buffer, sizeof(buffer));
+			if (length <= 0)
+				break;
+			for (char* ptr = buffer; ptr < buffer + length; )
+			{
+				inotify_event* event = (inotify_event*)ptr;
+				auto directory = directories.find(event->wd);
+				if (event->len > 0 && directory != directories.end())
+				{
+					std::string file = directory->second + "/" + event->name;
+					if (files.find(file) != files.end())
+						changed = true;
+				}
+				ptr += sizeof(inotify_event) + event->len;
+			}
+		}
+		return changed;
+	}
+#endif
+
+	// Without inotify, look at the write times, but not every single frame
+	auto now = std::chrono::steady_clock::now();
+	if (now - lastCheck < SHADER_WATCHER_INTERVAL)
+		return false;
+	lastCheck = now;
+
+	for (auto& file : files)
+	{
+		std::error_code error;
+		std::filesystem::file_time_type time = std::filesystem::last_write_time(file.first, error);
+		if (!error && time != file.second)
+		{
+			file.second = time;
+			changed = true;
+		}
+	}
+	return changed;
+}
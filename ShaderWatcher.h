@@ -0,0 +1,44 @@
+// If SHADER_WATCHER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef SHADER_WATCHER_CLASS_H
+#define SHADER_WATCHER_CLASS_H
+
+#include<string>
+#include<vector>
+#include<map>
+#include<chrono>
+#include<filesystem>
+
+
+// ShaderWatcher tells the render loop when shader source files were saved, so the
+// shaders built from them can be reloaded while the program runs. On Linux it uses
+// inotify and costs one non-blocking read per frame. Everywhere else it compares the
+// files' last write times a few times per second.
+class ShaderWatcher
+{
+public:
+	ShaderWatcher();
+	~ShaderWatcher();
+
+	// Starts watching a file.
+	void Watch(const std::string& file);
+
+	// Returns true if any watched file changed since the last call. Never blocks.
+	bool Poll();
+
+private:
+	// Watched files and the last write time they were seen with
+	std::map<std::string, std::filesystem::file_time_type> files;
+	// When the write times were last compared
+	std::chrono::steady_clock::time_point lastCheck;
+
+#ifdef __linux__
+	// inotify instance, and the directory every watch descriptor belongs to.
+	// Directories are watched instead of the files themselves, because editors that
+	// save by renaming a new file over the old one would otherwise end the watch.
+	int inotifyFD = -1;
+	std::map<int, std::string> directories;
+#endif
+};
+
+#endif
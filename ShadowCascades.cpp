@@ -0,0 +1,173 @@
+#include"ShadowCascades.h"
+#include"Profiler.h"
+
+// std140 layout of the Shadows block in default.frag
+struct ShadowParams
+{
+	glm::mat4 matrices[MAX_SHADOW_CASCADES];
+	GLint count;
+	GLfloat texelSize;
+	GLfloat padding[2];
+};
+
+ShadowCascades::ShadowCascades(unsigned int count, int resolution, ProgramCache* cache) :
+	depthVariants("depth.vert", "depth.frag", cache)
+{
+	ShadowCascades::count = std::min(std::max(count, 1u), MAX_SHADOW_CASCADES);
+	ShadowCascades::resolution = resolution;
+
+	// One depth layer per cascade, compared against in the shader for hardware filtering
+	depthArray = GPUHandle::Create(GPU_TEXTURE, VRAM_RENDER_TARGETS, (GLsizeiptr)resolution * resolution * 4 * ShadowCascades::count);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray.ID);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, ShadowCascades::count, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	// The framebuffer only has depth, its layer is switched per cascade
+	GLint previous = 0;
+	glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+	framebuffer = GPUHandle::Create(GPU_FRAMEBUFFER, VRAM_RENDER_TARGETS);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.ID);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray.ID, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+	glBindFramebuffer(GL_FRAMEBUFFER, previous);
+
+	shadowUBO = GPUHandle::Create(GPU_BUFFER, VRAM_UNIFORMS, sizeof(ShadowParams));
+	glBindBuffer(GL_UNIFORM_BUFFER, shadowUBO.ID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(ShadowParams), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void ShadowCascades::Render(Model& model, Camera& camera, unsigned int features)
+{
+	Render(std::vector<Model*>{ &model }, camera, features);
+}
+
+void ShadowCascades::Render(const std::vector<Model*>& models, Camera& camera, unsigned int features)
+{
+	GLint target = 0;
+	GLint viewport[4];
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.ID);
+	glViewport(0, 0, resolution, resolution);
+	// Push the depth away from the light a little, more on slopes, to keep surfaces from shadowing themselves
+	glEnable(GL_POLYGON_OFFSET_FILL);
+	glPolygonOffset(2.0f, 4.0f);
+
+	// Split the shadowed distance, mixing even and logarithmic splits
+	float nearPlane = camera.nearPlane;
+	float farPlane = std::min(shadowDistance, camera.farPlane);
+	float previousSplit = nearPlane;
+	castersDrawn = 0;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		float fraction = (float)(i + 1) / count;
+		float logSplit = nearPlane * std::pow(farPlane / nearPlane, fraction);
+		float evenSplit = nearPlane + (farPlane - nearPlane) * fraction;
+		float split = splitLambda * logSplit + (1.0f - splitLambda) * evenSplit;
+
+		matrices[i] = fitCascade(camera, previousSplit, split);
+		previousSplit = split;
+
+		ProfileScope profile("Cascade");
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthArray.ID, 0, i);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		for (unsigned int m = 0; m < models.size(); m++)
+			castersDrawn += models[m]->DrawDepth(depthVariants, features, matrices[i]);
+	}
+
+	glDisable(GL_POLYGON_OFFSET_FILL);
+	glBindFramebuffer(GL_FRAMEBUFFER, target);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	ShadowParams params;
+	for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		params.matrices[i] = i < count ? matrices[i] : glm::mat4(1.0f);
+	params.count = count;
+	params.texelSize = 1.0f / resolution;
+	params.padding[0] = params.padding[1] = 0.0f;
+	glBindBuffer(GL_UNIFORM_BUFFER, shadowUBO.ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(params), &params);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, depthArray.ID);
+	glActiveTexture(GL_TEXTURE0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, SHADOW_UBO_BINDING, shadowUBO.ID);
+}
+
+void ShadowCascades::Bind(Shader& shader)
+{
+	shader.Activate();
+	glUniform1i(shader.Uniform("shadowMap"), SHADOW_UNIT);
+
+	GLuint blockIndex = glGetUniformBlockIndex(shader.ID, "Shadows");
+	if (blockIndex != GL_INVALID_INDEX)
+		glUniformBlockBinding(shader.ID, blockIndex, SHADOW_UBO_BINDING);
+}
+
+void ShadowCascades::Reload()
+{
+	depthVariants.Reload();
+}
+
+void ShadowCascades::Update()
+{
+	depthVariants.Update();
+}
+
+void ShadowCascades::Delete()
+{
+	depthArray.Reset();
+	framebuffer.Reset();
+	shadowUBO.Reset();
+	depthVariants.Delete();
+}
+
+glm::mat4 ShadowCascades::fitCascade(Camera& camera, float nearDistance, float farDistance)
+{
+	// Corners of this slice of the camera's view, in world space
+	float tanY = std::tan(glm::radians(camera.FOVdeg) * 0.5f);
+	float tanX = tanY * camera.width / camera.height;
+	glm::mat4 invView = glm::inverse(camera.view);
+	glm::vec3 corners[8];
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		float distance = i < 4 ? nearDistance : farDistance;
+		glm::vec4 corner = glm::vec4((i & 1 ? 1.0f : -1.0f) * tanX * distance, (i & 2 ? 1.0f : -1.0f) * tanY * distance, -distance, 1.0f);
+		corners[i] = glm::vec3(invView * corner);
+	}
+
+	// A sphere around the corners has the same size whichever way the camera faces.
+	// Rounding the radius up keeps float noise from changing it between frames.
+	glm::vec3 center = glm::vec3(0.0f);
+	for (unsigned int i = 0; i < 8; i++)
+		center += corners[i] / 8.0f;
+	float radius = 0.0f;
+	for (unsigned int i = 0; i < 8; i++)
+		radius = std::max(radius, glm::length(corners[i] - center));
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	// Look at the sphere from the light, far enough back to catch casters outside the slice
+	glm::vec3 up = std::abs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 lightView = glm::lookAt(center + lightDirection * (radius + casterDistance), center, up);
+	glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, 0.0f, 2.0f * radius + casterDistance);
+
+	// Move the projection so the world origin lands exactly on a texel, then every
+	// world position stays on the same texel from frame to frame
+	glm::mat4 matrix = lightProjection * lightView;
+	glm::vec4 origin = matrix * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f) * (resolution * 0.5f);
+	glm::vec4 offset = (glm::round(origin) - origin) * (2.0f / resolution);
+	lightProjection[3][0] += offset.x;
+	lightProjection[3][1] += offset.y;
+
+	return lightProjection * lightView;
+}
@@ -0,0 +1,84 @@
+// If SHADOW_CASCADES_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef SHADOW_CASCADES_CLASS_H
+#define SHADOW_CASCADES_CLASS_H
+
+#include"Model.h"
+
+
+// Most cascades the shaders can sample, must match the Shadows block in default.frag.
+const unsigned int MAX_SHADOW_CASCADES = 4;
+
+// Texture unit and uniform buffer binding the shadow maps are bound to.
+// Units 0 to 8 are taken by the materials, light clusters, and G-buffer.
+const GLuint SHADOW_UNIT = 9;
+const GLuint SHADOW_UBO_BINDING = 2;
+
+
+// ShadowCascades gives the directional light cascaded shadow maps. The part of the
+// camera's view within shadowDistance is split into slices, close slices thin and far
+// ones thick, and each slice gets its own shadow map of the same resolution, so shadows
+// are sharp near the camera without spending the same detail on the distance.
+// Every cascade is fit around a sphere, so its size doesn't change as the camera turns,
+// and snapped to whole shadow map texels, so its edges don't shimmer as the camera moves.
+// Only the meshes that reach a cascade are drawn into it, with a depth only shader and
+// the meshes' position only vertex buffers. Shaders built with SHADER_SHADOWS sample
+// the cascades with 3x3 percentage closer filtering.
+class ShadowCascades
+{
+public:
+	// Direction pointing towards the light, must match the one in direcLight().
+	glm::vec3 lightDirection = glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f));
+	// How far from the camera shadows are drawn.
+	float shadowDistance = 50.0f;
+	// 0 splits the cascades evenly, 1 splits them logarithmically, in between blends the two.
+	float splitLambda = 0.75f;
+	// How far behind a cascade, towards the light, meshes can still cast shadows into it.
+	float casterDistance = 50.0f;
+
+	// Number of cascades and the width and height of each one's shadow map
+	unsigned int count;
+	int resolution;
+
+	// Meshes drawn into all cascades during the last Render
+	unsigned int castersDrawn = 0;
+
+	// Creates count cascades (at most MAX_SHADOW_CASCADES) of resolution by resolution texels.
+	// The depth shaders are cached in cache if one is given.
+	ShadowCascades(unsigned int count = 4, int resolution = 2048, ProgramCache* cache = NULL);
+
+	// Fits the cascades to the camera and draws the model's depth into each of them.
+	// The bound framebuffer and viewport are put back afterwards. features are the ones
+	// the model is shaded with, so masked materials cast the holes they are drawn with.
+	void Render(Model& model, Camera& camera, unsigned int features = 0);
+	// Same, drawing the depth of every model into each cascade.
+	void Render(const std::vector<Model*>& models, Camera& camera, unsigned int features = 0);
+
+	// Points a shader's shadow sampler and Shadows block at the cascades.
+	// Only needs to be called once per shader.
+	void Bind(Shader& shader);
+
+	// Reloads and advances the reloads of the depth shaders, like ShaderVariants does.
+	void Reload();
+	void Update();
+
+	// Deletes the shadow maps and the depth shaders.
+	void Delete();
+
+private:
+	// Depth texture array with one layer per cascade, and the framebuffer rendering into it
+	GPUHandle depthArray;
+	GPUHandle framebuffer;
+	// Holds the cascade matrices for the shaders
+	GPUHandle shadowUBO;
+	// Depth only shaders (depth.vert and depth.frag)
+	ShaderVariants depthVariants;
+
+	// Light view and projection of every cascade from the last Render
+	glm::mat4 matrices[MAX_SHADOW_CASCADES];
+
+	// Returns the light matrix of a cascade covering the camera's view from nearDistance to farDistance
+	glm::mat4 fitCascade(Camera& camera, float nearDistance, float farDistance);
+};
+
+#endif
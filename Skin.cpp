@@ -0,0 +1,142 @@
+#include"Skin.h"
+
+#include<iostream>
+#include<algorithm>
+
+// SSE is always there on x86 and x64. Other targets blend with glm.
+#if defined(__SSE__) || defined(_M_X64) || defined(_M_IX86)
+#include<xmmintrin.h>
+#define SKIN_SSE
+#endif
+
+Skin::Skin(std::vector<unsigned int>& joints, std::vector<glm::mat4>& inverseBindMatrices)
+{
+	Skin::joints = joints;
+	Skin::inverseBindMatrices = inverseBindMatrices;
+	palette.assign(joints.size(), glm::mat4(1.0f));
+
+	if (joints.size() > MAX_SKIN_JOINTS)
+	{
+		std::cout << "SKIN_JOINTS_ERROR: " << joints.size() << " joints don't fit in the Skin block (" << MAX_SKIN_JOINTS << "), skinning on the CPU" << std::endl;
+		return;
+	}
+
+	// Sized for the whole uniform block, like the material table
+	ubo = GPUHandle::Create(GPU_BUFFER, VRAM_UNIFORMS, MAX_SKIN_JOINTS * sizeof(glm::mat4));
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo.ID);
+	glBufferData(GL_UNIFORM_BUFFER, MAX_SKIN_JOINTS * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Skin::Update(SceneGraph& nodes)
+{
+	for (unsigned int i = 0; i < joints.size(); i++)
+		SceneGraph::Multiply(nodes.worlds[joints[i]], inverseBindMatrices[i], palette[i]);
+}
+
+void Skin::Upload(StreamBuffer* stream)
+{
+	if (ubo.ID == 0 || palette.empty())
+		return;
+	Skin::stream = stream;
+	streamOffset = -1;
+	if (stream != NULL)
+	{
+		// The whole block is reserved, binding less than the shader declares is undefined
+		streamOffset = stream->Allocate(MAX_SKIN_JOINTS * sizeof(glm::mat4), stream->uniformAlignment);
+		streamFrame = stream->frame;
+		if (streamOffset >= 0)
+		{
+			stream->Write(streamOffset, palette.data(), palette.size() * sizeof(glm::mat4));
+			return;
+		}
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, ubo.ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, palette.size() * sizeof(glm::mat4), palette.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+bool Skin::GPU()
+{
+	return ubo.ID != 0;
+}
+
+void Skin::Bind()
+{
+	if (streamOffset >= 0 && stream->frame != streamFrame)
+		Upload(stream);
+	if (streamOffset >= 0)
+		glBindBufferRange(GL_UNIFORM_BUFFER, SKIN_UBO_BINDING, stream->ID.ID, streamOffset, MAX_SKIN_JOINTS * sizeof(glm::mat4));
+	else
+		glBindBufferBase(GL_UNIFORM_BUFFER, SKIN_UBO_BINDING, ubo.ID);
+}
+
+void skin_vertices
+(
+	const std::vector<glm::mat4>& palette,
+	const std::vector<Vertex>& vertices,
+	const std::vector<SkinVertex>& skin,
+	std::vector<Vertex>& out,
+	std::vector<glm::vec3>& positions
+)
+{
+	out.resize(vertices.size());
+	positions.resize(vertices.size());
+	unsigned int lastJoint = palette.empty() ? 0 : (unsigned int)palette.size() - 1;
+
+	for (unsigned int i = 0; i < vertices.size(); i++)
+	{
+		const Vertex& vertex = vertices[i];
+		const SkinVertex& influence = skin[i];
+		out[i] = vertex;
+		if (palette.empty())
+		{
+			positions[i] = vertex.position;
+			continue;
+		}
+
+#ifdef SKIN_SSE
+		// Blend the columns of the joint matrices by the vertex's weights
+		__m128 columns[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+		for (int k = 0; k < 4; k++)
+		{
+			if (influence.weights[k] == 0.0f)
+				continue;
+			const glm::mat4& joint = palette[std::min((unsigned int)influence.joints[k], lastJoint)];
+			__m128 weight = _mm_set1_ps(influence.weights[k]);
+			for (int c = 0; c < 4; c++)
+				columns[c] = _mm_add_ps(columns[c], _mm_mul_ps(_mm_loadu_ps(&joint[c][0]), weight));
+		}
+
+		// Position is the blended matrix times (position, 1), the normal and tangent only take its rotation and scale
+		__m128 normal = _mm_mul_ps(columns[0], _mm_set1_ps(vertex.normal.x));
+		normal = _mm_add_ps(normal, _mm_mul_ps(columns[1], _mm_set1_ps(vertex.normal.y)));
+		normal = _mm_add_ps(normal, _mm_mul_ps(columns[2], _mm_set1_ps(vertex.normal.z)));
+		__m128 tangent = _mm_mul_ps(columns[0], _mm_set1_ps(vertex.tangent.x));
+		tangent = _mm_add_ps(tangent, _mm_mul_ps(columns[1], _mm_set1_ps(vertex.tangent.y)));
+		tangent = _mm_add_ps(tangent, _mm_mul_ps(columns[2], _mm_set1_ps(vertex.tangent.z)));
+		__m128 position = _mm_add_ps(columns[3], _mm_mul_ps(columns[0], _mm_set1_ps(vertex.position.x)));
+		position = _mm_add_ps(position, _mm_mul_ps(columns[1], _mm_set1_ps(vertex.position.y)));
+		position = _mm_add_ps(position, _mm_mul_ps(columns[2], _mm_set1_ps(vertex.position.z)));
+
+		float p[4], n[4], t[4];
+		_mm_storeu_ps(p, position);
+		_mm_storeu_ps(n, normal);
+		_mm_storeu_ps(t, tangent);
+		out[i].position = glm::vec3(p[0], p[1], p[2]);
+		out[i].normal = glm::vec3(n[0], n[1], n[2]);
+		out[i].tangent = glm::vec4(t[0], t[1], t[2], vertex.tangent.w);
+#else
+		glm::mat4 blended(0.0f);
+		for (int k = 0; k < 4; k++)
+		{
+			if (influence.weights[k] != 0.0f)
+				blended += influence.weights[k] * palette[std::min((unsigned int)influence.joints[k], lastJoint)];
+		}
+		out[i].position = glm::vec3(blended * glm::vec4(vertex.position, 1.0f));
+		out[i].normal = glm::mat3(blended) * vertex.normal;
+		out[i].tangent = glm::vec4(glm::mat3(blended) * glm::vec3(vertex.tangent), vertex.tangent.w);
+#endif
+		positions[i] = out[i].position;
+	}
+}
@@ -0,0 +1,80 @@
+// If SKIN_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef SKIN_CLASS_H
+#define SKIN_CLASS_H
+
+#include<glad/glad.h>
+#include<glm/glm.hpp>
+#include<vector>
+
+#include"VBO.h"
+#include"SceneGraph.h"
+#include"StreamBuffer.h"
+#include"GPUResources.h"
+
+
+// The most joints a skin can have and still be skinned by the vertex shader.
+// Must match MAX_JOINTS in default.vert and depth.vert.
+const unsigned int MAX_SKIN_JOINTS = 128;
+
+// The uniform buffer binding point the joint palette of the skin being drawn is bound to.
+const GLuint SKIN_UBO_BINDING = 3;
+
+
+// A Skin is a glTF skin: the scene graph nodes acting as joints and the matrices that
+// take the mesh from its bind pose into each joint's space. Every time the joints move,
+// Update builds the palette, one matrix per joint that moves a vertex from the bind pose
+// to where that joint now places it, and uploads it for the vertex shader.
+// Skins with more joints than the uniform block holds are skinned on the CPU instead.
+class Skin
+{
+public:
+	// Scene graph node of every joint
+	std::vector<unsigned int> joints;
+	// Takes a vertex from the bind pose into the joint's space, one per joint
+	std::vector<glm::mat4> inverseBindMatrices;
+	// World matrix of each joint times its inverse bind matrix, valid after Update
+	std::vector<glm::mat4> palette;
+
+	// Creates the palette's uniform buffer if the skin fits in it.
+	Skin(std::vector<unsigned int>& joints, std::vector<glm::mat4>& inverseBindMatrices);
+
+	// Rebuilds the palette from the scene graph's world matrices.
+	// Doesn't touch OpenGL, so skins can be updated on the job system.
+	void Update(SceneGraph& nodes);
+
+	// Uploads the palette for the vertex shader, on the thread that owns the context.
+	// With a stream buffer the palette is written into this frame's part of the ring
+	// instead of over the uniform buffer the last frame's draws may still be reading.
+	void Upload(StreamBuffer* stream = NULL);
+
+	// Returns true if the vertex shader can skin with this palette.
+	bool GPU();
+
+	// Binds the palette to SKIN_UBO_BINDING for the next draws. A palette streamed in an
+	// earlier frame is streamed again first, since the ring reuses its region.
+	void Bind();
+
+private:
+	// Deleted with the skin
+	GPUHandle ubo;
+
+	// Where the last Upload streamed the palette to, -1 if it went to the uniform buffer
+	StreamBuffer* stream = NULL;
+	GLintptr streamOffset = -1;
+	unsigned long long streamFrame = 0;
+};
+
+// Skins vertices on the CPU the way the SKINNING shaders do, blending the palette
+// matrices of every vertex's joints with SSE. out gets the skinned vertices and
+// positions their positions alone, for the position only buffer of depth passes.
+void skin_vertices
+(
+	const std::vector<glm::mat4>& palette,
+	const std::vector<Vertex>& vertices,
+	const std::vector<SkinVertex>& skin,
+	std::vector<Vertex>& out,
+	std::vector<glm::vec3>& positions
+);
+
+#endif
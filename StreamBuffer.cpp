@@ -0,0 +1,140 @@
+#include"StreamBuffer.h"
+
+#include"GLProc.h"
+#include<cstring>
+
+StreamBuffer::StreamBuffer(GLsizeiptr frameSize)
+{
+	StreamBuffer::frameSize = frameSize;
+
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	if (alignment > 0)
+		uniformAlignment = alignment;
+
+	// Buffer storage is core in OpenGL 4.4 and otherwise comes from ARB_buffer_storage
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool available = major > 4 || (major == 4 && minor >= 4);
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions && !available; i++)
+		available = std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0;
+	PFNBUFFERSTORAGEPROC bufferStorage = available ? (PFNBUFFERSTORAGEPROC)gl_proc_address("glBufferStorage") : NULL;
+
+	// The copy write target is bound so no vertex, index, or uniform binding is disturbed
+	GLsizeiptr size = frameSize * STREAM_BUFFER_FRAMES;
+	ID = GPUHandle::Create(GPU_BUFFER, VRAM_STREAMING, size);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ID.ID);
+	if (bufferStorage != NULL)
+	{
+		// Coherent, so written data reaches the GPU without flushing each range
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+		mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		persistent = mapped != NULL;
+		// Storage can't be resized, a buffer that didn't map is replaced by a plain one
+		if (!persistent)
+		{
+			ID = GPUHandle::Create(GPU_BUFFER, VRAM_STREAMING, size);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, ID.ID);
+		}
+	}
+	if (!persistent)
+		glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+GLintptr StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLintptr offset = (head + alignment - 1) / alignment * alignment;
+	if (offset + size > (GLintptr)(region + 1) * frameSize)
+	{
+		overflows++;
+		return -1;
+	}
+	head = offset + size;
+	return offset;
+}
+
+void StreamBuffer::Write(GLintptr offset, const void* data, GLsizeiptr size)
+{
+	if (persistent)
+	{
+		std::memcpy(mapped + offset, data, (size_t)size);
+		return;
+	}
+
+	// Unsynchronized is safe since the GPU is done with the region, and invalidating
+	// tells the driver the old contents of the range can be thrown away
+	glBindBuffer(GL_COPY_WRITE_BUFFER, ID.ID);
+	void* range = glMapBufferRange(GL_COPY_WRITE_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if (range != NULL)
+	{
+		std::memcpy(range, data, (size_t)size);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+	}
+	else
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::Upload(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size)
+{
+	if (size <= 0)
+		return;
+	GLintptr source = Allocate(size, 4);
+	if (source < 0)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return;
+	}
+
+	Write(source, data, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, ID.ID);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, offset, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StreamBuffer::EndFrame()
+{
+	fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	region = (region + 1) % STREAM_BUFFER_FRAMES;
+	head = (GLintptr)region * frameSize;
+	frame++;
+
+	if (fences[region] == NULL)
+		return;
+	// Only waits if the GPU is a whole ring of frames behind
+	if (glClientWaitSync(fences[region], 0, 0) == GL_TIMEOUT_EXPIRED)
+	{
+		stalls++;
+		glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+	}
+	glDeleteSync(fences[region]);
+	fences[region] = NULL;
+}
+
+void StreamBuffer::Delete()
+{
+	for (unsigned int i = 0; i < STREAM_BUFFER_FRAMES; i++)
+	{
+		if (fences[i] != NULL)
+			glDeleteSync(fences[i]);
+		fences[i] = NULL;
+	}
+	if (persistent)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ID.ID);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	mapped = NULL;
+	persistent = false;
+	ID.Reset();
+}
@@ -0,0 +1,80 @@
+// If STREAM_BUFFER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef STREAM_BUFFER_CLASS_H
+#define STREAM_BUFFER_CLASS_H
+
+#include<glad/glad.h>
+#include<cstddef>
+
+#include"GPUResources.h"
+
+
+// glad is generated for OpenGL 3.3, which doesn't include immutable buffer storage,
+// so the constants and function type of ARB_buffer_storage are declared here.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+
+// How many frames of data the ring holds. Three lets the CPU fill one frame while the
+// GPU still reads the two before it, like the FrameReader's pixel buffers.
+const unsigned int STREAM_BUFFER_FRAMES = 3;
+
+
+// The StreamBuffer is a ring for data that changes every frame, such as skin palettes
+// and vertices skinned on the CPU. It is one buffer split into a region per frame in
+// flight, and each frame's data is appended to its own region. When a frame is done a
+// fence goes behind it, and the region is only written again once the GPU passed that
+// fence, so writing never waits for draws still reading older data.
+// If the driver has glBufferStorage the whole buffer stays persistently mapped and
+// writing is a plain copy. Otherwise every write maps its range unsynchronized, which
+// the fences make just as safe.
+class StreamBuffer
+{
+public:
+	GPUHandle ID;
+	// Whether the buffer is persistently mapped
+	bool persistent = false;
+	// Frames ended so far. Data written in an earlier frame is gone.
+	unsigned long long frame = 0;
+	// Alignment the offset of a range bound to a uniform block needs
+	GLsizeiptr uniformAlignment = 256;
+	// Times EndFrame had to wait for the GPU, and writes that didn't fit in their region
+	unsigned int stalls = 0;
+	unsigned int overflows = 0;
+
+	// Creates a ring holding frameSize bytes for each frame in flight.
+	StreamBuffer(GLsizeiptr frameSize);
+
+	// Reserves size bytes of this frame's region, starting at a multiple of alignment.
+	// Returns their offset into the buffer, or -1 if the region is full.
+	GLintptr Allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+	// Copies size bytes of data to offset, inside a range Allocate returned this frame.
+	void Write(GLintptr offset, const void* data, GLsizeiptr size);
+
+	// Writes data over part of another buffer by streaming it and copying it across on
+	// the GPU, so the driver never waits for draws still reading the old contents.
+	// Falls back to glBufferSubData if this frame's region is full.
+	void Upload(GLuint buffer, GLintptr offset, const void* data, GLsizeiptr size);
+
+	// Fences the region this frame wrote and moves to the next one, waiting only if the
+	// GPU hasn't finished the frame that last wrote it. Call once at the end of every frame.
+	void EndFrame();
+
+	// Unmaps and deletes the buffer and the fences.
+	void Delete();
+
+private:
+	GLsizeiptr frameSize;
+	// The mapping of the whole buffer when it is persistent
+	char* mapped = NULL;
+	GLsync fences[STREAM_BUFFER_FRAMES] = {};
+	// Region of the current frame, and where its next allocation starts
+	unsigned int region = 0;
+	GLintptr head = 0;
+};
+
+#endif
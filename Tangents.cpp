@@ -0,0 +1,132 @@
+#include"Tangents.h"
+
+#include<cmath>
+#include<algorithm>
+#include<functional>
+
+// Triangles or vertices per job when tangents are generated in parallel
+const unsigned int TANGENT_BATCH = 4096;
+
+// Calls job over [0, count), in batches on the job system if it is worth it
+static void for_batches(unsigned int count, JobSystem* jobs, const std::function<void(unsigned int, unsigned int)>& job)
+{
+	if (jobs == NULL || jobs->Size() < 2 || count <= TANGENT_BATCH)
+	{
+		job(0, count);
+		return;
+	}
+	JobCounter counter;
+	jobs->ParallelFor(count, TANGENT_BATCH, job, counter);
+	jobs->Wait(counter);
+}
+
+void generate_tangents(const std::vector<GLuint>& indices, std::vector<Vertex>& vertices, JobSystem* jobs)
+{
+	unsigned int numTriangles = (unsigned int)indices.size() / 3;
+	unsigned int numVertices = (unsigned int)vertices.size();
+
+	// What every triangle adds to each of its corners. Triangles only write their own
+	// corners, so they can all be worked out at the same time.
+	std::vector<glm::vec3> cornerTangents(numTriangles * 3, glm::vec3(0.0f));
+	std::vector<glm::vec3> cornerBitangents(numTriangles * 3, glm::vec3(0.0f));
+	for_batches(numTriangles, jobs, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int t = begin; t < end; t++)
+		{
+			const GLuint* corner = &indices[t * 3];
+			if (corner[0] >= numVertices || corner[1] >= numVertices || corner[2] >= numVertices)
+				continue;
+
+			glm::vec3 p[3];
+			glm::vec2 st[3];
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				p[c] = vertices[corner[c]].position;
+				st[c] = TEXCOORD_ROTATION * vertices[corner[c]].texUV;
+			}
+
+			// Solve for the directions s and t grow in across the triangle.
+			// Triangles with collapsed texture coordinates don't have any.
+			glm::vec3 e1 = p[1] - p[0];
+			glm::vec3 e2 = p[2] - p[0];
+			glm::vec2 d1 = st[1] - st[0];
+			glm::vec2 d2 = st[2] - st[0];
+			float det = d1.x * d2.y - d2.x * d1.y;
+			if (std::fabs(det) < 1e-12f)
+				continue;
+			glm::vec3 tangent = (e1 * d2.y - e2 * d1.y) / det;
+			glm::vec3 bitangent = (e2 * d1.x - e1 * d2.x) / det;
+
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				glm::vec3 a = p[(c + 1) % 3] - p[c];
+				glm::vec3 b = p[(c + 2) % 3] - p[c];
+				float lengths = glm::length(a) * glm::length(b);
+				if (lengths <= 0.0f)
+					continue;
+				float angle = std::acos(glm::clamp(glm::dot(a, b) / lengths, -1.0f, 1.0f));
+
+				// Only the part of the tangent along the surface at this vertex counts
+				const glm::vec3& normal = vertices[corner[c]].normal;
+				glm::vec3 projected = tangent - normal * glm::dot(normal, tangent);
+				float length = glm::length(projected);
+				if (length > 0.0f)
+					cornerTangents[t * 3 + c] = projected / length * angle;
+				cornerBitangents[t * 3 + c] = bitangent * angle;
+			}
+		}
+	});
+
+	// List the corners of every vertex, grouped by vertex
+	std::vector<unsigned int> starts(numVertices + 1, 0);
+	for (unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		if (indices[i] < numVertices)
+			starts[indices[i] + 1]++;
+	}
+	for (unsigned int v = 0; v < numVertices; v++)
+		starts[v + 1] += starts[v];
+	std::vector<unsigned int> corners(starts[numVertices]);
+	std::vector<unsigned int> filled(starts.begin(), starts.end() - 1);
+	for (unsigned int i = 0; i < numTriangles * 3; i++)
+	{
+		if (indices[i] < numVertices)
+			corners[filled[indices[i]]++] = i;
+	}
+
+	// Add up the corners and make the sum perpendicular to the normal
+	for_batches(numVertices, jobs, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int v = begin; v < end; v++)
+		{
+			glm::vec3 tangent(0.0f);
+			glm::vec3 bitangent(0.0f);
+			for (unsigned int i = starts[v]; i < starts[v + 1]; i++)
+			{
+				tangent += cornerTangents[corners[i]];
+				bitangent += cornerBitangents[corners[i]];
+			}
+
+			glm::vec3 normal = vertices[v].normal;
+			tangent -= normal * glm::dot(normal, tangent);
+			if (glm::length(tangent) < 1e-8f)
+			{
+				// No usable texture direction, any direction along the surface will do
+				glm::vec3 axis = std::fabs(normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+				tangent = axis - normal * glm::dot(normal, axis);
+				if (glm::length(tangent) < 1e-8f)
+					tangent = axis;
+			}
+			tangent = glm::normalize(tangent);
+			float side = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+			vertices[v].tangent = glm::vec4(tangent, side);
+		}
+	});
+}
+
+glm::vec4 gltf_tangent(const glm::vec3& normal, const glm::vec4& tangent)
+{
+	// The rotation turns the file's u direction into -t and its v direction into s,
+	// so the new tangent is the file's bitangent reversed, on the other side of the normal
+	return glm::vec4(-tangent.w * glm::cross(normal, glm::vec3(tangent)), -tangent.w);
+}
@@ -0,0 +1,29 @@
+// If TANGENTS_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the functions during compilation.
+#ifndef TANGENTS_CLASS_H
+#define TANGENTS_CLASS_H
+
+#include<glm/glm.hpp>
+#include<vector>
+
+#include"VBO.h"
+#include"JobSystem.h"
+
+
+// default.vert rotates the texture coordinates before sampling, and the images are flipped
+// when they are loaded. Tangents have to follow the coordinates as they are sampled, so
+// they are built from texUV turned by this same matrix. Must match default.vert.
+const glm::mat2 TEXCOORD_ROTATION = glm::mat2(0.0f, -1.0f, 1.0f, 0.0f);
+
+// Generates the tangent of every vertex from the triangles around it, the way MikkTSpace
+// does: each triangle's texture direction is made perpendicular to the vertex normal and
+// weighted by the triangle's angle at that vertex, so how a surface is split into triangles
+// barely changes the result. The bitangent's side goes in w.
+// With a job system the triangles, and then the vertices, are processed in parallel batches.
+void generate_tangents(const std::vector<GLuint>& indices, std::vector<Vertex>& vertices, JobSystem* jobs = NULL);
+
+// Turns a glTF TANGENT, which follows the file's texture coordinates, into the tangent of
+// the rotated coordinates the shaders sample with.
+glm::vec4 gltf_tangent(const glm::vec3& normal, const glm::vec4& tangent);
+
+#endif
@@ -90,7 +90,7 @@ Texture::Texture(const char* image, const char* texType, GLuint slot)
 void Texture::texUnit(Shader& shader, const char* uniform, GLuint unit)
 {
 	// Get the location of the texture uniform inside the shader
-	GLuint texUni = glGetUniformLocation(shader.ID, uniform);
+	GLint texUni = shader.Uniform(uniform);
 
 	// Activate the shader program before modifying uniforms
 	shader.Activate();
@@ -0,0 +1,196 @@
+#include"TextureArray.h"
+#include"RenderStats.h"
+
+GLuint TextureArray::boundIDs[TEXTURE_ARRAY_TRACKED_UNITS] = { 0 };
+
+TextureArray::TextureArray(int width, int height, GLuint layers, bool streamed)
+{
+	// Store the size and layer count of the array
+	TextureArray::width = width;
+	TextureArray::height = height;
+	TextureArray::layers = layers;
+
+	// Count the levels of a full mip chain
+	levels = 1;
+	while ((width >> levels) > 0 || (height >> levels) > 0)
+		levels++;
+
+	// Generate a new OpenGL texture object and store its ID
+	texture = GPUHandle::Create(GPU_TEXTURE, VRAM_TEXTURES);
+	ID = texture.ID;
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+
+	// Use the same filtering and wrapping as the Texture class
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+	// Allocate level 0 for every layer, the data is uploaded later with SetLayer
+	if (!streamed)
+	{
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		texture.Resize(LevelBytes(0));
+	}
+
+	// Unbind the texture array to prevent accidental modification
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+TextureArray::TextureArray(const TextureArray& other)
+{
+	*this = other;
+}
+
+TextureArray& TextureArray::operator=(const TextureArray& other)
+{
+	ID = other.ID;
+	width = other.width;
+	height = other.height;
+	layers = other.layers;
+	levels = other.levels;
+	texture = other.texture.Share();
+	return *this;
+}
+
+void TextureArray::SetLayer(GLuint layer, unsigned char* bytes, int numColCh)
+{
+	// Pick the upload format depending on how many color channels the image has
+	GLenum format;
+	if (numColCh == 4) format = GL_RGBA;
+	else if (numColCh == 3) format = GL_RGB;
+	else if (numColCh == 1) format = GL_RED;
+	else throw std::invalid_argument("Automatic Texture type recognition failed");
+
+	if (layer >= layers)
+		throw std::invalid_argument("Texture array layer is out of range");
+
+	// Rows of RGB and RED images are not always 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	// Copy the image into its layer of level 0
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, format, GL_UNSIGNED_BYTE, bytes);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// The binding of the current unit changed behind the filter's back
+	ResetBindings();
+}
+
+void TextureArray::GenerateMipmaps()
+{
+	// Generate mipmaps for all layers at once
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	GLsizeiptr bytes = 0;
+	for (GLuint level = 0; level < levels; level++)
+		bytes += LevelBytes(level);
+	texture.Resize(bytes);
+
+	ResetBindings();
+}
+
+void TextureArray::AllocateLevel(GLuint level)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, std::max(width >> level, 1), std::max(height >> level, 1), layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	texture.Resize(texture.Bytes() + LevelBytes(level));
+
+	ResetBindings();
+}
+
+void TextureArray::FreeLevel(GLuint level)
+{
+	// Respecifying a level with zero size releases its storage
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	texture.Resize(texture.Bytes() - LevelBytes(level));
+
+	ResetBindings();
+}
+
+void TextureArray::SetLayerLevel(GLuint layer, GLuint level, unsigned char* rgba)
+{
+	if (layer >= layers || level >= levels)
+		throw std::invalid_argument("Texture array layer or level is out of range");
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, std::max(width >> level, 1), std::max(height >> level, 1), 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	ResetBindings();
+}
+
+void TextureArray::SetBaseLevel(GLuint level)
+{
+	// Only levels from the base level down to 1x1 have to exist for the array to be complete
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+	ResetBindings();
+}
+
+GLsizeiptr TextureArray::LevelBytes(GLuint level)
+{
+	return (GLsizeiptr)std::max(width >> level, 1) * std::max(height >> level, 1) * 4 * layers;
+}
+
+void TextureArray::Bind(GLuint unit)
+{
+	BindID(ID, unit);
+}
+
+void TextureArray::Delete()
+{
+	// Make sure the bind filter doesn't remember a deleted texture
+	for (GLuint i = 0; i < TEXTURE_ARRAY_TRACKED_UNITS; i++)
+	{
+		if (boundIDs[i] == ID)
+			boundIDs[i] = 0;
+	}
+
+	// The texture is deleted once no copy holds it and the GPU is done with it
+	texture.Reset();
+}
+
+void TextureArray::BindID(GLuint ID, GLuint unit)
+{
+	// Skip the bind if this array is already active on that unit
+	if (unit < TEXTURE_ARRAY_TRACKED_UNITS && boundIDs[unit] == ID)
+		return;
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, ID);
+	RenderStats::textureBinds++;
+
+	if (unit < TEXTURE_ARRAY_TRACKED_UNITS)
+		boundIDs[unit] = ID;
+}
+
+bool LayerImage::Info(int& width, int& height, int& numColCh) const
+{
+	if (encoded != NULL)
+		return stbi_info_from_memory(encoded->data(), (int)encoded->size(), &width, &height, &numColCh) != 0;
+	return stbi_info(file.c_str(), &width, &height, &numColCh) != 0;
+}
+
+unsigned char* LayerImage::Load(int& width, int& height, int& numColCh, int desiredChannels) const
+{
+	if (encoded != NULL)
+		return stbi_load_from_memory(encoded->data(), (int)encoded->size(), &width, &height, &numColCh, desiredChannels);
+	return stbi_load(file.c_str(), &width, &height, &numColCh, desiredChannels);
+}
+
+void TextureArray::ResetBindings()
+{
+	for (GLuint i = 0; i < TEXTURE_ARRAY_TRACKED_UNITS; i++)
+		boundIDs[i] = 0;
+}
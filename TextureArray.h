@@ -0,0 +1,116 @@
+// If TEXTURE_ARRAY_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef TEXTURE_ARRAY_CLASS_H
+#define TEXTURE_ARRAY_CLASS_H
+
+// Include OpenGL functionality and image loading support.
+#include<glad/glad.h>
+#include<stb/stb_image.h>
+#include<stdexcept>
+#include<algorithm>
+#include<string>
+#include<vector>
+#include<memory>
+
+#include"GPUResources.h"
+
+
+// Number of texture units tracked by the redundant bind filter.
+// Only the first few units are used by materials, so this stays small.
+const GLuint TEXTURE_ARRAY_TRACKED_UNITS = 16;
+
+
+// The image that goes into one layer of an array: an image file, or the encoded bytes
+// (PNG, JPEG, ...) of an image embedded in a model. Copies share the bytes.
+struct LayerImage
+{
+	// The path of the image file, or a name for embedded images to report errors with
+	std::string file;
+	std::shared_ptr<const std::vector<unsigned char>> encoded;
+
+	// Reads the size and channel count without decoding. Returns false if it can't be read.
+	bool Info(int& width, int& height, int& numColCh) const;
+
+	// Decodes the image with stbi_load, or stbi_load_from_memory for embedded ones.
+	// Returns NULL if it can't be decoded, otherwise free the pixels with stbi_image_free.
+	unsigned char* Load(int& width, int& height, int& numColCh, int desiredChannels) const;
+};
+
+
+// The TextureArray class holds many images of the same size and format
+// in a single GL_TEXTURE_2D_ARRAY. Each image lives in its own layer,
+// so materials only need a layer index instead of their own texture object.
+// Because many materials share one array, consecutive draws don't need to rebind textures.
+class TextureArray
+{
+public:
+	// The unique OpenGL ID reference for this texture array.
+	GLuint ID;
+
+	// The size shared by every layer in the array.
+	int width;
+	int height;
+
+	// The number of layers (images) the array can hold.
+	GLuint layers;
+
+	// The number of mip levels in a full chain, down to 1x1.
+	GLuint levels;
+
+	// Constructor that sets up an array for 'layers' images of width x height.
+	// All layers are stored as GL_RGBA8, the same format the Texture class uses.
+	// Unless streamed is true, level 0 is allocated right away so it can be filled
+	// with SetLayer and finished with GenerateMipmaps. Streamed arrays allocate
+	// nothing; the TextureStreamer allocates and frees single levels instead.
+	TextureArray(int width, int height, GLuint layers, bool streamed = false);
+
+	// Copies share the texture, which is deleted once the last copy is gone.
+	TextureArray(const TextureArray& other);
+	TextureArray& operator=(const TextureArray& other);
+	TextureArray(TextureArray&& other) = default;
+	TextureArray& operator=(TextureArray&& other) = default;
+
+	// Uploads decoded image bytes into the given layer.
+	// numColCh is the channel count reported by stb_image (1, 3, or 4).
+	void SetLayer(GLuint layer, unsigned char* bytes, int numColCh);
+
+	// Generates mipmaps for every layer once all layers have been uploaded.
+	void GenerateMipmaps();
+
+	// Allocates storage for one mip level of every layer, without any data.
+	void AllocateLevel(GLuint level);
+
+	// Releases the storage of one mip level so its memory can be reused.
+	void FreeLevel(GLuint level);
+
+	// Uploads RGBA8 pixels into one mip level of one layer.
+	void SetLayerLevel(GLuint layer, GLuint level, unsigned char* rgba);
+
+	// Makes 'level' the finest mip level sampled, levels above it may be unallocated.
+	void SetBaseLevel(GLuint level);
+
+	// Returns how many bytes one mip level takes for all layers together.
+	GLsizeiptr LevelBytes(GLuint level);
+
+	// Binds this texture array to the given texture unit.
+	void Bind(GLuint unit);
+
+	// Lets go of this copy's share of the texture, which is deleted if no other copy holds it.
+	void Delete();
+
+	// Binds a texture array by ID, skipping the call if it is already bound to that unit.
+	// Mesh::Draw goes through this so draws that share arrays cause no texture state changes.
+	static void BindID(GLuint ID, GLuint unit);
+
+	// Forgets which arrays are bound, for example after other code changed texture bindings.
+	static void ResetBindings();
+
+private:
+	// Owns the texture and counts its allocated levels in the VRAM ledger
+	GPUHandle texture;
+
+	// The texture array currently bound to each tracked texture unit.
+	static GLuint boundIDs[TEXTURE_ARRAY_TRACKED_UNITS];
+};
+
+#endif
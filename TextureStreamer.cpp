@@ -0,0 +1,305 @@
+#include"TextureStreamer.h"
+
+#include<iostream>
+#include<cmath>
+#include<algorithm>
+
+TextureStreamer::TextureStreamer(GLsizeiptr budgetBytes, GLsizeiptr uploadBytesPerFrame)
+{
+	TextureStreamer::budgetBytes = budgetBytes;
+	TextureStreamer::uploadBytesPerFrame = uploadBytesPerFrame;
+}
+
+void TextureStreamer::Register(TextureArray& array, std::vector<LayerImage> layerImages)
+{
+	StreamedArray streamed(array);
+	streamed.layerImages = layerImages;
+
+	// The tail starts at the first level that fits in TEXTURE_STREAM_TAIL_SIZE
+	streamed.tailLevel = 0;
+	while (std::max(array.width, array.height) >> streamed.tailLevel > TEXTURE_STREAM_TAIL_SIZE)
+		streamed.tailLevel++;
+
+	streamed.residentLevel = streamed.tailLevel;
+	streamed.requestedLevel = streamed.tailLevel;
+	streamed.targetLevel = streamed.tailLevel;
+	streamed.priority = 0.0f;
+	streamed.framesUnused = 0;
+	streamed.decoded.resize(array.layers);
+	streamed.tailReady.resize(array.layers, false);
+	streamed.decodesPending = 0;
+	streamed.registration = ++registrations;
+
+	// Allocate the tail and fill it with gray so the array can be sampled before any image is decoded
+	for (GLuint level = streamed.tailLevel; level < array.levels; level++)
+	{
+		array.AllocateLevel(level);
+		std::vector<unsigned char> gray(array.LevelBytes(level) / array.layers, 128);
+		for (unsigned int i = 3; i < gray.size(); i += 4)
+			gray[i] = 255;
+		for (GLuint layer = 0; layer < array.layers; layer++)
+			array.SetLayerLevel(layer, level, gray.data());
+	}
+	array.SetBaseLevel(streamed.tailLevel);
+
+	auto inserted = arrays.insert(std::make_pair(array.ID, streamed));
+	decodeMissing(inserted.first->second);
+}
+
+void TextureStreamer::Unregister(GLuint arrayID)
+{
+	arrays.erase(arrayID);
+}
+
+void TextureStreamer::Request(GLuint arrayID, float screenPixels)
+{
+	auto it = arrays.find(arrayID);
+	if (it == arrays.end())
+		return;
+	StreamedArray& streamed = it->second;
+
+	// A texture needs roughly one texel per covered pixel, so every halving
+	// of the covered size lets the draw use one coarser level
+	float texels = (float)std::max(streamed.array.width, streamed.array.height);
+	float ratio = texels / std::max(screenPixels, 1.0f);
+	GLuint level = ratio > 1.0f ? (GLuint)std::floor(std::log2(ratio)) : 0;
+
+	// The first request of a frame replaces the level of the last frame it was drawn in
+	streamed.requestedLevel = streamed.priority > 0.0f ? std::min(streamed.requestedLevel, level) : level;
+	streamed.priority = std::max(streamed.priority, screenPixels);
+}
+
+void TextureStreamer::Update()
+{
+	// Pick up the images the workers finished since the last frame
+	std::vector<FinishedDecode> ready;
+	{
+		std::lock_guard<std::mutex> lock(finishedMutex);
+		ready.swap(finished);
+	}
+	for (unsigned int i = 0; i < ready.size(); i++)
+	{
+		auto it = arrays.find(ready[i].arrayID);
+		if (it == arrays.end() || it->second.registration != ready[i].registration)
+			continue;
+		StreamedArray& streamed = it->second;
+
+		streamed.decoded[ready[i].layer] = ready[i].image;
+		streamed.decodesPending--;
+
+		// The first time a layer is decoded its gray tail is replaced right away
+		if (!streamed.tailReady[ready[i].layer])
+			uploadTail(streamed, ready[i].layer);
+	}
+
+	// Sort the arrays so the most visible ones get the budget and uploads first
+	std::vector<StreamedArray*> order;
+	for (auto& pair : arrays)
+	{
+		StreamedArray& streamed = pair.second;
+		streamed.framesUnused = streamed.priority > 0.0f ? 0 : streamed.framesUnused + 1;
+		order.push_back(&streamed);
+	}
+	std::sort(order.begin(), order.end(), [](StreamedArray* a, StreamedArray* b) { return a->priority > b->priority; });
+
+	// Give each array the finest level it asked for that still fits in the budget.
+	// Tails are always kept, so they count against the budget even when over it.
+	GLsizeiptr used = 0;
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		StreamedArray& streamed = *order[i];
+		GLuint level = std::min(streamed.requestedLevel, streamed.tailLevel);
+		while (level < streamed.tailLevel && used + chainBytes(streamed, level) > budgetBytes)
+			level++;
+		used += chainBytes(streamed, level);
+		streamed.targetLevel = level;
+	}
+
+	// Evict before uploading so the new levels have room
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		StreamedArray& streamed = *order[i];
+		if (streamed.residentLevel >= streamed.targetLevel)
+			continue;
+
+		// Raise the base level first so the levels are no longer sampled when they go away
+		streamed.array.SetBaseLevel(streamed.targetLevel);
+		while (streamed.residentLevel < streamed.targetLevel)
+			streamed.array.FreeLevel(streamed.residentLevel++);
+	}
+
+	// Upload finer levels, one level of a whole array at a time, until the frame's upload budget is used
+	GLsizeiptr uploaded = 0;
+	for (unsigned int i = 0; i < order.size(); i++)
+	{
+		StreamedArray& streamed = *order[i];
+
+		// Arrays that have what they need drop their decoded images to save memory
+		if (streamed.residentLevel <= streamed.targetLevel)
+		{
+			bool allTails = std::find(streamed.tailReady.begin(), streamed.tailReady.end(), false) == streamed.tailReady.end();
+			if (streamed.decodesPending == 0 && allTails)
+			{
+				for (unsigned int j = 0; j < streamed.decoded.size(); j++)
+					streamed.decoded[j].reset();
+			}
+			continue;
+		}
+
+		// Every layer has to be decoded before a level can be made resident
+		bool allDecoded = true;
+		for (unsigned int j = 0; j < streamed.decoded.size(); j++)
+			allDecoded = allDecoded && streamed.decoded[j] != NULL;
+		if (!allDecoded)
+		{
+			if (streamed.decodesPending == 0)
+				decodeMissing(streamed);
+			continue;
+		}
+
+		bool changed = false;
+		while (streamed.residentLevel > streamed.targetLevel && uploaded < uploadBytesPerFrame)
+		{
+			GLuint level = streamed.residentLevel - 1;
+			streamed.array.AllocateLevel(level);
+			for (GLuint layer = 0; layer < streamed.array.layers; layer++)
+				streamed.array.SetLayerLevel(layer, level, streamed.decoded[layer]->mips[level].data());
+
+			streamed.residentLevel = level;
+			uploaded += streamed.array.LevelBytes(level);
+			changed = true;
+		}
+		if (changed)
+			streamed.array.SetBaseLevel(streamed.residentLevel);
+	}
+
+	// Start collecting the requests of the next frame. Arrays keep the level they were last
+	// drawn with for a while, so one that leaves the view briefly isn't decoded again,
+	// and only drop back to their tail once they have gone unused for long enough.
+	for (auto& pair : arrays)
+	{
+		StreamedArray& streamed = pair.second;
+		if (streamed.framesUnused > TEXTURE_STREAM_UNUSED_FRAMES)
+			streamed.requestedLevel = streamed.tailLevel;
+		streamed.priority = 0.0f;
+	}
+}
+
+GLsizeiptr TextureStreamer::ResidentBytes()
+{
+	GLsizeiptr bytes = 0;
+	for (auto& pair : arrays)
+		bytes += chainBytes(pair.second, pair.second.residentLevel);
+	return bytes;
+}
+
+bool TextureStreamer::Idle()
+{
+	for (auto& pair : arrays)
+	{
+		StreamedArray& streamed = pair.second;
+		if (streamed.decodesPending > 0 || streamed.residentLevel > streamed.targetLevel)
+			return false;
+		if (std::find(streamed.tailReady.begin(), streamed.tailReady.end(), false) != streamed.tailReady.end())
+			return false;
+	}
+	return true;
+}
+
+void TextureStreamer::Delete()
+{
+	for (auto& pair : arrays)
+		pair.second.array.Delete();
+	arrays.clear();
+}
+
+void TextureStreamer::decodeMissing(StreamedArray& streamed)
+{
+	for (GLuint layer = 0; layer < streamed.array.layers; layer++)
+	{
+		if (streamed.decoded[layer] != NULL)
+			continue;
+
+		streamed.decodesPending++;
+
+		// Copy everything the worker needs, the StreamedArray may move while it runs
+		GLuint arrayID = streamed.array.ID;
+		unsigned int registration = streamed.registration;
+		LayerImage source = streamed.layerImages[layer];
+		int width = streamed.array.width;
+		int height = streamed.array.height;
+		workers.Submit([this, arrayID, registration, layer, source, width, height]
+		{
+			std::shared_ptr<DecodedImage> image = decodeImage(source, width, height);
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			finished.push_back(FinishedDecode{ arrayID, registration, layer, image });
+		});
+	}
+}
+
+void TextureStreamer::uploadTail(StreamedArray& streamed, GLuint layer)
+{
+	for (GLuint level = streamed.tailLevel; level < streamed.array.levels; level++)
+		streamed.array.SetLayerLevel(layer, level, streamed.decoded[layer]->mips[level].data());
+	streamed.tailReady[layer] = true;
+}
+
+GLsizeiptr TextureStreamer::chainBytes(StreamedArray& streamed, GLuint level)
+{
+	GLsizeiptr bytes = 0;
+	for (GLuint i = level; i < streamed.array.levels; i++)
+		bytes += streamed.array.LevelBytes(i);
+	return bytes;
+}
+
+std::shared_ptr<TextureStreamer::DecodedImage> TextureStreamer::decodeImage(const LayerImage& source, int width, int height)
+{
+	std::shared_ptr<DecodedImage> image = std::make_shared<DecodedImage>();
+
+	// Decode as RGBA so every level has the same layout, flipped like the Texture class does
+	stbi_set_flip_vertically_on_load_thread(true);
+	int widthImg, heightImg, numColCh;
+	unsigned char* bytes = source.Load(widthImg, heightImg, numColCh, 4);
+
+	// A missing or resized image can't be thrown across threads, so it streams in as flat gray
+	std::vector<unsigned char> level0((size_t)width * height * 4, 128);
+	if (bytes != NULL && widthImg == width && heightImg == height)
+		std::copy(bytes, bytes + level0.size(), level0.begin());
+	else
+		std::cout << "TEXTURE_STREAMING_ERROR for: " << source.file << std::endl;
+	if (bytes != NULL)
+		stbi_image_free(bytes);
+	image->mips.push_back(std::move(level0));
+
+	// Build the rest of the chain with a 2x2 box filter, clamping at odd edges
+	int w = width;
+	int h = height;
+	while (w > 1 || h > 1)
+	{
+		int nw = std::max(w >> 1, 1);
+		int nh = std::max(h >> 1, 1);
+		std::vector<unsigned char>& src = image->mips.back();
+		std::vector<unsigned char> dst((size_t)nw * nh * 4);
+		for (int y = 0; y < nh; y++)
+		{
+			int y0 = std::min(y * 2, h - 1);
+			int y1 = std::min(y * 2 + 1, h - 1);
+			for (int x = 0; x < nw; x++)
+			{
+				int x0 = std::min(x * 2, w - 1);
+				int x1 = std::min(x * 2 + 1, w - 1);
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = src[((size_t)y0 * w + x0) * 4 + c] + src[((size_t)y0 * w + x1) * 4 + c]
+						+ src[((size_t)y1 * w + x0) * 4 + c] + src[((size_t)y1 * w + x1) * 4 + c];
+					dst[((size_t)y * nw + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+		image->mips.push_back(std::move(dst));
+		w = nw;
+		h = nh;
+	}
+
+	return image;
+}
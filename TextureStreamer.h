@@ -0,0 +1,138 @@
+// If TEXTURE_STREAMER_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef TEXTURE_STREAMER_CLASS_H
+#define TEXTURE_STREAMER_CLASS_H
+
+#include<string>
+#include<vector>
+#include<memory>
+#include<mutex>
+#include<unordered_map>
+
+#include"TextureArray.h"
+#include"ThreadPool.h"
+
+
+// Largest size (in texels) of the mip tail that is made resident as soon as
+// an image is decoded. Everything finer than this is streamed in on demand.
+const int TEXTURE_STREAM_TAIL_SIZE = 64;
+
+// Number of frames an array may go without being drawn before it drops back to its tail.
+const unsigned int TEXTURE_STREAM_UNUSED_FRAMES = 120;
+
+
+// The TextureStreamer makes texture arrays resident progressively instead of
+// blocking until every image is decoded at full resolution.
+// When an array is registered only a small gray mip tail is allocated, so the scene
+// can be drawn right away. Images are decoded and mipmapped on worker threads,
+// the tail is filled in as soon as each image is ready, and finer levels are
+// uploaded a few at a time in Update(), most visible arrays first.
+// Arrays that drop in priority give back their finest levels whenever the
+// resident total would exceed the VRAM budget.
+class TextureStreamer
+{
+public:
+	// Creates a streamer that keeps resident texture memory under budgetBytes
+	// and uploads at most uploadBytesPerFrame of texel data per Update() call.
+	TextureStreamer(GLsizeiptr budgetBytes = 256 << 20, GLsizeiptr uploadBytesPerFrame = 8 << 20);
+
+	// Starts streaming an array. layerImages holds the image of every layer.
+	void Register(TextureArray& array, std::vector<LayerImage> layerImages);
+
+	// Stops streaming an array and lets go of the streamer's copy of it. Decodes still
+	// running for it are thrown away when they finish.
+	void Unregister(GLuint arrayID);
+
+	// Reports that a draw using this array covers screenPixels pixels on screen this frame.
+	// The finest level an array needs and its priority come from the largest report.
+	void Request(GLuint arrayID, float screenPixels);
+
+	// Collects finished decodes, applies the budget, evicts and uploads levels.
+	// Must be called once per frame on the thread that owns the GL context.
+	void Update();
+
+	// Returns the bytes of texture memory currently held by streamed arrays.
+	GLsizeiptr ResidentBytes();
+
+	// Returns true once every registered array has reached the level it asked for.
+	bool Idle();
+
+	// Deletes every registered array.
+	void Delete();
+
+	// The memory limit for resident texture levels, can be changed at runtime.
+	GLsizeiptr budgetBytes;
+	// How many bytes of texel data may be uploaded per frame.
+	GLsizeiptr uploadBytesPerFrame;
+
+private:
+	// One image decoded on a worker thread, with its full RGBA8 mip chain.
+	struct DecodedImage
+	{
+		std::vector<std::vector<unsigned char>> mips;
+	};
+
+	// Everything the streamer tracks for one texture array.
+	struct StreamedArray
+	{
+		TextureArray array;
+		std::vector<LayerImage> layerImages;
+		// Coarsest level that is made resident on load (the mip tail starts here).
+		GLuint tailLevel = 0;
+		// Finest level currently allocated and filled for every layer.
+		GLuint residentLevel = 0;
+		// Finest level requested by the draws of the last frame the array was drawn in,
+		// kept until it goes TEXTURE_STREAM_UNUSED_FRAMES without a draw.
+		GLuint requestedLevel = 0;
+		// Largest screen coverage requested since the last Update(), 0 if it wasn't drawn.
+		float priority = 0.0f;
+		// Level the array is heading to after the last Update() applied the budget.
+		GLuint targetLevel = 0;
+		// Number of frames since a draw last requested this array.
+		unsigned int framesUnused = 0;
+		// Decoded images per layer, empty once the array has what it needs.
+		std::vector<std::shared_ptr<DecodedImage>> decoded;
+		// Whether the tail of each layer has been filled in yet.
+		std::vector<bool> tailReady;
+		// Number of layers currently being decoded on a worker.
+		unsigned int decodesPending = 0;
+		// Tells this registration apart from an earlier array that had the same ID.
+		unsigned int registration = 0;
+
+		// Shares the texture of array, TextureArray has no empty state to start from.
+		StreamedArray(const TextureArray& array) : array(array) {}
+	};
+
+	// A decode that finished on a worker and waits to be picked up by Update().
+	struct FinishedDecode
+	{
+		GLuint arrayID;
+		unsigned int registration;
+		GLuint layer;
+		std::shared_ptr<DecodedImage> image;
+	};
+
+	std::unordered_map<GLuint, StreamedArray> arrays;
+	// Registrations so far, deleted textures' IDs are handed out again
+	unsigned int registrations = 0;
+
+	std::mutex finishedMutex;
+	std::vector<FinishedDecode> finished;
+
+	// Declared last so the workers are joined before the members they write to go away.
+	ThreadPool workers;
+
+	// Queues decodes for every layer of an array that doesn't have decoded data.
+	void decodeMissing(StreamedArray& streamed);
+
+	// Uploads the mip tail of one layer from its decoded image.
+	void uploadTail(StreamedArray& streamed, GLuint layer);
+
+	// Bytes the levels from 'level' down to 1x1 take for an array.
+	GLsizeiptr chainBytes(StreamedArray& streamed, GLuint level);
+
+	// Decodes an image and builds its RGBA8 mip chain (runs on a worker).
+	static std::shared_ptr<DecodedImage> decodeImage(const LayerImage& source, int width, int height);
+};
+
+#endif
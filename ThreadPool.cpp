@@ -0,0 +1,61 @@
+#include"ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+	// Leave one hardware thread for the render loop
+	if (numThreads == 0)
+	{
+		unsigned int hardware = std::thread::hardware_concurrency();
+		numThreads = hardware > 1 ? hardware - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < numThreads; i++)
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+	// Tell the workers to finish the queue and exit
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push(std::move(job));
+	}
+	wake.notify_one();
+}
+
+unsigned int ThreadPool::Size()
+{
+	return (unsigned int)workers.size();
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+
+		// Sleep until there is a job or the pool is shutting down
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (jobs.empty())
+				return;
+			job = std::move(jobs.front());
+			jobs.pop();
+		}
+
+		job();
+	}
+}
@@ -0,0 +1,45 @@
+// If THREAD_POOL_CLASS_H is not yet defined, define it.
+// This prevents multiple definitions of the class during compilation.
+#ifndef THREAD_POOL_CLASS_H
+#define THREAD_POOL_CLASS_H
+
+#include<thread>
+#include<mutex>
+#include<condition_variable>
+#include<functional>
+#include<queue>
+#include<vector>
+
+
+// The ThreadPool class keeps a fixed set of worker threads alive and
+// runs submitted jobs on them in the order they were submitted.
+// Workers never touch OpenGL, jobs only do CPU work such as decoding images;
+// results are handed back to the render thread, which owns the GL context.
+class ThreadPool
+{
+public:
+	// Starts numThreads workers. 0 means one worker per hardware thread minus one,
+	// leaving a core free for the render thread.
+	ThreadPool(unsigned int numThreads = 0);
+
+	// Waits for the queued jobs to finish and joins all workers.
+	~ThreadPool();
+
+	// Queues a job to be run on the next free worker.
+	void Submit(std::function<void()> job);
+
+	// Returns how many worker threads the pool runs.
+	unsigned int Size();
+
+private:
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	// Loop every worker runs, taking jobs off the queue until the pool stops.
+	void workerLoop();
+};
+
+#endif
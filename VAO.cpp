@@ -1,5 +1,6 @@
 // Header is included.
 #include"VAO.h"
+#include"RenderStats.h"
 
 // mycoolclass::dosomething()
 // This means the function dosomething() belongs to the mycoolclass class.
@@ -61,6 +62,7 @@ void VAO::Bind()
 	// The VAO already exists here, we don't have to write into int, so we just
 	// need ID, not &ID. Here, we are just making this VAO active.
 	glBindVertexArray(ID);
+	RenderStats::vertexArrayBinds++;
 }
 
 // Unbinds the VAO
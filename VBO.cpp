@@ -14,6 +14,22 @@ VBO::VBO(std::vector<Vertex>& vertices)
 	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 }
 
+// Constructor that creates a VBO holding only vertex positions.
+VBO::VBO(std::vector<glm::vec3>& positions)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+}
+
+// Constructor that creates a VBO holding the joints and weights of a skinned mesh.
+VBO::VBO(std::vector<SkinVertex>& skin)
+{
+	glGenBuffers(1, &ID);
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	glBufferData(GL_ARRAY_BUFFER, skin.size() * sizeof(SkinVertex), skin.data(), GL_STATIC_DRAW);
+}
+
 // Bind the VBO so it becomes the current active array buffer
 void VBO::Bind()
 {
@@ -40,6 +40,19 @@ struct Vertex
 	// literally the normal for a single vertex in space, it would be undefined and meaningless.
 	glm::vec3 color;
 	glm::vec2 texUV;
+	// Direction the texture's u coordinate grows along the surface, for normal maps.
+	// w is 1 or -1, the side of the normal the bitangent (v direction) is on.
+	glm::vec4 tangent;
+};
+
+// The joints that move a vertex of a skinned mesh and how much each one counts.
+// Kept in a buffer of its own, so meshes without a skin don't carry it around.
+struct SkinVertex
+{
+	// Indices into the skin's joint list, stored as floats so they load like any other attribute
+	glm::vec4 joints;
+	// Adds up to 1, unused joints have a weight of 0
+	glm::vec4 weights;
 };
 
 
@@ -54,6 +67,11 @@ public:
 	// Declares a constructor which needs a reference to a vector list
 	// that contains Vertex objects, and the param is called vertices.
 	VBO(std::vector<Vertex>& vertices);
+	// Same as above, but for a tightly packed list of positions only.
+	// Used by passes that only need depth, so they read less memory per vertex.
+	VBO(std::vector<glm::vec3>& positions);
+	// Same as above, for the joints and weights of a skinned mesh.
+	VBO(std::vector<SkinVertex>& skin);
 
 	// Declare functions to be defined in the .cpp file.
 	void Bind();
@@ -9,97 +9,157 @@ in vec3 Normal;
 in vec3 color;
 in vec2 texCoord;
 
-// Texture units passed from the main program
-uniform sampler2D diffuse0;
-uniform sampler2D specular0;
-
-// Light and camera information
-uniform vec4 lightColor;
-uniform vec3 lightPos;
-uniform vec3 camPos;
-
-vec4 pointLight()
-{	
-	// Vector from the fragment to the light source
-	vec3 lightVec = lightPos - crntPos;
-
-	// Calculate light intensity based on distance
-	float dist = length(lightVec);
-	float a = 3.0;
-	float b = 0.7;
-	float inten = 1.0f / (a * dist * dist + b * dist + 1.0f);
-
-	// Ambient light (base brightness)
-	float ambient = 0.20f;
-
-	// Diffuse lighting (brightness based on angle)
-	vec3 normal = normalize(Normal);
-	vec3 lightDirection = normalize(lightVec);
-	float diffuse = max(dot(normal, lightDirection), 0.0f);
-
-	// Specular lighting (reflective highlights)
-	float specularLight = 0.50f;
-	vec3 viewDirection = normalize(camPos - crntPos);
-	vec3 reflectionDirection = reflect(-lightDirection, normal);
-	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
-	float specular = specAmount * specularLight;
-
-	// Combine ambient, diffuse, and specular lighting with textures
-	return (texture(diffuse0, texCoord) * (diffuse * inten + ambient) + texture(specular0, texCoord).r * specular * inten) * lightColor;
+// Texture arrays passed from the main program
+uniform sampler2DArray diffuse0;
+uniform sampler2DArray specular0;
+
+#ifdef NORMAL_MAP
+// Tangent from the Vertex Shader, with the bitangent's side in w
+in vec4 Tangent;
+// Texture array holding the material's tangent space normal map
+uniform sampler2DArray normal0;
+#endif
+
+// Texture layers and alpha cutoff of one material, matches MaterialData in Material.h
+struct MaterialData
+{
+	int diffuseLayer;
+	int specularLayer;
+	float alphaCutoff;
+	int normalLayer;
+	float normalScale;
+};
+
+// Every material in the model
+layout (std140) uniform Materials
+{
+	MaterialData materials[256];
+};
+// Row of the material table used by the current mesh
+uniform int materialIndex;
+
+#ifdef PBR
+// Texture arrays holding the material's occlusion and emissive layers
+uniform sampler2DArray occlusion0;
+uniform sampler2DArray emissive0;
+
+// Factors and the other layers of one material, matches PBRMaterialData in Material.h
+struct PBRMaterialData
+{
+	vec4 baseColorFactor;
+	vec3 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float occlusionStrength;
+	int occlusionLayer;
+	int emissiveLayer;
+};
+
+// The PBR factors of every material in the model, same rows as Materials
+layout (std140) uniform PBRMaterials
+{
+	PBRMaterialData pbrMaterials[256];
+};
+#endif
+
+// Samples the diffuse layer of the current material
+vec4 diffuseTex()
+{
+	return texture(diffuse0, vec3(texCoord, materials[materialIndex].diffuseLayer));
 }
 
-vec4 direcLight()
+// Samples the specular layer of the current material
+float specularTex()
 {
-	// Ambient light
-	float ambient = 0.20f;
+	return texture(specular0, vec3(texCoord, materials[materialIndex].specularLayer)).r;
+}
 
-	// Diffuse lighting
+// Returns the normal the light sees, the interpolated one bent by the normal map if there is one
+vec3 surfaceNormal()
+{
 	vec3 normal = normalize(Normal);
-	vec3 lightDirection = normalize(vec3(1.0f, 1.0f, 0.0f));
-	float diffuse = max(dot(normal, lightDirection), 0.0f);
-
-	// Specular lighting
-	float specularLight = 0.50f;
-	vec3 viewDirection = normalize(camPos - crntPos);
-	vec3 reflectionDirection = reflect(-lightDirection, normal);
-	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
-	float specular = specAmount * specularLight;
-
-	// Combine lighting and textures
-	return (texture(diffuse0, texCoord) * (diffuse + ambient) + texture(specular0, texCoord).r * specular) * lightColor;
+#ifdef NORMAL_MAP
+	// Only the tangent is interpolated. Making it perpendicular to the normal again and
+	// crossing the two gives the bitangent, so the frame stays orthonormal for a varying less.
+	vec3 tangent = normalize(Tangent.xyz - normal * dot(normal, Tangent.xyz));
+	vec3 bitangent = cross(normal, tangent) * Tangent.w;
+	vec3 mapped = texture(normal0, vec3(texCoord, materials[materialIndex].normalLayer)).xyz * 2.0f - 1.0f;
+	mapped.xy *= materials[materialIndex].normalScale;
+	normal = normalize(tangent * mapped.x + bitangent * mapped.y + normal * mapped.z);
+#endif
+	return normal;
 }
 
-vec4 spotLight()
+// The rest of the surface lighting.glsl asks for
+vec3 surfacePosition()
 {
-	// Defines the sharpness and size of the light cone
-	float outerCone = 0.90f;
-	float innerCone = 0.95f;
+	return crntPos;
+}
 
-	// Ambient lighting
-	float ambient = 0.20f;
+float fragmentDepth()
+{
+	return gl_FragCoord.z;
+}
 
-	// Diffuse lighting
-	vec3 normal = normalize(Normal);
-	vec3 lightDirection = normalize(lightPos - crntPos);
-	float diffuse = max(dot(normal, lightDirection), 0.0f);
-
-	// Specular lighting
-	float specularLight = 0.50f;
-	vec3 viewDirection = normalize(camPos - crntPos);
-	vec3 reflectionDirection = reflect(-lightDirection, normal);
-	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
-	float specular = specAmount * specularLight;
-
-	// Determine how strongly the fragment is lit based on its angle inside the cone
-	float angle = dot(vec3(0.0f, -1.0f, 0.0f), -lightDirection);
-	float inten = clamp((angle - outerCone) / (innerCone - outerCone), 0.0f, 1.0f);
-
-	// Combine textures with lighting values
-	return (texture(diffuse0, texCoord) * (diffuse * inten + ambient) + texture(specular0, texCoord).r * specular * inten) * lightColor;
+#ifdef PBR
+// Reads the surface from the material's textures and factors, once for all the lights
+void loadSurface()
+{
+	PBRMaterialData material = pbrMaterials[materialIndex];
+
+	// Base color and emission are stored as sRGB, glTF keeps roughness in green and metalness in blue
+	baseColor = pow(diffuseTex().rgb, vec3(2.2f)) * material.baseColorFactor.rgb;
+	vec4 metallicRoughness = texture(specular0, vec3(texCoord, materials[materialIndex].specularLayer));
+	roughness = clamp(metallicRoughness.g * material.roughnessFactor, 0.04f, 1.0f);
+	metallic = clamp(metallicRoughness.b * material.metallicFactor, 0.0f, 1.0f);
+
+	// Materials without these textures skip the lookups
+	occlusion = 1.0f;
+	if (material.occlusionLayer >= 0)
+		occlusion += material.occlusionStrength * (texture(occlusion0, vec3(texCoord, material.occlusionLayer)).r - 1.0f);
+	emissive = material.emissiveFactor;
+	if (material.emissiveLayer >= 0)
+		emissive *= pow(texture(emissive0, vec3(texCoord, material.emissiveLayer)).rgb, vec3(2.2f));
+
+	surfaceN = surfaceNormal();
+	surfaceV = normalize(camPos - crntPos);
 }
+#endif
 
 void main()
 {
-	// Output the final fragment color using directional lighting
-	FragColor = direcLight();
+	// Masked materials drop the fragments their base color marks as cut out
+#ifdef ALPHA_TEST
+	float alpha = diffuseTex().a;
+#ifdef PBR
+	alpha *= pbrMaterials[materialIndex].baseColorFactor.a;
+#endif
+	if (alpha < materials[materialIndex].alphaCutoff)
+		discard;
+#endif
+
+	// Add up the light types this variant was compiled with,
+	// lights that aren't defined cost nothing
+	FragColor = vec4(0.0f);
+#ifdef PBR
+	// PBR surfaces are lit by the environment and give off their own light, once per fragment
+	loadSurface();
+	FragColor.rgb = environmentLight() + emissive;
+#endif
+#ifdef DIRECTIONAL_LIGHT
+	FragColor += direcLight();
+#endif
+#ifdef POINT_LIGHT
+	FragColor += pointLight();
+#endif
+#ifdef SPOT_LIGHT
+	FragColor += spotLight();
+#endif
+#ifdef CLUSTERED_LIGHTS
+	FragColor += clusteredLights();
+#endif
+#ifdef PBR
+	// The lights add up in linear color, the framebuffer is shown as sRGB
+	FragColor = vec4(pow(FragColor.rgb, vec3(1.0f / 2.2f)), 1.0f);
+#endif
 }
@@ -18,6 +18,10 @@ out vec3 color;
 // Passes the texture coordinates to the Fragment Shader
 out vec2 texCoord;
 
+// The depth pre-pass draws the same positions with depth.vert and tests them with GL_EQUAL,
+// so both shaders must compute gl_Position exactly the same way
+invariant gl_Position;
+
 // Camera matrix used for transforming vertices into view space
 uniform mat4 camMatrix;
 
@@ -27,13 +31,77 @@ uniform mat4 translation;
 uniform mat4 rotation;
 uniform mat4 scale;
 
+#ifdef SKINNING
+// Up to four joints move the vertex, each by its weight
+layout (location = 4) in vec4 aJoints;
+layout (location = 5) in vec4 aWeights;
+
+// Must match MAX_SKIN_JOINTS in Skin.h
+#define MAX_JOINTS 128
+// World matrix times inverse bind matrix of every joint of the skin being drawn
+layout (std140) uniform Skin
+{
+	mat4 joints[MAX_JOINTS];
+};
+#endif
+
+#ifdef MORPHING
+// Where the deltas of each vertex start in morphDeltas and how many there are
+uniform usamplerBuffer morphRanges;
+// Two texels per delta, the position delta with the index of its target in w, then the normal delta.
+// Only the vertices a target moves have deltas.
+uniform samplerBuffer morphDeltas;
+
+// Must match MAX_MORPH_TARGETS in Morph.h
+#define MAX_MORPH_TARGETS 64
+// Weight of every target of the mesh being drawn
+uniform float morphWeights[MAX_MORPH_TARGETS];
+#endif
+
+#ifdef NORMAL_MAP
+// Tangent of the vertex, with the side of the normal its bitangent is on in w
+layout (location = 6) in vec4 aTangent;
+// Passes the tangent to the Fragment Shader, which builds the bitangent from it and the normal
+out vec4 Tangent;
+#endif
+
 void main()
 {
-	// Calculate the current world-space position of the vertex
-	crntPos = vec3(model * translation * -rotation * scale * vec4(aPos, 1.0f));
+	vec3 localPos = aPos;
+	vec3 localNormal = aNormal;
+#ifdef MORPHING
+	// Add the weighted deltas of the vertex before anything else moves it, like glTF does
+	uvec2 range = texelFetch(morphRanges, gl_VertexID).xy;
+	for (uint i = range.x; i < range.x + range.y; i++)
+	{
+		vec4 delta = texelFetch(morphDeltas, int(2u * i));
+		float weight = morphWeights[int(delta.w)];
+		localPos += weight * delta.xyz;
+		localNormal += weight * texelFetch(morphDeltas, int(2u * i + 1u)).xyz;
+	}
+#endif
 
+#ifdef SKINNING
+	// Blend the matrices of the vertex's joints. They already place it in the world,
+	// so skinned meshes are drawn with an identity model matrix.
+	mat4 skin = aWeights.x * joints[int(aJoints.x)] + aWeights.y * joints[int(aJoints.y)]
+		+ aWeights.z * joints[int(aJoints.z)] + aWeights.w * joints[int(aJoints.w)];
+	vec4 position = skin * vec4(localPos, 1.0f);
+	Normal = mat3(skin) * localNormal;
+#ifdef NORMAL_MAP
+	Tangent = vec4(mat3(skin) * aTangent.xyz, aTangent.w);
+#endif
+#else
+	vec4 position = vec4(localPos, 1.0f);
 	// Pass the normal from the vertex data
-	Normal = aNormal;
+	Normal = localNormal;
+#ifdef NORMAL_MAP
+	Tangent = aTangent;
+#endif
+#endif
+
+	// Calculate the current world-space position of the vertex
+	crntPos = vec3(model * translation * -rotation * scale * position);
 
 	// Pass the vertex color
 	color = aColor;
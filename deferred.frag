@@ -0,0 +1,105 @@
+#version 330 core
+
+// Output color in RGBA format
+out vec4 FragColor;
+
+// The G-buffer written by the geometry pass, see GBuffer.h
+uniform sampler2D gAlbedo;
+uniform sampler2D gNormal;
+uniform sampler2D gMaterial;
+uniform sampler2D gDepth;
+#ifdef PBR
+uniform sampler2D gEmissive;
+#endif
+
+// Turns a screen position and depth back into a world position
+uniform mat4 invCamMatrix;
+
+// The surface under this pixel, read from the G-buffer at the top of main().
+// lighting.glsl sees it through the same functions as the forward surface in default.frag.
+vec3 crntPos;
+vec3 Normal;
+vec4 albedo;
+float surfaceDepth;
+
+// The diffuse color and specular map stored by the geometry pass
+vec4 diffuseTex()
+{
+	return vec4(albedo.rgb, 1.0f);
+}
+
+float specularTex()
+{
+	return albedo.a;
+}
+
+// Unpacks a normal stored by encodeNormal in gbuffer.frag
+vec3 decodeNormal(vec2 e)
+{
+	vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+		n.xy = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
+vec3 surfacePosition()
+{
+	return crntPos;
+}
+
+vec3 surfaceNormal()
+{
+	return normalize(Normal);
+}
+
+float fragmentDepth()
+{
+	return surfaceDepth;
+}
+
+void main()
+{
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	surfaceDepth = texelFetch(gDepth, pixel, 0).r;
+
+	// Nothing was drawn here, keep the clear color
+	if (surfaceDepth == 1.0f)
+		discard;
+
+	// Rebuild the surface from the G-buffer
+	vec2 screen = gl_FragCoord.xy / vec2(textureSize(gDepth, 0));
+	vec4 position = invCamMatrix * vec4(vec3(screen, surfaceDepth) * 2.0f - 1.0f, 1.0f);
+	crntPos = position.xyz / position.w;
+	Normal = decodeNormal(texelFetch(gNormal, pixel, 0).rg);
+	albedo = texelFetch(gAlbedo, pixel, 0);
+
+	// Add up the light types this variant was compiled with, like default.frag does
+	FragColor = vec4(0.0f);
+#ifdef PBR
+	// Unpack the surface gbuffer.frag stored for PBR materials
+	baseColor = pow(albedo.rgb, vec3(2.2f));
+	occlusion = albedo.a;
+	vec2 material = texelFetch(gMaterial, pixel, 0).rg;
+	roughness = max(material.r, 0.04f);
+	metallic = material.g;
+	emissive = texelFetch(gEmissive, pixel, 0).rgb;
+	surfaceN = Normal;
+	surfaceV = normalize(camPos - crntPos);
+	FragColor.rgb = environmentLight() + emissive;
+#endif
+#ifdef DIRECTIONAL_LIGHT
+	FragColor += direcLight();
+#endif
+#ifdef POINT_LIGHT
+	FragColor += pointLight();
+#endif
+#ifdef SPOT_LIGHT
+	FragColor += spotLight();
+#endif
+#ifdef CLUSTERED_LIGHTS
+	FragColor += clusteredLights();
+#endif
+#ifdef PBR
+	FragColor = vec4(pow(FragColor.rgb, vec3(1.0f / 2.2f)), 1.0f);
+#endif
+}
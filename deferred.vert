@@ -0,0 +1,9 @@
+#version 330 core
+
+// Draws one triangle that covers the whole screen, no vertex buffer needed.
+// Vertex 0 is at (-1,-1), vertex 1 at (3,-1), and vertex 2 at (-1,3).
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(corner * 2.0f - 1.0f, 0.0f, 1.0f);
+}
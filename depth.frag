@@ -0,0 +1,56 @@
+#version 330 core
+
+#ifdef ALPHA_TEST
+in vec2 texCoord;
+
+// The diffuse texture array and the material table, see default.frag
+uniform sampler2DArray diffuse0;
+
+struct MaterialData
+{
+	int diffuseLayer;
+	int specularLayer;
+	float alphaCutoff;
+	int normalLayer;
+	float normalScale;
+};
+
+layout (std140) uniform Materials
+{
+	MaterialData materials[256];
+};
+uniform int materialIndex;
+
+#ifdef PBR
+// The base color factor scales the cut-out alpha too, see default.frag
+struct PBRMaterialData
+{
+	vec4 baseColorFactor;
+	vec3 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float occlusionStrength;
+	int occlusionLayer;
+	int emissiveLayer;
+};
+
+layout (std140) uniform PBRMaterials
+{
+	PBRMaterialData pbrMaterials[256];
+};
+#endif
+#endif
+
+// Only the depth buffer is written. Masked materials drop the fragments
+// their diffuse alpha cuts out, so their holes let the light through.
+void main()
+{
+#ifdef ALPHA_TEST
+	float alpha = texture(diffuse0, vec3(texCoord, materials[materialIndex].diffuseLayer)).a;
+#ifdef PBR
+	alpha *= pbrMaterials[materialIndex].baseColorFactor.a;
+#endif
+	if (alpha < materials[materialIndex].alphaCutoff)
+		discard;
+#endif
+}
@@ -0,0 +1,75 @@
+#version 330 core
+
+// Only the position is read, from the mesh's position only buffer
+layout (location = 0) in vec3 aPos;
+
+// Must match default.vert bit for bit, or the GL_EQUAL test after the pre-pass fails
+invariant gl_Position;
+
+// View and projection of whatever the depth is rendered for, the camera or a shadow cascade
+uniform mat4 camMatrix;
+
+// Model transformation matrices, applied exactly like default.vert does
+// so the depth lines up with the color pass
+uniform mat4 model;
+uniform mat4 translation;
+uniform mat4 rotation;
+uniform mat4 scale;
+
+#ifdef ALPHA_TEST
+// Masked materials need the texture coordinates to cut their shadows out,
+// so they are drawn with the mesh's full vertex buffer instead
+layout (location = 3) in vec2 aTex;
+out vec2 texCoord;
+#endif
+
+#ifdef SKINNING
+// Skinned exactly like default.vert
+layout (location = 4) in vec4 aJoints;
+layout (location = 5) in vec4 aWeights;
+
+// Must match MAX_SKIN_JOINTS in Skin.h
+#define MAX_JOINTS 128
+// World matrix times inverse bind matrix of every joint of the skin being drawn
+layout (std140) uniform Skin
+{
+	mat4 joints[MAX_JOINTS];
+};
+#endif
+
+#ifdef MORPHING
+// Morphed exactly like default.vert, the positions only
+uniform usamplerBuffer morphRanges;
+uniform samplerBuffer morphDeltas;
+
+// Must match MAX_MORPH_TARGETS in Morph.h
+#define MAX_MORPH_TARGETS 64
+uniform float morphWeights[MAX_MORPH_TARGETS];
+#endif
+
+void main()
+{
+	vec3 localPos = aPos;
+#ifdef MORPHING
+	uvec2 range = texelFetch(morphRanges, gl_VertexID).xy;
+	for (uint i = range.x; i < range.x + range.y; i++)
+	{
+		vec4 delta = texelFetch(morphDeltas, int(2u * i));
+		float weight = morphWeights[int(delta.w)];
+		localPos += weight * delta.xyz;
+	}
+#endif
+
+#ifdef SKINNING
+	mat4 skin = aWeights.x * joints[int(aJoints.x)] + aWeights.y * joints[int(aJoints.y)]
+		+ aWeights.z * joints[int(aJoints.z)] + aWeights.w * joints[int(aJoints.w)];
+	vec4 position = skin * vec4(localPos, 1.0f);
+#else
+	vec4 position = vec4(localPos, 1.0f);
+#endif
+	vec3 crntPos = vec3(model * translation * -rotation * scale * position);
+	gl_Position = camMatrix * vec4(crntPos, 1.0);
+#ifdef ALPHA_TEST
+	texCoord = mat2(0.0, -1.0, 1.0, 0.0) * aTex;
+#endif
+}
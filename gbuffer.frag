@@ -0,0 +1,124 @@
+#version 330 core
+
+// The three G-buffer targets, see GBuffer.h
+layout (location = 0) out vec4 gAlbedo;
+layout (location = 1) out vec2 gNormal;
+layout (location = 2) out vec2 gMaterial;
+#ifdef PBR
+// Only PBR materials give off light, the G-buffer only writes this target for them
+layout (location = 3) out vec3 gEmissive;
+#endif
+
+// Inputs received from the Vertex Shader
+in vec3 crntPos;
+in vec3 Normal;
+in vec3 color;
+in vec2 texCoord;
+
+// Texture arrays passed from the main program
+uniform sampler2DArray diffuse0;
+uniform sampler2DArray specular0;
+
+#ifdef NORMAL_MAP
+// Tangent from the Vertex Shader, with the bitangent's side in w
+in vec4 Tangent;
+// Texture array holding the material's tangent space normal map
+uniform sampler2DArray normal0;
+#endif
+
+// Texture layers and alpha cutoff of one material, matches MaterialData in Material.h
+struct MaterialData
+{
+	int diffuseLayer;
+	int specularLayer;
+	float alphaCutoff;
+	int normalLayer;
+	float normalScale;
+};
+
+// Every material in the model
+layout (std140) uniform Materials
+{
+	MaterialData materials[256];
+};
+// Row of the material table used by the current mesh
+uniform int materialIndex;
+
+#ifdef PBR
+// Texture arrays holding the material's occlusion and emissive layers
+uniform sampler2DArray occlusion0;
+uniform sampler2DArray emissive0;
+
+// Factors and the other layers of one material, matches PBRMaterialData in Material.h
+struct PBRMaterialData
+{
+	vec4 baseColorFactor;
+	vec3 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float occlusionStrength;
+	int occlusionLayer;
+	int emissiveLayer;
+};
+
+// The PBR factors of every material in the model, same rows as Materials
+layout (std140) uniform PBRMaterials
+{
+	PBRMaterialData pbrMaterials[256];
+};
+#endif
+
+// Packs a unit vector into two numbers by folding the octahedron it lies on flat
+vec2 encodeNormal(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 folded = (1.0f - abs(n.yx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+	return n.z >= 0.0f ? n.xy : folded;
+}
+
+void main()
+{
+	vec4 diffuse = texture(diffuse0, vec3(texCoord, materials[materialIndex].diffuseLayer));
+	vec4 specular = texture(specular0, vec3(texCoord, materials[materialIndex].specularLayer));
+
+	// Masked materials drop the fragments their base color marks as cut out
+#ifdef ALPHA_TEST
+	float alpha = diffuse.a;
+#ifdef PBR
+	alpha *= pbrMaterials[materialIndex].baseColorFactor.a;
+#endif
+	if (alpha < materials[materialIndex].alphaCutoff)
+		discard;
+#endif
+
+	// Bend the normal by the normal map, the same way default.frag does
+	vec3 normal = normalize(Normal);
+#ifdef NORMAL_MAP
+	vec3 tangent = normalize(Tangent.xyz - normal * dot(normal, Tangent.xyz));
+	vec3 bitangent = cross(normal, tangent) * Tangent.w;
+	vec3 mapped = texture(normal0, vec3(texCoord, materials[materialIndex].normalLayer)).xyz * 2.0f - 1.0f;
+	mapped.xy *= materials[materialIndex].normalScale;
+	normal = normalize(tangent * mapped.x + bitangent * mapped.y + normal * mapped.z);
+#endif
+
+	// Store the surface, the lighting pass does the rest
+	gNormal = encodeNormal(normal);
+#ifdef PBR
+	// PBR surfaces store their factors applied, the occlusion in place of the specular map,
+	// and the base color back in sRGB so dark colors keep their precision in 8 bits
+	PBRMaterialData material = pbrMaterials[materialIndex];
+	vec3 baseColor = pow(diffuse.rgb, vec3(2.2f)) * material.baseColorFactor.rgb;
+	float occlusion = 1.0f;
+	if (material.occlusionLayer >= 0)
+		occlusion += material.occlusionStrength * (texture(occlusion0, vec3(texCoord, material.occlusionLayer)).r - 1.0f);
+	vec3 emissive = material.emissiveFactor;
+	if (material.emissiveLayer >= 0)
+		emissive *= pow(texture(emissive0, vec3(texCoord, material.emissiveLayer)).rgb, vec3(2.2f));
+	gAlbedo = vec4(pow(baseColor, vec3(1.0f / 2.2f)), occlusion);
+	gMaterial = vec2(specular.g * material.roughnessFactor, specular.b * material.metallicFactor);
+	gEmissive = emissive;
+#else
+	gAlbedo = vec4(diffuse.rgb, specular.r);
+	gMaterial = specular.gb;
+#endif
+}
@@ -0,0 +1,287 @@
+// Lighting shared by default.frag and deferred.frag. ShaderVariants places this file
+// right after the #defines of both, so the forward and deferred paths light a surface
+// with the very same code. Each of them describes its surface through these functions:
+vec3 surfacePosition(); // World position of the surface
+vec3 surfaceNormal(); // Normal the light sees
+vec4 diffuseTex(); // Diffuse color of the surface
+float specularTex(); // Specular map value of the surface
+float fragmentDepth(); // Window space depth, used to find the light cluster
+
+// Light and camera information
+uniform vec4 lightColor;
+uniform vec3 lightPos;
+uniform vec3 camPos;
+
+#ifdef PBR
+// Image based lighting, see Environment.h: the environment prefiltered for every roughness,
+// the split sum BRDF lookup table, and the diffuse irradiance as spherical harmonics
+uniform samplerCube environmentMap;
+uniform sampler2D brdfLUT;
+uniform float environmentLod;
+uniform vec3 irradianceSH[9];
+
+const float PI = 3.14159265f;
+
+// The surface being shaded, in linear color, filled in at the start of main()
+vec3 baseColor;
+float metallic;
+float roughness;
+float occlusion;
+vec3 emissive;
+vec3 surfaceN;
+vec3 surfaceV;
+
+// Lambert diffuse and GGX specular, with height correlated Smith visibility and Schlick
+// Fresnel, for light arriving along lightDirection. The light is taken as the irradiance
+// it brings head on, so a white light lights a white surface as brightly as it does
+// the Blinn-Phong materials.
+vec3 brdf(vec3 lightDirection, vec3 light)
+{
+	vec3 halfway = normalize(surfaceV + lightDirection);
+	float NdotL = max(dot(surfaceN, lightDirection), 0.0f);
+	float NdotV = max(dot(surfaceN, surfaceV), 1e-4f);
+	float NdotH = max(dot(surfaceN, halfway), 0.0f);
+	float alpha = roughness * roughness;
+	float alpha2 = alpha * alpha;
+	float d = NdotH * NdotH * (alpha2 - 1.0f) + 1.0f;
+	float distribution = alpha2 / (PI * d * d);
+	float visibility = 0.5f / max(NdotL * sqrt(NdotV * NdotV * (1.0f - alpha2) + alpha2) + NdotV * sqrt(NdotL * NdotL * (1.0f - alpha2) + alpha2), 1e-5f);
+	vec3 f0 = mix(vec3(0.04f), baseColor, metallic);
+	vec3 fresnel = f0 + (1.0f - f0) * pow(1.0f - max(dot(surfaceV, halfway), 0.0f), 5.0f);
+	vec3 diffuse = (1.0f - fresnel) * (1.0f - metallic) * baseColor;
+	return (diffuse + fresnel * distribution * visibility * PI) * light * NdotL;
+}
+
+// Light from the environment, which takes the place of the flat ambient light.
+// The diffuse comes from the harmonics, the specular from the level of the prefiltered
+// map matching the roughness, scaled and biased by the lookup table.
+vec3 environmentLight()
+{
+	vec3 n = surfaceN;
+	vec3 irradiance = irradianceSH[0]
+		+ irradianceSH[1] * n.y + irradianceSH[2] * n.z + irradianceSH[3] * n.x
+		+ irradianceSH[4] * n.x * n.y + irradianceSH[5] * n.y * n.z + irradianceSH[6] * (3.0f * n.z * n.z - 1.0f)
+		+ irradianceSH[7] * n.x * n.z + irradianceSH[8] * (n.x * n.x - n.y * n.y);
+	vec2 scaleBias = texture(brdfLUT, vec2(max(dot(n, surfaceV), 0.0f), roughness)).rg;
+	vec3 specularColor = mix(vec3(0.04f), baseColor, metallic) * scaleBias.x + scaleBias.y;
+	vec3 reflected = textureLod(environmentMap, reflect(-surfaceV, n), roughness * environmentLod).rgb;
+	vec3 diffuse = (1.0f - specularColor) * (1.0f - metallic) * baseColor * max(irradiance, 0.0f);
+	return (diffuse + specularColor * reflected) * occlusion;
+}
+
+#endif
+
+vec4 pointLight()
+{	
+	// Vector from the fragment to the light source
+	vec3 lightVec = lightPos - surfacePosition();
+
+	// Calculate light intensity based on distance
+	float dist = length(lightVec);
+	float a = 3.0;
+	float b = 0.7;
+	float inten = 1.0f / (a * dist * dist + b * dist + 1.0f);
+
+	// Ambient light (base brightness)
+	float ambient = 0.20f;
+
+	// Diffuse lighting (brightness based on angle)
+	vec3 normal = surfaceNormal();
+	vec3 lightDirection = normalize(lightVec);
+	float diffuse = max(dot(normal, lightDirection), 0.0f);
+
+	// Specular lighting (reflective highlights)
+	float specularLight = 0.50f;
+	vec3 viewDirection = normalize(camPos - surfacePosition());
+	vec3 reflectionDirection = reflect(-lightDirection, normal);
+	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
+	float specular = specAmount * specularLight;
+
+#ifdef PBR
+	// PBR surfaces get their ambient light from the environment instead
+	return vec4(brdf(lightDirection, lightColor.rgb * inten), 0.0f);
+#else
+	// Combine ambient, diffuse, and specular lighting with textures
+	return (diffuseTex() * (diffuse * inten + ambient) + specularTex() * specular * inten) * lightColor;
+#endif
+}
+
+#ifdef SHADOWS
+// Shadow maps of the directional light, one layer per cascade
+uniform sampler2DArrayShadow shadowMap;
+
+// Light matrices of the cascades, matches ShadowParams in ShadowCascades.cpp
+layout (std140) uniform Shadows
+{
+	mat4 shadowMatrices[4];
+	int shadowCascades;
+	float shadowTexelSize;
+};
+
+// Returns how much of the directional light reaches the fragment, from 0 to 1
+float shadow()
+{
+	// Use the first, sharpest cascade the fragment falls inside of
+	for (int i = 0; i < shadowCascades; i++)
+	{
+		vec4 position = shadowMatrices[i] * vec4(surfacePosition(), 1.0f);
+		vec3 coords = position.xyz / position.w * 0.5f + 0.5f;
+		if (any(lessThan(coords, vec3(shadowTexelSize))) || any(greaterThan(coords, vec3(1.0f - shadowTexelSize))))
+			continue;
+
+		// Average 3x3 filtered depth comparisons for soft edges
+		float lit = 0.0f;
+		for (int x = -1; x <= 1; x++)
+			for (int y = -1; y <= 1; y++)
+				lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * shadowTexelSize, i, coords.z));
+		return lit / 9.0f;
+	}
+	return 1.0f;
+}
+#endif
+
+vec4 direcLight()
+{
+	// Ambient light
+	float ambient = 0.20f;
+
+	// Diffuse lighting
+	vec3 normal = surfaceNormal();
+	vec3 lightDirection = normalize(vec3(1.0f, 1.0f, 0.0f));
+	float diffuse = max(dot(normal, lightDirection), 0.0f);
+
+	// Specular lighting
+	float specularLight = 0.50f;
+	vec3 viewDirection = normalize(camPos - surfacePosition());
+	vec3 reflectionDirection = reflect(-lightDirection, normal);
+	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
+	float specular = specAmount * specularLight;
+
+	// Shadows block the direct light, but not the ambient light
+	float lit = 1.0f;
+#ifdef SHADOWS
+	lit = shadow();
+#endif
+
+#ifdef PBR
+	return vec4(brdf(lightDirection, lightColor.rgb * lit), 0.0f);
+#else
+	// Combine lighting and textures
+	return (diffuseTex() * (diffuse * lit + ambient) + specularTex() * specular * lit) * lightColor;
+#endif
+}
+
+vec4 spotLight()
+{
+	// Defines the sharpness and size of the light cone
+	float outerCone = 0.90f;
+	float innerCone = 0.95f;
+
+	// Ambient lighting
+	float ambient = 0.20f;
+
+	// Diffuse lighting
+	vec3 normal = surfaceNormal();
+	vec3 lightDirection = normalize(lightPos - surfacePosition());
+	float diffuse = max(dot(normal, lightDirection), 0.0f);
+
+	// Specular lighting
+	float specularLight = 0.50f;
+	vec3 viewDirection = normalize(camPos - surfacePosition());
+	vec3 reflectionDirection = reflect(-lightDirection, normal);
+	float specAmount = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16);
+	float specular = specAmount * specularLight;
+
+	// Determine how strongly the fragment is lit based on its angle inside the cone
+	float angle = dot(vec3(0.0f, -1.0f, 0.0f), -lightDirection);
+	float inten = clamp((angle - outerCone) / (innerCone - outerCone), 0.0f, 1.0f);
+
+#ifdef PBR
+	return vec4(brdf(lightDirection, lightColor.rgb * inten), 0.0f);
+#else
+	// Combine textures with lighting values
+	return (diffuseTex() * (diffuse * inten + ambient) + specularTex() * specular * inten) * lightColor;
+#endif
+}
+
+#ifdef CLUSTERED_LIGHTS
+// Point and spot lights, 4 texels each: position and radius, color and type,
+// spot direction and inner cone, outer cone
+uniform samplerBuffer clusterLights;
+// Offset and count into clusterIndices for every cluster
+uniform usamplerBuffer clusterGrid;
+// Indices of the lights that reach each cluster
+uniform usamplerBuffer clusterIndices;
+
+// How the view frustum is split into clusters, matches ClusterParams in LightClusters.cpp
+layout (std140) uniform Clusters
+{
+	uvec4 clusterCount;
+	vec2 tileSize;
+	float sliceScale;
+	float sliceBias;
+	float clusterNear;
+	float clusterFar;
+};
+
+// Adds up every light listed in this fragment's cluster
+vec4 clusteredLights()
+{
+	// Turn the fragment's depth back into a view space distance to find its depth slice
+	float ndcDepth = fragmentDepth() * 2.0f - 1.0f;
+	float depth = 2.0f * clusterNear * clusterFar / (clusterFar + clusterNear - ndcDepth * (clusterFar - clusterNear));
+	uint slice = uint(max(log(depth) * sliceScale - sliceBias, 0.0f));
+	uvec3 cluster = min(uvec3(uvec2(gl_FragCoord.xy / tileSize), slice), clusterCount.xyz - 1u);
+	uvec2 range = texelFetch(clusterGrid, int(cluster.x + clusterCount.x * (cluster.y + clusterCount.y * cluster.z))).xy;
+
+#ifdef PBR
+	// brdf shades with the metallic roughness surface loaded once per fragment, not the Blinn-Phong maps
+#else
+	// The textures and view direction are the same for every light
+	vec4 diffuseColor = diffuseTex();
+	float specularColor = specularTex();
+	vec3 normal = surfaceNormal();
+	vec3 viewDirection = normalize(camPos - surfacePosition());
+#endif
+
+	vec4 result = vec4(0.0f);
+	for (uint i = 0u; i < range.y; i++)
+	{
+		int light = int(texelFetch(clusterIndices, int(range.x + i)).r) * 4;
+		vec4 positionRadius = texelFetch(clusterLights, light);
+		vec4 colorType = texelFetch(clusterLights, light + 1);
+
+		vec3 lightVec = positionRadius.xyz - surfacePosition();
+		float dist = length(lightVec);
+		if (dist >= positionRadius.w)
+			continue;
+
+		// Same falloff as pointLight, faded out towards the radius so the light
+		// doesn't stop sharply at the edge of the clusters it was assigned to
+		float a = 3.0;
+		float b = 0.7;
+		float fade = clamp(1.0f - pow(dist / positionRadius.w, 4.0f), 0.0f, 1.0f);
+		float inten = fade * fade / (a * dist * dist + b * dist + 1.0f);
+
+		vec3 lightDirection = lightVec / dist;
+		if (colorType.w > 0.5f)
+		{
+			// Spot lights fade from the inner to the outer cone
+			vec4 directionInner = texelFetch(clusterLights, light + 2);
+			float outerCone = texelFetch(clusterLights, light + 3).x;
+			float angle = dot(directionInner.xyz, -lightDirection);
+			inten *= clamp((angle - outerCone) / (directionInner.w - outerCone), 0.0f, 1.0f);
+		}
+
+#ifdef PBR
+		result.rgb += brdf(lightDirection, colorType.rgb * inten);
+#else
+		float diffuse = max(dot(normal, lightDirection), 0.0f);
+		vec3 reflectionDirection = reflect(-lightDirection, normal);
+		float specular = pow(max(dot(viewDirection, reflectionDirection), 0.0f), 16) * 0.50f;
+		result += (diffuseColor * diffuse + specularColor * specular) * inten * vec4(colorType.rgb, 1.0f);
+#endif
+	}
+	return result;
+}
+#endif
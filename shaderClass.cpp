@@ -1,5 +1,6 @@
 // Header is included.
 #include"shaderClass.h"
+#include"RenderStats.h"
 
 // The header already includes everything needed for this file,
 // so no other includes are necessary here.
@@ -45,14 +46,56 @@ std::string get_file_contents(const char* filename)
 }
 
 
+// Builds the #define lines for a set of ShaderFeature bits.
+// The order is fixed, so the same bits always give the same text (and the same cache key).
+std::string shader_defines(unsigned int features)
+{
+	std::string defines;
+	if (features & SHADER_DIRECTIONAL_LIGHT) defines += "#define DIRECTIONAL_LIGHT\n";
+	if (features & SHADER_POINT_LIGHT) defines += "#define POINT_LIGHT\n";
+	if (features & SHADER_SPOT_LIGHT) defines += "#define SPOT_LIGHT\n";
+	if (features & SHADER_ALPHA_TEST) defines += "#define ALPHA_TEST\n";
+	if (features & SHADER_CLUSTERED_LIGHTS) defines += "#define CLUSTERED_LIGHTS\n";
+	if (features & SHADER_SHADOWS) defines += "#define SHADOWS\n";
+	if (features & SHADER_SKINNING) defines += "#define SKINNING\n";
+	if (features & SHADER_MORPHING) defines += "#define MORPHING\n";
+	if (features & SHADER_NORMAL_MAP) defines += "#define NORMAL_MAP\n";
+	if (features & SHADER_PBR) defines += "#define PBR\n";
+	return defines;
+}
+
+
 // Shader constructor for Shader class. Takes 2 strings, the vertex shader file and
 // the fragment shader file.
-Shader::Shader(const char* vertexFile, const char* fragmentFile)
+Shader::Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines, ProgramCache* cache, const char* fragmentLibrary)
 {
+	// Remember where the program came from so it can be rebuilt when the files change.
+	Shader::vertexFile = vertexFile;
+	Shader::fragmentFile = fragmentFile;
+	if (fragmentLibrary != NULL)
+		Shader::fragmentLibrary = fragmentLibrary;
+	Shader::defines = defines;
+	Shader::cache = cache;
+
 	// Read the vertex and fragment shader source files into strings.
 	// We conveniently use get_file_contents from above.
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	// The defines go after the #version line, which has to stay the first line of the shader.
+	std::string vertexCode = insertDefines(get_file_contents(vertexFile), defines);
+	std::string fragmentCode = readFragment();
+
+	// If this exact program was linked on an earlier launch, load its binary
+	// from the cache and skip compiling altogether.
+	std::string cacheKey;
+	if (cache != NULL)
+	{
+		cacheKey = cache->Key(vertexCode, fragmentCode, defines);
+		ID = cache->Load(cacheKey);
+		if (ID != 0)
+			return;
+	}
+
+	// Time compiling and linking, so later cache hits can report how much time they saved.
+	auto compileStart = std::chrono::high_resolution_clock::now();
 
 	// Convert the std::string shader source code into C-style strings (char*).
 	// std::string is higher level than char*.
@@ -90,6 +133,9 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 	// Create a Shader Program and store its ID.
 	// The shader program links the shaders we have together (the fragment and vertex).
 	ID = glCreateProgram();
+	// Ask the driver to keep the linked binary so it can be written to the cache.
+	if (cache != NULL)
+		cache->MarkRetrievable(ID);
 	// Attach both compiled shaders (vertex and fragment) to the program.
 	glAttachShader(ID, vertexShader);
 	glAttachShader(ID, fragmentShader);
@@ -102,6 +148,15 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 	// so they are deleted to free up memory.
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
+
+	// Save the linked program so the next launch doesn't have to compile it.
+	GLint linked = GL_FALSE;
+	glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+	if (cache != NULL && linked == GL_TRUE)
+	{
+		double compileMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - compileStart).count();
+		cache->Store(cacheKey, ID, compileMs);
+	}
 }
 
 
@@ -111,16 +166,181 @@ Shader::Shader(const char* vertexFile, const char* fragmentFile)
 void Shader::Activate()
 {
 	glUseProgram(ID);
+	RenderStats::programBinds++;
 }
 
 
 // Deletes this shader program from OpenGL memory.
 void Shader::Delete()
 {
+	cancelReload();
 	glDeleteProgram(ID);
 }
 
 
+// Looks a uniform up once and remembers its location.
+// Names that don't exist in the program are cached as -1, which glUniform ignores.
+GLint Shader::Uniform(const char* name)
+{
+	auto found = uniforms.find(name);
+	if (found != uniforms.end())
+		return found->second;
+	GLint location = glGetUniformLocation(ID, name);
+	uniforms.emplace(name, location);
+	return location;
+}
+
+
+// KHR_parallel_shader_compile lets us ask whether a link is done without waiting on it.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+static bool parallel_compile_supported()
+{
+	static int supported = -1;
+	if (supported == -1)
+	{
+		supported = 0;
+		GLint numExtensions = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+		for (GLint i = 0; i < numExtensions; i++)
+		{
+			std::string extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+			if (extension == "GL_KHR_parallel_shader_compile" || extension == "GL_ARB_parallel_shader_compile")
+				supported = 1;
+		}
+	}
+	return supported == 1;
+}
+
+
+// Restarts the reload from the top if one is already running, since the files changed again.
+void Shader::BeginReload()
+{
+	cancelReload();
+	reloadStep = 1;
+	reloadMs = 0.0;
+}
+
+
+// Each step only issues a little work to the driver. Compile and link status are read
+// in the last step, a few frames after the work was submitted, so the driver has had
+// time to finish it in the background instead of stalling the frame that asks.
+bool Shader::UpdateReload()
+{
+	if (reloadStep == 0)
+		return false;
+
+	auto stepStart = std::chrono::high_resolution_clock::now();
+
+	switch (reloadStep)
+	{
+	case 1:
+		// Editors often replace a file by writing a new one and renaming it over the old.
+		// If we catch it half way the file can't be read, so we just wait for the next change.
+		try
+		{
+			reloadVertexCode = insertDefines(get_file_contents(vertexFile.c_str()), defines);
+			reloadFragmentCode = readFragment();
+		}
+		catch (int)
+		{
+			cancelReload();
+			return false;
+		}
+		{
+			const char* vertexSource = reloadVertexCode.c_str();
+			reloadVertex = glCreateShader(GL_VERTEX_SHADER);
+			glShaderSource(reloadVertex, 1, &vertexSource, NULL);
+			glCompileShader(reloadVertex);
+		}
+		reloadStep++;
+		break;
+	case 2:
+	{
+		const char* fragmentSource = reloadFragmentCode.c_str();
+		reloadFragment = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(reloadFragment, 1, &fragmentSource, NULL);
+		glCompileShader(reloadFragment);
+		reloadStep++;
+		break;
+	}
+	case 3:
+		reloadProgram = glCreateProgram();
+		if (cache != NULL)
+			cache->MarkRetrievable(reloadProgram);
+		glAttachShader(reloadProgram, reloadVertex);
+		glAttachShader(reloadProgram, reloadFragment);
+		glLinkProgram(reloadProgram);
+		reloadStep++;
+		break;
+	case 4:
+	{
+		// Keep waiting while the driver is still linking on its own threads
+		if (parallel_compile_supported())
+		{
+			GLint complete = GL_FALSE;
+			glGetProgramiv(reloadProgram, GL_COMPLETION_STATUS_KHR, &complete);
+			if (complete == GL_FALSE)
+				break;
+		}
+
+		GLint linked = GL_FALSE;
+		glGetProgramiv(reloadProgram, GL_LINK_STATUS, &linked);
+		if (linked == GL_FALSE)
+		{
+			// Print what went wrong and keep drawing with the last program that worked
+			compileErrors(reloadVertex, "VERTEX");
+			compileErrors(reloadFragment, "FRAGMENT");
+			compileErrors(reloadProgram, "PROGRAM");
+			cancelReload();
+			return false;
+		}
+
+		// Swap the new program in and point every cached uniform name at its new location
+		glDeleteProgram(ID);
+		ID = reloadProgram;
+		reloadProgram = 0;
+		for (auto& uniform : uniforms)
+			uniform.second = glGetUniformLocation(ID, uniform.first.c_str());
+
+		reloadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - stepStart).count();
+		if (cache != NULL)
+			cache->Store(cache->Key(reloadVertexCode, reloadFragmentCode, defines), ID, reloadMs);
+		cancelReload();
+		return true;
+	}
+	}
+
+	reloadMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - stepStart).count();
+	return false;
+}
+
+
+bool Shader::Reloading()
+{
+	return reloadStep != 0;
+}
+
+
+void Shader::cancelReload()
+{
+	if (reloadVertex != 0)
+		glDeleteShader(reloadVertex);
+	if (reloadFragment != 0)
+		glDeleteShader(reloadFragment);
+	if (reloadProgram != 0)
+		glDeleteProgram(reloadProgram);
+	reloadVertex = 0;
+	reloadFragment = 0;
+	reloadProgram = 0;
+	reloadVertexCode.clear();
+	reloadFragmentCode.clear();
+	reloadStep = 0;
+}
+
+
 // This function checks whether a shader (or shader program) compiled or linked successfully.
 // If there was an error, it prints the corresponding error message to the console.
 void Shader::compileErrors(unsigned int shader, const char* type)
@@ -153,3 +373,31 @@ void Shader::compileErrors(unsigned int shader, const char* type)
 		}
 	}
 }
+
+
+// The library is read again on every call, so editing it reloads every shader that uses it.
+std::string Shader::readFragment()
+{
+	std::string source = get_file_contents(fragmentFile.c_str());
+	if (fragmentLibrary.empty())
+		return insertDefines(source, defines);
+	return insertDefines(source, defines + get_file_contents(fragmentLibrary.c_str()));
+}
+
+
+// Places the defines right after the #version line of a shader source.
+// Sources without a #version line get the defines at the very top.
+std::string Shader::insertDefines(const std::string& source, const std::string& defines)
+{
+	if (defines.empty())
+		return source;
+
+	size_t version = source.find("#version");
+	if (version == std::string::npos)
+		return defines + source;
+
+	size_t lineEnd = source.find('\n', version);
+	if (lineEnd == std::string::npos)
+		return source + "\n" + defines;
+	return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+}
@@ -8,26 +8,92 @@
 #include<sstream> //  Enables string reading and writing.
 #include<iostream> // Enables input and output streams to the console (terminal).
 #include<cerrno> // Gives access to c errors.
+#include<chrono> // Times how long compiling takes.
+#include<unordered_map> // Caches uniform locations by name.
+#include"ProgramCache.h" // Stores linked programs on disk between launches.
 
 // Function declaration named get_file_contents that takes in a const char* filename 
 // and returns a std::string. Defined in the .cpp file.
 // char* means string literal in C/C++, and const means it won't be changed (it's named filename).
 std::string get_file_contents(const char* filename);
 
+// Feature bits a shader can be compiled with. Each bit turns into a #define
+// at the top of both shader sources, so a program only contains the code it needs.
+enum ShaderFeature : unsigned int
+{
+	SHADER_DIRECTIONAL_LIGHT = 1 << 0, // #define DIRECTIONAL_LIGHT
+	SHADER_POINT_LIGHT = 1 << 1, // #define POINT_LIGHT
+	SHADER_SPOT_LIGHT = 1 << 2, // #define SPOT_LIGHT
+	SHADER_ALPHA_TEST = 1 << 3, // #define ALPHA_TEST
+	SHADER_CLUSTERED_LIGHTS = 1 << 4, // #define CLUSTERED_LIGHTS
+	SHADER_SHADOWS = 1 << 5, // #define SHADOWS
+	SHADER_SKINNING = 1 << 6, // #define SKINNING
+	SHADER_MORPHING = 1 << 7, // #define MORPHING
+	SHADER_NORMAL_MAP = 1 << 8, // #define NORMAL_MAP
+	SHADER_PBR = 1 << 9, // #define PBR
+};
+
+// Turns a combination of ShaderFeature bits into the matching lines of #defines.
+std::string shader_defines(unsigned int features);
+
 class Shader
 {
 public:
 	// Reference ID of the Shader Program
 	GLuint ID;
-	// Constructor that build the Shader Program from 2 different shaders
-	Shader(const char* vertexFile, const char* fragmentFile);
+	// Constructor that build the Shader Program from 2 different shaders.
+	// defines is inserted right after the #version line of both shaders.
+	// If a cache is given, the linked program is loaded from disk when it was built before
+	// with the same sources on the same driver, and saved there after compiling otherwise.
+	// If a fragment library is given, its source goes after the defines of the fragment shader,
+	// so several fragment shaders can share the functions in it.
+	Shader(const char* vertexFile, const char* fragmentFile, const std::string& defines = "", ProgramCache* cache = NULL, const char* fragmentLibrary = NULL);
 
 	// Functions defined in the .cpp file:
 	void Activate(); // Activates the Shader Program
 	void Delete(); // Deletes the Shader Program
+
+	// Returns the location of a uniform, asking OpenGL only the first time a name is used.
+	// The cached locations are looked up again by name whenever the program is reloaded.
+	GLint Uniform(const char* name);
+
+	// Starts rebuilding the program from its source files, for example after they were edited.
+	// The work is spread over the next calls to UpdateReload, and the current program keeps
+	// being used until the new one has linked. If it fails to build the old one is kept.
+	void BeginReload();
+	// Does one step of a pending reload, so no single frame has to wait for the whole build.
+	// Returns true on the call that swaps the new program into ID.
+	bool UpdateReload();
+	// Returns true while a reload is in progress.
+	bool Reloading();
 private:
+	// Where the program came from, kept so it can be rebuilt later
+	std::string vertexFile;
+	std::string fragmentFile;
+	std::string fragmentLibrary;
+	std::string defines;
+	ProgramCache* cache;
+
+	// Uniform locations by name
+	std::unordered_map<std::string, GLint> uniforms;
+
+	// State of a pending reload, reloadStep is 0 when no reload is running
+	unsigned int reloadStep = 0;
+	std::string reloadVertexCode;
+	std::string reloadFragmentCode;
+	GLuint reloadVertex = 0;
+	GLuint reloadFragment = 0;
+	GLuint reloadProgram = 0;
+	double reloadMs = 0.0;
+
+	// Deletes the objects of a reload that failed or was cut short
+	void cancelReload();
 	// Checks if the different Shaders have compiled properly
 	void compileErrors(unsigned int shader, const char* type);
+	// Reads the fragment shader with the defines and the fragment library after its #version line
+	std::string readFragment();
+	// Returns the source with the defines placed after its #version line
+	static std::string insertDefines(const std::string& source, const std::string& defines);
 };
 
 // Skips to here if class is already defined (look at the top).